@@ -0,0 +1,488 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "pitsh.h"
+
+/*
+ * pitsh_bench runs ./pitsh over a synthetic corpus and the libpitsh
+ * real-time path over synthetic blocks, and prints one JSON object
+ * per measurement on the standard output, so that the results of
+ * two builds can be diffed. Progress goes to the standard error.
+ */
+
+#define RATE         44100
+#define MAX_LIST     16
+#define CHUNK_FRAMES 65536
+#define PITCH_FACTOR 1.5
+#define SPEED_FACTOR 1.3
+
+struct bench_options {
+   const char *pitsh;
+   const char *dir;
+   int durations[MAX_LIST];   /* in seconds */
+   int duration_count;
+   int sizes[MAX_LIST];
+   int size_count;
+   const char *engines[MAX_LIST];
+   int engine_count;
+   const char *ios[MAX_LIST];   /* --io of pitsh */
+   int io_count;
+   int threads;   /* 0 leaves the default of pitsh */
+   bool skip_files;
+   bool skip_realtime;
+};
+
+struct corpus_file {
+   char name[64];     /* in the corpus directory */
+   char path[4096];
+   const char *signal;
+   int channels;
+   int duration;
+   uint64_t data_size;
+};
+
+static void fail(const char *, ...);
+static void parse_options(int, char **, struct bench_options *);
+static int parse_list(const char *, int *);
+static int parse_names(char *, const char **, const char *);
+static void make_corpus_file(struct corpus_file *);
+static void bench_file(
+   const struct bench_options *,
+   const struct corpus_file *,
+   const char *, const char *, int, const char *);
+static bool bench_realtime(int, int, int);
+static double now(void);
+static uint32_t next_noise(uint32_t *);
+static void put_le(unsigned char *, uint32_t, int);
+
+int main(int argc, char **argv) {
+   struct bench_options options;
+   struct corpus_file file;
+   static const char *signals[] = { "sweep", "noise" };
+   static const int block_sizes[] = { 64, 256, 1024 };
+   static const int rt_grain_sizes[] = { 256, 2205 };
+   char dir_template[] = "/tmp/pitsh-bench-XXXXXX";
+   bool is_temp_dir = false, is_over_budget = false;
+   int d, s, c, e, g, b, i;
+
+   parse_options(argc, argv, &options);
+   /* pitsh is run from the corpus directory. */
+   options.pitsh = realpath(options.pitsh, NULL);
+   if (options.pitsh == NULL)
+      fail("Failed to find pitsh.");
+   if (options.dir == NULL) {
+      options.dir = mkdtemp(dir_template);
+      if (options.dir == NULL)
+         fail("Failed to create a directory for the corpus.");
+      is_temp_dir = true;
+   }
+
+   printf("{\"bench\":\"meta\",\"pitsh\":\"%s\",\"rate\":%d,"
+          "\"pitch_factor\":%g,\"speed_factor\":%g,\"threads\":%d}\n",
+      options.pitsh, RATE, PITCH_FACTOR, SPEED_FACTOR, options.threads);
+   fflush(stdout);
+
+   if (!options.skip_files)
+      for (d = 0; d < options.duration_count; d++)
+         for (s = 0; s < 2; s++)
+            for (c = 1; c <= 2; c++) {
+               file.signal = signals[s];
+               file.channels = c;
+               file.duration = options.durations[d];
+               snprintf(file.name, sizeof(file.name), "%s-%dch-%ds.wav",
+                  file.signal, c, file.duration);
+               snprintf(file.path, sizeof(file.path), "%s/%s",
+                  options.dir, file.name);
+               make_corpus_file(&file);
+               for (e = 0; e < options.engine_count; e++)
+                  for (g = 0; g < options.size_count; g++)
+                     for (i = 0; i < options.io_count; i++) {
+                        if (strcmp(options.engines[e], "wsola") != 0)
+                           bench_file(&options, &file, options.engines[e],
+                              "pitch", options.sizes[g], options.ios[i]);
+                        bench_file(&options, &file, options.engines[e],
+                           "speed", options.sizes[g], options.ios[i]);
+                     }
+               remove(file.path);
+            }
+
+   /* The worst-case block timing of the real-time path. */
+   if (!options.skip_realtime)
+      for (b = 0; b < 3; b++)
+         for (g = 0; g < 2; g++)
+            if (bench_realtime(block_sizes[b], rt_grain_sizes[g], 2))
+               is_over_budget = true;
+
+   if (is_temp_dir)
+      rmdir(options.dir);
+   free((char *) options.pitsh);
+
+   /* A real-time block over its budget is a failure, not a number. */
+   return is_over_budget ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void fail(const char *format, ...) {
+   va_list ap;
+
+   va_start(ap, format);
+   fprintf(stderr, "pitsh_bench: ");
+   vfprintf(stderr, format, ap);
+   fprintf(stderr, "\n");
+   va_end(ap);
+   exit(EXIT_FAILURE);
+}
+
+static void parse_options(
+   int argc,
+   char **argv,
+   struct bench_options *options
+) {
+   static const char *all_engines[] = { "grain", "wsola", "vocoder" };
+   int i;
+
+   options->pitsh = "./pitsh";
+   options->dir = NULL;
+   options->durations[0] = 60;
+   options->duration_count = 1;
+   options->sizes[0] = 2205;
+   options->sizes[1] = 4410;
+   options->sizes[2] = 8820;
+   options->size_count = 3;
+   for (i = 0; i < 3; i++)
+      options->engines[i] = all_engines[i];
+   options->engine_count = 3;
+   options->ios[0] = "mmap";
+   options->io_count = 1;
+   options->threads = 0;
+   options->skip_files = false;
+   options->skip_realtime = false;
+
+   for (i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "--no-files") == 0) {
+         options->skip_files = true;
+         continue;
+      }
+      if (strcmp(argv[i], "--no-realtime") == 0) {
+         options->skip_realtime = true;
+         continue;
+      }
+      if (i + 1 == argc)
+         fail("%s needs a value.", argv[i]);
+      if (strcmp(argv[i], "--pitsh") == 0)
+         options->pitsh = argv[++i];
+      else if (strcmp(argv[i], "--dir") == 0)
+         options->dir = argv[++i];
+      else if (strcmp(argv[i], "--durations") == 0)
+         options->duration_count = parse_list(argv[++i], options->durations);
+      else if (strcmp(argv[i], "--sizes") == 0)
+         options->size_count = parse_list(argv[++i], options->sizes);
+      else if (strcmp(argv[i], "--threads") == 0)
+         options->threads = atoi(argv[++i]);
+      else if (strcmp(argv[i], "--engines") == 0)
+         options->engine_count
+            = parse_names(argv[++i], options->engines, "engines");
+      else if (strcmp(argv[i], "--io") == 0)
+         options->io_count = parse_names(argv[++i], options->ios, "I/O ways");
+      else
+         fail("Unknown argument: %s. Arguments: [--pitsh PATH] [--dir DIR] "
+              "[--durations S,S,...] [--sizes N,N,...] [--engines E,E,...] "
+              "[--io B,B,...] [--threads N] [--no-files] [--no-realtime]",
+              argv[i]);
+   }
+}
+
+static int parse_list(const char *src, int *values) {
+   int count = 0;
+   const char *p = src;
+   char *end;
+
+   while (*p != '\0') {
+      if (count == MAX_LIST)
+         fail("Too many values: %s.", src);
+      values[count] = strtol(p, &end, 10);
+      if (end == p || values[count] <= 0)
+         fail("An invalid list: %s.", src);
+      count++;
+      p = *end == ',' ? end + 1 : end;
+   }
+   if (count == 0)
+      fail("An empty list.");
+   return count;
+}
+
+/* Note: parse_names() splits list in place; what is a list of. */
+static int parse_names(char *list, const char **names, const char *what) {
+   int count = 0;
+   char *token;
+
+   for (token = strtok(list, ","); token != NULL; token = strtok(NULL, ",")) {
+      if (count == MAX_LIST)
+         fail("Too many %s.", what);
+      names[count++] = token;
+   }
+   if (count == 0)
+      fail("An empty list.");
+   return count;
+}
+
+/*
+ * Note: make_corpus_file() writes a 16-bit WAV file of the given
+ * signal. A sweep glides exponentially from 20 Hz to 20 kHz over
+ * the whole duration, the right channel a quarter turn behind; the
+ * noise is white, from a fixed seed. Either way the same file comes
+ * out every time.
+ */
+static void make_corpus_file(struct corpus_file *file) {
+   FILE *fp;
+   unsigned char header[44];
+   int16_t *chunk;
+   uint64_t total = (uint64_t) file->duration * RATE, frame, i;
+   uint32_t seed = 0x9E3779B9u;
+   double phase = 0, ratio = log(20000.0 / 20.0), freq;
+   size_t count;
+   int c;
+
+   file->data_size = total * file->channels * 2;
+   if (file->data_size > UINT32_MAX - 36)
+      fail("%d s is too long for a WAV file.", file->duration);
+   fprintf(stderr, "Generating %s ...\n", file->path);
+
+   memcpy(header, "RIFF", 4);
+   put_le(header + 4, 36 + file->data_size, 4);
+   memcpy(header + 8, "WAVEfmt ", 8);
+   put_le(header + 16, 16, 4);
+   put_le(header + 20, 1, 2);
+   put_le(header + 22, file->channels, 2);
+   put_le(header + 24, RATE, 4);
+   put_le(header + 28, RATE * file->channels * 2, 4);
+   put_le(header + 32, file->channels * 2, 2);
+   put_le(header + 34, 16, 2);
+   memcpy(header + 36, "data", 4);
+   put_le(header + 40, file->data_size, 4);
+
+   fp = fopen(file->path, "wb");
+   if (fp == NULL)
+      fail("Failed to create %s.", file->path);
+   chunk = malloc(sizeof(int16_t) * CHUNK_FRAMES * file->channels);
+   if (chunk == NULL)
+      fail("Failed to allocate memory.");
+   if (fwrite(header, 1, 44, fp) != 44)
+      fail("Failed to write %s.", file->path);
+
+   for (frame = 0; frame < total; frame += count) {
+      count = total - frame < CHUNK_FRAMES ? total - frame : CHUNK_FRAMES;
+      for (i = 0; i < count; i++)
+         for (c = 0; c < file->channels; c++) {
+            if (strcmp(file->signal, "sweep") == 0) {
+               if (c == 0) {
+                  freq = 20 * exp(ratio * (frame + i) / total);
+                  phase += 2 * M_PI * freq / RATE;
+                  if (phase > 2 * M_PI)
+                     phase -= 2 * M_PI;
+               }
+               chunk[i * file->channels + c]
+                  = 16000 * sin(phase - c * M_PI / 2);
+            }
+            else
+               chunk[i * file->channels + c]
+                  = (int16_t) (next_noise(&seed) >> 16) / 2;
+         }
+      /* The corpus is written little-endian whatever the host is. */
+      for (i = 0; i < count * file->channels; i++)
+         put_le((unsigned char *) &chunk[i], (uint16_t) chunk[i], 2);
+      if (fwrite(chunk, 2 * file->channels, count, fp) != count)
+         fail("Failed to write %s.", file->path);
+   }
+
+   free(chunk);
+   if (fclose(fp) != 0)
+      fail("Failed to write %s.", file->path);
+}
+
+/*
+ * Note: bench_file() runs pitsh once as a child process and reports
+ * the wall time, the throughput as multiples of real time and MB/s
+ * of input audio, and the peak resident set size of the child.
+ */
+static void bench_file(
+   const struct bench_options *options,
+   const struct corpus_file *file,
+   const char *engine,
+   const char *mode,
+   int size,
+   const char *io
+) {
+   char out_name[80], out_path[4160], size_arg[16], factor_arg[16], threads_arg[16];
+   const char *args[20];
+   int n = 0, status, devnull;
+   pid_t pid;
+   struct rusage usage;
+   double start, seconds;
+   bool is_pitch = strcmp(mode, "pitch") == 0;
+
+   snprintf(out_name, sizeof(out_name), "out-%s", file->name);
+   snprintf(out_path, sizeof(out_path), "%s/%s", options->dir, out_name);
+   snprintf(size_arg, sizeof(size_arg), "%d", size);
+   snprintf(factor_arg, sizeof(factor_arg), "%g",
+      is_pitch ? PITCH_FACTOR : SPEED_FACTOR);
+   snprintf(threads_arg, sizeof(threads_arg), "%d", options->threads);
+   args[n++] = options->pitsh;
+   args[n++] = "-S*";
+   args[n++] = file->name;
+   args[n++] = "-D*";
+   args[n++] = out_name;
+   args[n++] = is_pitch ? "-P" : "-T";
+   args[n++] = factor_arg;
+   args[n++] = "--size";
+   args[n++] = size_arg;
+   args[n++] = "--engine";
+   args[n++] = engine;
+   args[n++] = "--io";
+   args[n++] = io;
+   if (options->threads > 0) {
+      args[n++] = "--threads";
+      args[n++] = threads_arg;
+   }
+   args[n] = NULL;
+
+   fprintf(stderr, "Running %s %s --size %d --io %s on %s ...\n",
+      engine, mode, size, io, file->path);
+   start = now();
+   pid = fork();
+   if (pid < 0)
+      fail("Failed to fork.");
+   if (pid == 0) {
+      /* The progress bar would only slow the run down. */
+      devnull = open("/dev/null", O_WRONLY);
+      if (devnull >= 0)
+         dup2(devnull, STDOUT_FILENO);
+      /* pitsh takes its paths relative to the working directory. */
+      if (chdir(options->dir) != 0)
+         _exit(127);
+      execv(options->pitsh, (char **) args);
+      _exit(127);
+   }
+   if (wait4(pid, &status, 0, &usage) != pid)
+      fail("Failed to wait for pitsh.");
+   seconds = now() - start;
+   remove(out_path);
+
+   printf("{\"bench\":\"file\",\"signal\":\"%s\",\"channels\":%d,"
+          "\"duration_s\":%d,\"engine\":\"%s\",\"mode\":\"%s\",\"size\":%d,"
+          "\"io\":\"%s\","
+          "\"ok\":%s,\"wall_s\":%.4f,\"realtime_x\":%.2f,\"mb_per_s\":%.2f,"
+          "\"peak_rss_kb\":%ld}\n",
+      file->signal, file->channels, file->duration, engine, mode, size, io,
+      WIFEXITED(status) && WEXITSTATUS(status) == 0 ? "true" : "false",
+      seconds, file->duration / seconds,
+      file->data_size / seconds / 1e6, usage.ru_maxrss);
+   fflush(stdout);
+}
+
+/*
+ * Note: bench_realtime() feeds 60 seconds of a sweep through
+ * pitsh_process_block block by block and reports the mean, the 99th
+ * percentile and the worst time per block next to the budget, the
+ * time a block lasts. A live chain misses a deadline whenever a
+ * block takes longer than the budget; it returns true if any did.
+ */
+static bool bench_realtime(int block, int grain_size, int channels) {
+   struct pitsh_processor *processor;
+   struct pitsh_config config;
+   int16_t *in, *out;
+   double *times, start, sum = 0, worst = 0, p99, t;
+   int count = 60 * RATE / block, i, j, k, over = 0;
+   double phase = 0, budget = (double) block / RATE;
+
+   config.mode = PITSH_MODE_PITCH;
+   config.factor = PITCH_FACTOR;
+   config.grain_size = grain_size;
+   config.num_channels = channels;
+   config.window = PITSH_WINDOW_HANN;
+   config.window_ratio = 0;
+   if (pitsh_create(&processor) != PITSH_OK
+       || pitsh_configure(processor, &config) != PITSH_OK)
+      fail("Failed to configure a libpitsh processor.");
+
+   in = malloc(sizeof(int16_t) * block * channels);
+   out = malloc(sizeof(int16_t) * block * channels);
+   times = malloc(sizeof(double) * count);
+   if (in == NULL || out == NULL || times == NULL)
+      fail("Failed to allocate memory.");
+
+   for (i = 0; i < count; i++) {
+      for (j = 0; j < block; j++) {
+         phase += 2 * M_PI * (200 + 1800.0 * i / count) / RATE;
+         for (k = 0; k < channels; k++)
+            in[j * channels + k] = 16000 * sin(phase);
+      }
+      start = now();
+      pitsh_process_block(processor, in, out, block);
+      times[i] = now() - start;
+      sum += times[i];
+      if (times[i] > worst)
+         worst = times[i];
+      if (times[i] > budget)
+         over++;
+   }
+
+   /* The 99th percentile by a partial selection sort of the top 1%. */
+   for (i = 0; i <= count / 100; i++)
+      for (j = i + 1; j < count; j++)
+         if (times[j] > times[i]) {
+            t = times[i];
+            times[i] = times[j];
+            times[j] = t;
+         }
+   p99 = times[count / 100];
+
+   printf("{\"bench\":\"realtime\",\"block\":%d,\"size\":%d,\"channels\":%d,"
+          "\"latency\":%zu,\"blocks\":%d,\"budget_us\":%.1f,\"mean_us\":%.2f,"
+          "\"p99_us\":%.2f,\"max_us\":%.2f,\"over_budget\":%d}\n",
+      block, grain_size, channels, pitsh_latency(processor), count,
+      budget * 1e6, sum / count * 1e6, p99 * 1e6, worst * 1e6, over);
+   fflush(stdout);
+
+   free(in);
+   free(out);
+   free(times);
+   pitsh_destroy(processor);
+
+   return over > 0;
+}
+
+static double now(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Note: xorshift32 */
+static uint32_t next_noise(uint32_t *state) {
+   uint32_t x = *state;
+
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   *state = x;
+   return x;
+}
+
+static void put_le(unsigned char *p, uint32_t value, int bytes) {
+   int i;
+
+   for (i = 0; i < bytes; i++)
+      p[i] = value >> (8 * i) & 0xFF;
+}
\ No newline at end of file
@@ -0,0 +1,710 @@
+#define _GNU_SOURCE   /* fallocate and O_DIRECT */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "audio_io.h"
+#include "miscellaneous.h"
+#include "stats.h"
+#include "sample_format.h"
+
+static void unrealize(struct audio_io *);
+static void abandon(void *);
+static void unrealize_io_buffers(struct io_buffers *);
+static void grow_buffer(unsigned char **, size_t *, size_t);
+static bool map_files(struct audio_io *, uint64_t, uint64_t);
+static const void *read_stdio(struct audio_io *, size_t *);
+static void *reserve_stdio(struct audio_io *, size_t);
+static void commit_stdio(struct audio_io *, size_t);
+static const void *read_mmap(struct audio_io *, size_t *);
+static void *reserve_mmap(struct audio_io *, size_t);
+static void commit_mmap(struct audio_io *, size_t);
+static void start_read_ahead(struct audio_io *, const struct wav_info *, int);
+static const void *read_ring(struct audio_io *, size_t *);
+static void *reserve_ring(struct audio_io *, size_t);
+static void commit_ring(struct audio_io *, size_t);
+static void *fill_src_ring(void *);
+static bool start_uring(struct audio_io *, const struct wav_info *, int);
+static void *reserve_uring(struct audio_io *, size_t);
+static void commit_uring(struct audio_io *, size_t);
+static const void *next_src_slot(struct audio_io *, size_t *);
+static void drop_src_slot(struct audio_io *);
+static void *drain_dest_ring(void *);
+static bool allocate_dest(struct audio_io *, uint64_t);
+static bool start_direct(struct audio_io *);
+static bool write_dest(struct audio_io *, const void *, size_t);
+static bool finish_direct(struct audio_io *);
+static bool finish_dest(struct audio_io *);
+
+struct io_buffers *realize_io_buffers(void) {
+   struct io_buffers *objptr;
+
+   objptr = malloc(sizeof(struct io_buffers));
+   if (objptr == NULL)
+      raise_err("%s: Failed to create a new struct io_buffers.", __func__);
+   objptr->self = objptr;
+   objptr->unrealize = unrealize_io_buffers;
+   objptr->src_buf_len = 0;
+   objptr->dest_buf_len = 0;
+   objptr->src_buf = NULL;
+   objptr->dest_buf = NULL;
+
+   return objptr;
+}
+
+struct audio_io *realize_audio_io(
+   FILE *src,
+   FILE *dest,
+   int backend,
+   const struct wav_info *info,
+   uint64_t dest_size_hint,
+   size_t src_buf_len,
+   size_t dest_buf_len,
+   struct io_buffers *buffers,
+   int read_ahead,
+   bool is_direct,
+   const bool *cancel,
+   bool is_stream
+) {
+   struct audio_io *objptr;
+   int result;
+
+   objptr = malloc(sizeof(struct audio_io));
+   if (objptr == NULL)
+      raise_err("%s: Failed to create a new struct audio_io.", __func__);
+   objptr->self = objptr;
+   objptr->unrealize = unrealize;
+   objptr->src = src;
+   objptr->dest = dest;
+   objptr->sample_size = sample_size(info->sample_format);
+   objptr->header_size = wav_header_size(info);
+   objptr->src_buf_len = src_buf_len;
+   objptr->dest_buf_len = dest_buf_len;
+   objptr->src_buf = NULL;
+   objptr->dest_buf = NULL;
+   objptr->src_map = NULL;
+   objptr->dest_map = NULL;
+   objptr->read_ahead = 0;
+   objptr->src_failed = false;
+   objptr->dest_failed = false;
+   objptr->uring = NULL;
+   objptr->src_ring = NULL;
+   objptr->dest_ring = NULL;
+   objptr->is_allocated = false;
+   objptr->cancel = cancel;
+   objptr->is_cut_short = false;
+   objptr->direct_fd = -1;
+   objptr->direct_buf = NULL;
+   push_err_cleanup(abandon, objptr);
+
+   /* The header written ahead goes out before any other writes. */
+   if (fflush(dest) != 0)
+      raise_err("%s: Failed to write the header.", __func__);
+   if (!is_stream && dest_size_hint > 0)
+      objptr->is_allocated = allocate_dest(objptr, dest_size_hint);
+   if (is_direct && !is_stream)
+      backend = IO_STDIO;
+
+   if (backend == IO_MMAP && !is_stream
+       && map_files(objptr, info->subchunk_2_size, dest_size_hint)) {
+      objptr->backend = IO_MMAP;
+      objptr->read = read_mmap;
+      objptr->reserve = reserve_mmap;
+      objptr->commit = commit_mmap;
+      return objptr;
+   }
+
+   grow_buffer(&buffers->src_buf, &buffers->src_buf_len,
+      src_buf_len * objptr->sample_size);
+   objptr->src_buf = buffers->src_buf;
+   if (backend == IO_URING && !is_stream
+       && start_uring(objptr, info, read_ahead > 0 ? read_ahead : 1))
+      return objptr;
+
+   objptr->backend = IO_STDIO;
+   objptr->read = read_stdio;
+   objptr->reserve = reserve_stdio;
+   objptr->commit = commit_stdio;
+   if (!is_stream) {
+      result = fseeko(dest, objptr->header_size, SEEK_SET);
+      if (result != 0)
+         raise_err("%s: Failed to seek the file position.", __func__);
+   }
+   grow_buffer(&buffers->dest_buf, &buffers->dest_buf_len,
+      dest_buf_len * objptr->sample_size);
+   objptr->dest_buf = buffers->dest_buf;
+   if (is_direct && !is_stream)
+      start_direct(objptr);
+   if (read_ahead > 0)
+      start_read_ahead(objptr, info, read_ahead);
+
+   return objptr;
+}
+
+bool is_io_cancelled(struct audio_io *io) {
+   if (io->cancel != NULL && __atomic_load_n(io->cancel, __ATOMIC_RELAXED))
+      io->is_cut_short = true;
+   return io->is_cut_short;
+}
+
+/*
+ * Note: map_files() maps the whole source file read-only and
+ * the destination file, grown to the expected size, read-write.
+ * It returns false, leaving nothing mapped, if either of them
+ * is not a regular file or can't be mapped.
+ */
+static bool map_files(
+   struct audio_io *io,
+   uint64_t data_size,
+   uint64_t dest_size_hint
+) {
+   struct stat st;
+   off_t offset;
+   int src_fd = fileno(io->src), dest_fd = fileno(io->dest);
+   void *map;
+
+   offset = ftello(io->src);
+   if (offset < 0 || fstat(src_fd, &st) != 0 || !S_ISREG(st.st_mode)
+       || st.st_size <= offset || (uint64_t) st.st_size > SIZE_MAX
+       || (uint64_t) io->header_size + dest_size_hint > SIZE_MAX)
+      return false;
+   map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, src_fd, 0);
+   if (map == MAP_FAILED)
+      return false;
+   io->src_map = map;
+   io->src_map_len = st.st_size;
+   io->src_pos = offset;
+   /* The declared size may exceed what the file really holds. */
+   io->src_end = data_size < (uint64_t) (st.st_size - offset)
+                 ? (size_t) (offset + data_size) : (size_t) st.st_size;
+   madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+   io->dest_map_len = io->header_size + dest_size_hint;
+   if (fstat(dest_fd, &st) != 0 || !S_ISREG(st.st_mode)
+       || ftruncate(dest_fd, io->dest_map_len) != 0
+       || (map = mmap(NULL, io->dest_map_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, dest_fd, 0)) == MAP_FAILED) {
+      munmap(io->src_map, io->src_map_len);
+      io->src_map = NULL;
+      return false;
+   }
+   io->dest_map = map;
+   io->dest_pos = io->header_size;
+
+   return true;
+}
+
+static const void *read_stdio(struct audio_io *io, size_t *count) {
+   uint64_t start = stats_begin();
+   int size = io->sample_size;
+
+   if (*count > io->src_buf_len)
+      *count = io->src_buf_len;
+   *count = fread(io->src_buf, size, *count, io->src);
+   if (ferror(io->src))
+      raise_err("%s: Failed to read audio data.", __func__);
+   stats_end(STAGE_READ, start);
+   stats_count(COUNT_BYTES_READ, *count * size);
+
+   return io->src_buf;
+}
+
+static void *reserve_stdio(struct audio_io *io, size_t count) {
+   if (count > io->dest_buf_len)
+      raise_err("%s: %zu samples requested > %zu.",
+         __func__, count, io->dest_buf_len);
+
+   return io->dest_buf;
+}
+
+static void commit_stdio(struct audio_io *io, size_t count) {
+   uint64_t start = stats_begin();
+   int size = io->sample_size;
+
+   if (!write_dest(io, io->dest_buf, count * size))
+      raise_err("%s: Failed to write data.", __func__);
+   stats_end(STAGE_WRITE, start);
+   stats_count(COUNT_BYTES_WRITTEN, count * size);
+}
+
+/*
+ * Note: With the mappings, the pages are read and written while the
+ * samples are processed, so the read and write stages only cover
+ * handing out the memory and growing the destination.
+ */
+static const void *read_mmap(struct audio_io *io, size_t *count) {
+   uint64_t start = stats_begin();
+   int size = io->sample_size;
+   const void *data = io->src_map + io->src_pos;
+   size_t left = (io->src_end - io->src_pos) / size;
+
+   if (*count > left)
+      *count = left;
+   io->src_pos += *count * size;
+   stats_end(STAGE_READ, start);
+   stats_count(COUNT_BYTES_READ, *count * size);
+
+   return data;
+}
+
+static void *reserve_mmap(struct audio_io *io, size_t count) {
+   size_t need = io->dest_pos + count * io->sample_size;
+   int dest_fd = fileno(io->dest);
+   void *map;
+   uint64_t start;
+
+   /* Grow the destination if the expected size was too small. */
+   if (need > io->dest_map_len) {
+      start = stats_begin();
+      if (need < io->dest_map_len * 2)
+         need = io->dest_map_len * 2;
+      munmap(io->dest_map, io->dest_map_len);
+      io->dest_map = NULL;
+      if (ftruncate(dest_fd, need) != 0)
+         raise_err("%s: Failed to resize the destination file.", __func__);
+      map = mmap(NULL, need, PROT_READ | PROT_WRITE, MAP_SHARED, dest_fd, 0);
+      if (map == MAP_FAILED)
+         raise_err("%s: Failed to map the destination file.", __func__);
+      io->dest_map = map;
+      io->dest_map_len = need;
+      stats_end(STAGE_WRITE, start);
+   }
+
+   return io->dest_map + io->dest_pos;
+}
+
+static void commit_mmap(struct audio_io *io, size_t count) {
+   io->dest_pos += count * io->sample_size;
+   stats_count(COUNT_BYTES_WRITTEN, count * io->sample_size);
+}
+
+/*
+ * Note: start_read_ahead() replaces the stdio functions with the
+ * ones over the rings. The reader stops at the end of the audio
+ * data, as far as its size is known, so that it doesn't read the
+ * chunks after it while the caller has no use for them. read_ahead
+ * is only set once both threads run, for them to be joined.
+ */
+static void start_read_ahead(
+   struct audio_io *io,
+   const struct wav_info *info,
+   int read_ahead
+) {
+   size_t size = io->sample_size;
+
+   io->src_ring = realize_spsc_ring(read_ahead, io->src_buf_len * size);
+   io->dest_ring = realize_spsc_ring(read_ahead, io->dest_buf_len * size);
+   io->src_left = info->subchunk_2_size;
+   io->src_slot = NULL;
+   io->read = read_ring;
+   io->reserve = reserve_ring;
+   io->commit = commit_ring;
+   if (pthread_create(&io->reader, NULL, fill_src_ring, io) != 0)
+      raise_err("%s: Failed to create an I/O thread.", __func__);
+   if (pthread_create(&io->writer, NULL, drain_dest_ring, io) != 0) {
+      close_ring(io->src_ring);
+      pthread_join(io->reader, NULL);
+      raise_err("%s: Failed to create an I/O thread.", __func__);
+   }
+   io->read_ahead = read_ahead;
+}
+
+/*
+ * Note: read_ring() hands out the slot in place when it holds all
+ * of what is asked for, which is the case whenever the caller asks
+ * for as much as it did before. Otherwise the samples are gathered
+ * from as many slots as it takes into src_buf. A slot handed out is
+ * only released on the next call, as its memory has to stay valid
+ * until then. The slots come from the reader thread, or from
+ * io_uring with IO_URING.
+ */
+static const void *read_ring(struct audio_io *io, size_t *count) {
+   size_t size = io->sample_size;
+   size_t want, got = 0, len;
+   const void *slot;
+
+   if (*count > io->src_buf_len)
+      *count = io->src_buf_len;
+   want = *count * size;
+   if (io->src_slot != NULL && io->src_slot_pos == io->src_slot_len) {
+      drop_src_slot(io);
+      io->src_slot = NULL;
+   }
+   while (got < want) {
+      if (io->src_slot == NULL) {
+         slot = next_src_slot(io, &io->src_slot_len);
+         if (slot == NULL)
+            break;
+         io->src_slot = slot;
+         io->src_slot_pos = 0;
+      }
+      len = io->src_slot_len - io->src_slot_pos;
+      if (got == 0 && len >= want) {
+         io->src_slot_pos += want;
+         return io->src_slot + io->src_slot_pos - want;
+      }
+      if (len > want - got)
+         len = want - got;
+      memcpy(io->src_buf + got, io->src_slot + io->src_slot_pos, len);
+      got += len;
+      io->src_slot_pos += len;
+      if (io->src_slot_pos == io->src_slot_len) {
+         drop_src_slot(io);
+         io->src_slot = NULL;
+      }
+   }
+   if (__atomic_load_n(&io->src_failed, __ATOMIC_SEQ_CST))
+      raise_err("%s: Failed to read audio data.", __func__);
+   *count = got / size;
+
+   return io->src_buf;
+}
+
+static void *reserve_ring(struct audio_io *io, size_t count) {
+   void *slot;
+
+   if (count > io->dest_buf_len)
+      raise_err("%s: %zu samples requested > %zu.",
+         __func__, count, io->dest_buf_len);
+   slot = acquire_slot(io->dest_ring);
+   if (slot == NULL)
+      raise_err("%s: Failed to write data.", __func__);
+
+   return slot;
+}
+
+static void commit_ring(struct audio_io *io, size_t count) {
+   publish_slot(io->dest_ring, count * io->sample_size);
+}
+
+static const void *next_src_slot(struct audio_io *io, size_t *len) {
+   if (io->backend == IO_URING)
+      return peek_uring_slot(io->uring, len);
+   return peek_slot(io->src_ring, len);
+}
+
+static void drop_src_slot(struct audio_io *io) {
+   if (io->backend == IO_URING)
+      release_uring_slot(io->uring);
+   else
+      release_slot(io->src_ring);
+}
+
+/*
+ * Note: start_uring() hands the two files over to io_uring, which
+ * reads and writes them at explicit offsets: the source from where
+ * src stands and the destination after its header. It returns
+ * false if io_uring can't be used.
+ */
+static bool start_uring(
+   struct audio_io *io,
+   const struct wav_info *info,
+   int depth
+) {
+   off_t offset = ftello(io->src);
+
+   if (offset < 0)
+      return false;
+   io->uring = realize_uring_io(
+      fileno(io->src), offset, info->subchunk_2_size,
+      fileno(io->dest), io->header_size,
+      io->src_buf_len * io->sample_size, io->dest_buf_len * io->sample_size,
+      depth);
+   if (io->uring == NULL)
+      return false;
+   io->backend = IO_URING;
+   io->src_slot = NULL;
+   io->read = read_ring;
+   io->reserve = reserve_uring;
+   io->commit = commit_uring;
+
+   return true;
+}
+
+static void *reserve_uring(struct audio_io *io, size_t count) {
+   if (count > io->dest_buf_len)
+      raise_err("%s: %zu samples requested > %zu.",
+         __func__, count, io->dest_buf_len);
+
+   return reserve_uring_slot(io->uring);
+}
+
+static void commit_uring(struct audio_io *io, size_t count) {
+   commit_uring_slot(io->uring, count * io->sample_size);
+}
+
+/* Note: fill_src_ring() is the reader thread. */
+static void *fill_src_ring(void *arg) {
+   struct audio_io *io = arg;
+   size_t size = io->sample_size;
+   size_t count, got;
+   void *slot;
+   uint64_t start;
+
+   for (;;) {
+      count = io->src_buf_len;
+      if (io->src_left / size < count)
+         count = io->src_left / size;
+      if (count == 0)
+         break;
+      slot = acquire_slot(io->src_ring);
+      if (slot == NULL)
+         break;
+      start = stats_begin();
+      got = fread(slot, size, count, io->src);
+      stats_end(STAGE_READ, start);
+      stats_count(COUNT_BYTES_READ, got * size);
+      if (ferror(io->src)) {
+         __atomic_store_n(&io->src_failed, true, __ATOMIC_SEQ_CST);
+         break;
+      }
+      if (got > 0)
+         publish_slot(io->src_ring, got * size);
+      io->src_left -= got * size;
+      if (got < count)
+         break;
+   }
+   close_ring(io->src_ring);
+
+   return NULL;
+}
+
+/*
+ * Note: drain_dest_ring() is the writer thread. On a failure, it
+ * closes the ring, so that the next reserve raises the error.
+ */
+static void *drain_dest_ring(void *arg) {
+   struct audio_io *io = arg;
+   const void *slot;
+   size_t len;
+   uint64_t start;
+
+   while ((slot = peek_slot(io->dest_ring, &len)) != NULL) {
+      start = stats_begin();
+      if (!write_dest(io, slot, len)) {
+         __atomic_store_n(&io->dest_failed, true, __ATOMIC_SEQ_CST);
+         close_ring(io->dest_ring);
+         break;
+      }
+      stats_end(STAGE_WRITE, start);
+      stats_count(COUNT_BYTES_WRITTEN, len);
+      release_slot(io->dest_ring);
+   }
+
+   return NULL;
+}
+
+/*
+ * Note: allocate_dest() reserves the blocks of the whole output at
+ * once, so that the file is laid out in one piece rather than grown
+ * write by write, and a full disk shows up here rather than in the
+ * middle of the mapping. It returns false where it is unsupported.
+ */
+static bool allocate_dest(struct audio_io *io, uint64_t dest_size_hint) {
+#ifdef __linux__
+   return fallocate(fileno(io->dest), 0, 0,
+                    (off_t) (io->header_size + dest_size_hint)) == 0;
+#else
+   return false;
+#endif
+}
+
+/*
+ * Note: start_direct() stages the header written ahead again, so
+ * that the first block is written whole, and then turns O_DIRECT
+ * on for dest. It leaves dest as it is, returning false, where
+ * O_DIRECT is unsupported, e.g. by the file system.
+ */
+static bool start_direct(struct audio_io *io) {
+#ifdef O_DIRECT
+   int fd = fileno(io->dest), flags;
+   void *buf = NULL;
+
+   if (posix_memalign(&buf, DIRECT_ALIGN, DIRECT_BATCH) != 0)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   if (pread(fd, buf, io->header_size, 0) != (ssize_t) io->header_size
+       || (flags = fcntl(fd, F_GETFL)) < 0
+       || fcntl(fd, F_SETFL, flags | O_DIRECT) != 0) {
+      free(buf);
+      return false;
+   }
+   stats_alloc(DIRECT_BATCH);
+   io->direct_buf = buf;
+   io->direct_fd = fd;
+   io->direct_pos = 0;
+   io->direct_len = io->header_size;
+
+   return true;
+#else
+   return false;
+#endif
+}
+
+/* Note: write_dest() appends len bytes to dest; false on failure. */
+static bool write_dest(struct audio_io *io, const void *data, size_t len) {
+   const unsigned char *pos = data;
+   size_t part;
+
+   if (io->direct_fd < 0)
+      return fwrite(data, 1, len, io->dest) == len;
+   while (len > 0) {
+      part = DIRECT_BATCH - io->direct_len;
+      if (part > len)
+         part = len;
+      memcpy(io->direct_buf + io->direct_len, pos, part);
+      io->direct_len += part;
+      pos += part;
+      len -= part;
+      if (io->direct_len < DIRECT_BATCH)
+         continue;
+      if (pwrite(io->direct_fd, io->direct_buf, DIRECT_BATCH,
+                 io->direct_pos) != DIRECT_BATCH)
+         return false;
+      io->direct_pos += DIRECT_BATCH;
+      io->direct_len = 0;
+   }
+
+   return true;
+}
+
+/*
+ * Note: finish_direct() writes out the rest, padded to a whole
+ * block, turns O_DIRECT off again for the header to be rewritten,
+ * and cuts the padding off.
+ */
+static bool finish_direct(struct audio_io *io) {
+#ifdef O_DIRECT
+   size_t len = io->direct_len, padded;
+   int flags;
+
+   padded = (len + DIRECT_ALIGN - 1) / DIRECT_ALIGN * DIRECT_ALIGN;
+   memset(io->direct_buf + len, 0, padded - len);
+   if (padded > 0
+       && pwrite(io->direct_fd, io->direct_buf, padded,
+                 io->direct_pos) != (ssize_t) padded)
+      return false;
+   flags = fcntl(io->direct_fd, F_GETFL);
+
+   return flags >= 0
+          && fcntl(io->direct_fd, F_SETFL, flags & ~O_DIRECT) == 0
+          && ftruncate(io->direct_fd, io->direct_pos + len) == 0;
+#else
+   return false;
+#endif
+}
+
+/*
+ * Note: finish_dest() cuts the output of IO_STDIO back to what has
+ * been written, in case it was allocated for more, e.g. when the
+ * input ended early. It returns false on failure.
+ */
+static bool finish_dest(struct audio_io *io) {
+   off_t end;
+
+   if (io->direct_fd >= 0)
+      return finish_direct(io);
+   if (!io->is_allocated)
+      return true;
+
+   return fflush(io->dest) == 0 && (end = ftello(io->dest)) >= 0
+          && ftruncate(fileno(io->dest), end) == 0;
+}
+
+/*
+ * Note: With read-ahead, unrealize() stops the reader, which may
+ * still be ahead of the end that the caller wanted, and lets the
+ * writer finish everything committed before it joins them. A
+ * failure is raised once everything has been released.
+ */
+static void unrealize(struct audio_io *objptr) {
+   const char *failure = NULL;
+   uint64_t dest_end;
+
+   pop_err_cleanup(objptr);
+   if (objptr->uring != NULL) {
+      if (!finish_uring_io(objptr->uring))
+         failure = "Failed to write data.";
+      dest_end = objptr->uring->dest_offset;
+      objptr->uring->unrealize(objptr->uring->self);
+      if (failure == NULL && objptr->is_allocated
+          && ftruncate(fileno(objptr->dest), dest_end) != 0)
+         failure = "Failed to finish the destination file.";
+   }
+   if (objptr->read_ahead > 0) {
+      close_ring(objptr->src_ring);
+      close_ring(objptr->dest_ring);
+      pthread_join(objptr->reader, NULL);
+      pthread_join(objptr->writer, NULL);
+      objptr->src_ring->unrealize(objptr->src_ring->self);
+      objptr->dest_ring->unrealize(objptr->dest_ring->self);
+      if (objptr->dest_failed)
+         failure = "Failed to write data.";
+   }
+   if (objptr->src_map != NULL)
+      munmap(objptr->src_map, objptr->src_map_len);
+   if (objptr->dest_map != NULL) {
+      if (munmap(objptr->dest_map, objptr->dest_map_len) != 0
+          || ftruncate(fileno(objptr->dest), objptr->dest_pos) != 0)
+         failure = "Failed to finish the destination file.";
+   }
+   else if (objptr->backend == IO_STDIO && failure == NULL
+            && !finish_dest(objptr))
+      failure = "Failed to finish the destination file.";
+   free(objptr->direct_buf);
+   free(objptr->self);
+   if (failure != NULL)
+      raise_err("%s: %s", __func__, failure);
+}
+
+/*
+ * Note: abandon() is the cleanup pushed by realize_audio_io, for a
+ * file that fails before unrealize. It stops the I/O threads and
+ * waits for the io_uring requests, which use the buffers, and
+ * releases the rest, leaving the output as it is for the caller to
+ * remove.
+ */
+static void abandon(void *arg) {
+   struct audio_io *objptr = arg;
+
+   if (objptr->uring != NULL) {
+      finish_uring_io(objptr->uring);
+      objptr->uring->unrealize(objptr->uring->self);
+   }
+   if (objptr->read_ahead > 0) {
+      close_ring(objptr->src_ring);
+      close_ring(objptr->dest_ring);
+      pthread_join(objptr->reader, NULL);
+      pthread_join(objptr->writer, NULL);
+   }
+   if (objptr->src_ring != NULL)
+      objptr->src_ring->unrealize(objptr->src_ring->self);
+   if (objptr->dest_ring != NULL)
+      objptr->dest_ring->unrealize(objptr->dest_ring->self);
+   if (objptr->src_map != NULL)
+      munmap(objptr->src_map, objptr->src_map_len);
+   if (objptr->dest_map != NULL)
+      munmap(objptr->dest_map, objptr->dest_map_len);
+   free(objptr->direct_buf);
+   free(objptr->self);
+}
+
+/* Note: grow_buffer() makes sure that buf can hold len bytes. */
+static void grow_buffer(unsigned char **buf, size_t *cap, size_t len) {
+   if (len <= *cap)
+      return;
+   free(*buf);
+   *cap = 0;
+   *buf = malloc(len);
+   if (*buf == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   stats_alloc(len);
+   *cap = len;
+}
+
+static void unrealize_io_buffers(struct io_buffers *objptr) {
+   free(objptr->src_buf);
+   free(objptr->dest_buf);
+   free(objptr->self);
+}
\ No newline at end of file
@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <errno.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "batch.h"
+#include "command_line.h"
+#include "wave_file.h"
+#include "processing.h"
+#include "worker_pool.h"
+#include "window_table.h"
+#include "audio_io.h"
+#include "miscellaneous.h"
+
+#define COMMENT '#'
+#define MANIFEST_LINE_MAX 1024
+
+struct batch_job {
+   char *src_name;
+   char *dest_name;
+   double factor;
+
+   /* Note: kept here rather than on the stack to survive longjmp. */
+   FILE *src;
+   FILE *dest;
+   char *dest_path;
+   uint64_t size;
+   bool is_failed;
+};
+
+struct batch {
+   struct execution_options *options;
+   struct env_data *env;
+   bool is_le;
+   struct window_cache *windows;
+   struct fft_cache *plans;
+   int grain_threads;   /* threads per file */
+
+   pthread_mutex_t lock;
+   int next;        /* the next job to be taken */
+   int finished;
+   int failed;
+
+   /* fields to be freed */
+   struct batch_job *jobs;
+   int job_count;
+   char *text;      /* the manifest; the job names point into it */
+};
+
+static void read_manifest(struct batch *, char *);
+static void *work(void *);
+static void process_job(
+   struct batch *, struct batch_job *, struct processing_context *);
+
+int run_batch(
+   struct execution_options *options,
+   struct env_data *env,
+   bool is_le
+) {
+   struct batch batch;
+   pthread_t *threads;
+   int file_threads;
+   int i;
+
+   batch.options = options;
+   batch.env = env;
+   batch.is_le = is_le;
+   batch.next = 0;
+   batch.finished = 0;
+   batch.failed = 0;
+   read_manifest(&batch, options->batch_name);
+
+   /*
+    * Files are spread across the threads first; when there are fewer
+    * files than threads, the rest work on the grains of each file.
+    */
+   file_threads = options->threads;
+   if (file_threads > batch.job_count)
+      file_threads = batch.job_count > 0 ? batch.job_count : 1;
+   batch.grain_threads = options->threads / file_threads;
+   batch.windows = realize_window_cache();
+   batch.plans = realize_fft_cache();
+   if (pthread_mutex_init(&batch.lock, NULL) != 0)
+      raise_err("%s: Failed to initialize the mutex.", __func__);
+   threads = malloc(sizeof(pthread_t) * file_threads);
+   if (threads == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+
+   for (i = 0; i < file_threads; i++)
+      if (pthread_create(&threads[i], NULL, work, &batch) != 0)
+         raise_err("%s: Failed to create a worker thread.", __func__);
+   for (i = 0; i < file_threads; i++)
+      pthread_join(threads[i], NULL);
+
+   printf("Batch done: %d succeeded, %d failed.\n",
+      batch.job_count - batch.failed, batch.failed);
+
+   free(threads);
+   pthread_mutex_destroy(&batch.lock);
+   batch.plans->unrealize(batch.plans->self);
+   batch.windows->unrealize(batch.windows->self);
+   free(batch.jobs);
+   free(batch.text);
+
+   return batch.failed;
+}
+
+/*
+ * Note: read_manifest() reads the whole manifest at once and cuts
+ * it into lines and fields in place. Empty lines and lines starting
+ * with '#' are ignored, as in the .env file.
+ */
+static void read_manifest(struct batch *batch, char *manifest_name) {
+   FILE *manifest;
+   long size = 0;
+   char *line, *next_line, *field, *indicator;
+   struct batch_job *job;
+   int capacity = 0;
+
+   manifest = fopen(manifest_name, "rb");
+   if (manifest == NULL)
+      raise_err("%s: Failed to open the manifest %s.",
+         __func__, manifest_name);
+   if (fseek(manifest, 0L, SEEK_END) != 0 || (size = ftell(manifest)) < 0)
+      raise_err("%s: Failed to get the size of the manifest.", __func__);
+   rewind(manifest);
+   batch->text = malloc(size + 1);
+   if (batch->text == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   if (fread(batch->text, 1, size, manifest) != (size_t) size)
+      raise_err("%s: Failed to read the manifest.", __func__);
+   batch->text[size] = '\0';
+   if (fclose(manifest) == EOF)
+      raise_err("%s: Failed to close the manifest.", __func__);
+
+   batch->jobs = NULL;
+   batch->job_count = 0;
+   for (line = batch->text; line != NULL; line = next_line) {
+      next_line = strchr(line, '\n');
+      if (next_line != NULL)
+         *next_line++ = '\0';
+      if (strlen(line) > MANIFEST_LINE_MAX)
+         raise_err("%s: A manifest line is too long (> %d).",
+            __func__, MANIFEST_LINE_MAX);
+      field = strtok(line, " \t\r");
+      if (field == NULL || field[0] == COMMENT)
+         continue;
+
+      if (batch->job_count == capacity) {
+         capacity = capacity == 0 ? 16 : capacity * 2;
+         job = realloc(batch->jobs, sizeof(struct batch_job) * capacity);
+         if (job == NULL)
+            raise_err("%s: Failed to allocate memory dynamically.", __func__);
+         batch->jobs = job;
+      }
+      job = &batch->jobs[batch->job_count++];
+      job->src_name = field;
+      job->dest_name = strtok(NULL, " \t\r");
+      job->factor = batch->options->factor;
+      job->src = NULL;
+      job->dest = NULL;
+      job->dest_path = NULL;
+      if (job->dest_name == NULL)
+         raise_err("%s: No destination for %s in the manifest.",
+            __func__, job->src_name);
+
+      /* A bad factor is reported with the job rather than here. */
+      field = strtok(NULL, " \t\r");
+      if (field != NULL) {
+         errno = 0;
+         job->factor = strtod(field, &indicator);
+         if (indicator == field || *indicator != '\0' || errno == ERANGE)
+            job->factor = -1;
+      }
+   }
+}
+
+static void *work(void *arg) {
+   struct batch *batch = arg;
+   struct processing_context context;
+   int idx;
+
+   context.pool = realize_worker_pool(batch->grain_threads);
+   context.windows = batch->windows;
+   context.plans = batch->plans;
+   context.buffers = realize_io_buffers();
+   context.cancel = NULL;
+
+   for (;;) {
+      pthread_mutex_lock(&batch->lock);
+      idx = batch->next < batch->job_count ? batch->next++ : -1;
+      pthread_mutex_unlock(&batch->lock);
+      if (idx == -1)
+         break;
+      process_job(batch, &batch->jobs[idx], &context);
+   }
+
+   context.buffers->unrealize(context.buffers->self);
+   context.pool->unrealize(context.pool->self);
+
+   return NULL;
+}
+
+/*
+ * Note: process_job() goes through the same steps as main() does
+ * for a single file. Errors come back through the err_trap, so
+ * that they only fail this job; what the job has acquired by then
+ * is released by the cleanups pushed to the err_trap, and what it
+ * has written is removed.
+ */
+static void process_job(
+   struct batch *batch,
+   struct batch_job *job,
+   struct processing_context *context
+) {
+   struct err_trap trap;
+   struct execution_options options = *batch->options;
+   struct wav_info info;
+   uint32_t sample_number;
+
+   options.src_name = job->src_name;
+   options.dest_name = job->dest_name;
+   options.factor = job->factor;
+   options.stream_src = false;
+   options.stream_dest = false;
+   options.verbose = false;
+   options.show_progress = false;
+
+   job->is_failed = false;
+   if (setjmp(trap.env) == 0) {
+      set_err_trap(&trap);
+      if (strcmp(job->src_name, STREAM_NAME) == 0
+          || strcmp(job->dest_name, STREAM_NAME) == 0)
+         raise_err("%s: Streams can't be used in a batch.", __func__);
+      if (options.factor < 0 || options.factor > MAX_FACTOR_VALUE)
+         raise_err("%s: An invalid factor value.", __func__);
+      job->dest_path = open_wav(&options, batch->env, &job->src, &job->dest);
+      observe_wav(job->src, &info, batch->is_le, false);
+      assess_wav_info(&info);
+      sample_number = process_audio_data(
+         job->src, job->dest, &info, &options, context, batch->is_le);
+      job->size = write_wav_header(
+         job->dest, &info, sample_number, batch->is_le, false);
+      close_wav(job->src, job->dest);
+      job->src = NULL;
+      job->dest = NULL;
+   }
+   else {
+      job->is_failed = true;
+      if (job->src != NULL)
+         fclose(job->src);
+      if (job->dest != NULL)
+         fclose(job->dest);
+      if (job->dest_path != NULL)
+         remove(job->dest_path);
+   }
+   set_err_trap(NULL);
+
+   pthread_mutex_lock(&batch->lock);
+   batch->finished++;
+   if (job->is_failed) {
+      batch->failed++;
+      printf("[%d/%d] FAILED %s: %s\n",
+         batch->finished, batch->job_count, job->src_name, trap.msg);
+   }
+   else
+      printf("[%d/%d] OK %s -> %s, %" PRIu64 " (bytes)\n",
+         batch->finished, batch->job_count, job->src_name,
+         job->dest_path, job->size);
+   fflush(stdout);
+   pthread_mutex_unlock(&batch->lock);
+   free(job->dest_path);
+   job->dest_path = NULL;
+}
\ No newline at end of file
@@ -2,9 +2,16 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <stdbool.h>
 #include "command_line.h"
 #include "miscellaneous.h"
+#include "audio_io.h"
+#include "window_table.h"
+#include "wave_file.h"
+#include "processing.h"
+#include "grain_plan.h"
+#include "stats.h"
 
 #define OP_SRC          "--src"
 #define OP_SRC_ABBR     "-S"
@@ -15,13 +22,33 @@
 #define OP_SPEED        "--speed"
 #define OP_SPEED_ABBR   "-T"
 #define OP_SIZE         "--size"
+#define OP_THREADS      "--threads"
+#define OP_IO           "--io"
+#define OP_READ_AHEAD   "--read-ahead"
+#define OP_DIRECT       "--direct"
+#define OP_WINDOW       "--window"
+#define OP_BATCH        "--batch"
+#define OP_PROBE        "--probe"
+#define OP_SERVE        "--serve"
+#define OP_JOBS         "--jobs"
+#define OP_REALTIME     "--realtime"
+#define OP_ENGINE       "--engine"
+#define OP_OVERLAP      "--overlap"
+#define OP_INTERP       "--interp"
+#define OP_STATS        "--stats"
+#define OP_STATS_JSON   "--stats=json"
+#define OP_PROGRESS     "--progress"
 #define OP_VB           "--verbose"
 #define OP_HELP         "--help"
 #define SUPPRESSION_CHAR      '*'
 #define SUPPRESSION_OCCURRED   1
-#define MAX_FACTOR_VALUE       3
-#define MIN_SIZE_VALUE  2205
-#define MAX_SIZE_VALUE  8820
+#define MIN_BLOCK_VALUE    64
+#define MAX_BLOCK_VALUE    1024
+#define MIN_THREADS_VALUE  1
+#define MAX_THREADS_VALUE  256
+#define MAX_READ_AHEAD_VALUE  64
+#define MIN_JOBS_VALUE     1
+#define MAX_JOBS_VALUE     64
 
 static void handle_help_option(void);
 static void handle_src_option(
@@ -45,6 +72,30 @@ static void handle_speed_option(
    unsigned int *,
    bool);
 static void handle_size_option(struct execution_options *, char *);
+static void handle_threads_option(struct execution_options *, char *);
+static void handle_io_option(struct execution_options *, char *);
+static void handle_read_ahead_option(struct execution_options *, char *);
+static void handle_window_option(struct execution_options *, char *);
+static void handle_batch_option(
+   struct execution_options *,
+   char *,
+   unsigned int *);
+static void handle_probe_option(
+   struct execution_options *,
+   char **,
+   unsigned int *);
+static void handle_serve_option(
+   struct execution_options *,
+   char *,
+   unsigned int *);
+static void handle_jobs_option(struct execution_options *, char *);
+static void handle_realtime_option(struct execution_options *, char *);
+static void handle_engine_option(struct execution_options *, char *);
+static void handle_overlap_option(struct execution_options *, char *);
+static void handle_interp_option(struct execution_options *, char *);
+static void handle_stats_option(struct execution_options *, char *);
+static void handle_progress_option(struct execution_options *, char *);
+static void handle_direct_option(struct execution_options *);
 static void handle_verbose_option(struct execution_options *);
 static void handle_unknown_argument(char *);
 
@@ -104,6 +155,63 @@ void inspect_execution_options(
          handle_size_option(options, *(argv + 1));
          argv++;
       }
+      else if (strncmp(*argv, OP_THREADS, strlen(OP_THREADS)) == 0) {
+         handle_threads_option(options, *(argv + 1));
+         argv++;
+      }
+      else if (strcmp(*argv, OP_IO) == 0) {
+         handle_io_option(options, *(argv + 1));
+         argv++;
+      }
+      else if (strcmp(*argv, OP_READ_AHEAD) == 0) {
+         handle_read_ahead_option(options, *(argv + 1));
+         argv++;
+      }
+      else if (strcmp(*argv, OP_DIRECT) == 0)
+         handle_direct_option(options);
+      else if (strncmp(*argv, OP_WINDOW, strlen(OP_WINDOW)) == 0) {
+         handle_window_option(options, *(argv + 1));
+         argv++;
+      }
+      else if (strncmp(*argv, OP_BATCH, strlen(OP_BATCH)) == 0) {
+         handle_batch_option(options, *(argv + 1), &checklist);
+         argv++;
+      }
+      else if (strcmp(*argv, OP_PROBE) == 0) {
+         /* The paths take up the rest of the arguments. */
+         handle_probe_option(options, argv + 1, &checklist);
+         break;
+      }
+      else if (strcmp(*argv, OP_SERVE) == 0) {
+         handle_serve_option(options, *(argv + 1), &checklist);
+         argv++;
+      }
+      else if (strcmp(*argv, OP_JOBS) == 0) {
+         handle_jobs_option(options, *(argv + 1));
+         argv++;
+      }
+      else if (strncmp(*argv, OP_REALTIME, strlen(OP_REALTIME)) == 0) {
+         handle_realtime_option(options, *(argv + 1));
+         argv++;
+      }
+      else if (strncmp(*argv, OP_ENGINE, strlen(OP_ENGINE)) == 0) {
+         handle_engine_option(options, *(argv + 1));
+         argv++;
+      }
+      else if (strncmp(*argv, OP_OVERLAP, strlen(OP_OVERLAP)) == 0) {
+         handle_overlap_option(options, *(argv + 1));
+         argv++;
+      }
+      else if (strncmp(*argv, OP_INTERP, strlen(OP_INTERP)) == 0) {
+         handle_interp_option(options, *(argv + 1));
+         argv++;
+      }
+      else if (strncmp(*argv, OP_PROGRESS, strlen(OP_PROGRESS)) == 0) {
+         handle_progress_option(options, *(argv + 1));
+         argv++;
+      }
+      else if (strncmp(*argv, OP_STATS, strlen(OP_STATS)) == 0)
+         handle_stats_option(options, *argv);
       else if (strncmp(*argv, OP_VB, strlen(OP_VB)) == 0)
          handle_verbose_option(options);
       else
@@ -111,6 +219,9 @@ void inspect_execution_options(
       argv++;
    }
 
+   /* --batch, --probe or --serve takes the place of both --src and --dest. */
+   if (checklist & (1 << 4 | 1 << 5 | 1 << 6))
+      checklist |= 3;
    val = checklist & 1;
    if (val == 0) {
       indicator = 1;
@@ -126,10 +237,34 @@ void inspect_execution_options(
       indicator = 1;
       fprintf(stderr, "%s and %s can't be set both.\n", OP_PITCH, OP_SPEED);
    }
-   else if (val == 0) {
+   else if (val == 0 && (checklist & (1 << 5 | 1 << 6)) == 0) {
       indicator = 1;
       fprintf(stderr, "At least %s or %s needs to be set.\n", OP_PITCH, OP_SPEED);
    }
+   if (options->realtime_block > 0 && val == 2) {
+      indicator = 1;
+      fprintf(stderr, "%s can't be set with %s.\n", OP_REALTIME, OP_SPEED);
+   }
+   if (options->engine == ENGINE_WSOLA && val == 1) {
+      indicator = 1;
+      fprintf(stderr, "%s wsola can only be set with %s.\n", OP_ENGINE, OP_SPEED);
+   }
+   if (options->overlap > 0 && options->engine != ENGINE_GRAIN) {
+      indicator = 1;
+      fprintf(stderr, "%s can only be set with %s grain.\n", OP_OVERLAP, OP_ENGINE);
+   }
+   if (options->overlap > 0 && options->realtime_block > 0) {
+      indicator = 1;
+      fprintf(stderr, "%s can't be set with %s.\n", OP_OVERLAP, OP_REALTIME);
+   }
+   if (options->interp != INTERP_NEAREST && options->engine != ENGINE_GRAIN) {
+      indicator = 1;
+      fprintf(stderr, "%s can only be set with %s grain.\n", OP_INTERP, OP_ENGINE);
+   }
+   if (options->interp != INTERP_NEAREST && options->realtime_block > 0) {
+      indicator = 1;
+      fprintf(stderr, "%s can't be set with %s.\n", OP_INTERP, OP_REALTIME);
+   }
    if (indicator == 1)
       exit(EXIT_FAILURE);
 }
@@ -145,14 +280,77 @@ static void handle_help_option(void) {
           "                   The value of 2 would yield the doubled length.\n"
           " --src* / -S*      The SRC_PATH from .env file does not affect.\n"
           "--dest* / -D*      The DEST_PATH from .env file does not affect.\n"
-          "     [--size]      Assign a specific grain size.\n"
+          "     [--size]      Assign a specific grain size, in frames or ms.\n"
+          "  [--threads]      Assign the number of threads processing grains.\n"
+          "       [--io]      Assign the way of reading and writing: stdio, mmap\n"
+          "                   or uring.\n"
+          "[--read-ahead]     Assign how many buffers are read ahead and\n"
+          "                   written behind with stdio or uring.\n"
+          "   [--direct]      Write the output past the page cache (O_DIRECT).\n"
+          "   [--window]      Assign the taper of grains: linear, hann or tukey[:ratio].\n"
+          "    [--batch]      Process every SRC DEST [FACTOR] line of the given file.\n"
+          "    [--probe]      Print the header of every following path as a JSON\n"
+          "                   line, and whether it can be processed.\n"
+          "    [--serve]      Run the jobs sent to the given Unix socket path.\n"
+          "     [--jobs]      Assign how many jobs --serve runs at a time.\n"
+          " [--realtime]      Process the given number of frames at a time with\n"
+          "                   a fixed latency of --size frames; with --pitch and\n"
+          "                   16-bit input only.\n"
+          "   [--engine]      Assign the way of processing: grain, wsola or vocoder.\n"
+          "  [--overlap]      Overlap and crossfade grains by the given percent.\n"
+          "   [--interp]      Assign how grains read between samples: nearest,\n"
+          "                   linear, cubic or sinc.\n"
+          " [--progress]      Assign how the progress is reported: bar, lines\n"
+          "                   or none, optionally to a file descriptor (:FD).\n"
+          "    [--stats]      Display where the time went, per stage, on stderr.\n"
+          "                   --stats=json prints it as one JSON object.\n"
           "  [--verbose]      Display the metadata of the input .wav file.\n"
-          "\n"
-          "<Note>\n"
-          "--src and --dest are required. Also, between --pitch and --speed,\n"
-          "only either one is required; can't be set together.\n"
+          "\n");
+   printf("<Note>\n"
+          "--src and --dest are required unless --batch, --probe or --serve is\n"
+          "set. Also, between --pitch and --speed, only either one is required;\n"
+          "can't be set together. With --batch, its value is the default FACTOR;\n"
+          "with --serve, neither is required.\n"
+          "- for --src or --dest means stdin or stdout.\n"
           "--pitch and --speed value range: 0 ~ 3 (inclusive)\n"
-          "--size value range: 2205 ~ 8820 (inclusive); default = 2205.\n"
+          "--size value range: 50 ~ 200 ms (inclusive) of the input, e.g.\n"
+          "                    2205 ~ 8820 frames at 44100 Hz; default = 50ms.\n"
+          "                    From 64 frames on with --realtime.\n"
+          "--realtime value range: 64 ~ 1024 (inclusive).\n"
+          "--probe value: the rest of the arguments, all paths; a single - reads\n"
+          "               them from stdin, one per line. The exit status tells\n"
+          "               whether every file can be processed.\n"
+          "--serve value: the socket path. Each line sent is \"job ID pitch|speed\n"
+          "               FACTOR SRC DEST [size=SIZE] [priority=N]\" or \"cancel ID\";\n"
+          "               queued, started, progress, done, failed and cancelled\n"
+          "               lines come back. Job IDs are per client: a client can\n"
+          "               only cancel its own jobs. SIGINT or SIGTERM stops\n"
+          "               the server.\n"
+          "--jobs value range: 1 ~ 64 (inclusive); default = 1. --threads is\n"
+          "                    split among the jobs.\n"
+          "--threads value range: 1 ~ 256 (inclusive); default = online CPUs.\n"
+          "--io value: stdio, mmap or uring; default = mmap (stdio if not mappable).\n"
+          "            uring is Linux io_uring, stdio where it is unavailable.\n"
+          "--read-ahead value range: 0 ~ 64 (inclusive); default = 2. 0 reads,\n"
+          "                          processes and writes in turn. With uring,\n"
+          "                          the requests in flight each way, at least 1.\n"
+          "                          Unused by mmap, --realtime and --batch.\n"
+          "--direct writes 4 MiB at a time with stdio, whatever --io is; a file\n"
+          "         system without O_DIRECT and --realtime go through the cache.\n"
+          "--window value: linear, hann or tukey[:ratio]; default = linear.\n"
+          "                The Tukey ratio range: 0 ~ 1 (inclusive); default = 0.25.\n"
+          "--overlap value: 0, 50 or 75 (%%); default = 0. Above 0, Hann-windowed\n"
+          "                 grains a hop apart are summed; --window is unused.\n"
+          "--interp value: nearest, linear, cubic or sinc; default = nearest.\n"
+          "                Only --pitch reads between samples. sinc has 16 taps\n"
+          "                and filters out what would alias above 1.\n"
+          "--progress value: bar, lines or none[:FD]; default = a bar on a terminal,\n"
+          "                  nothing otherwise. lines are \"progress CURRENT TOTAL\n"
+          "                  PERCENT\"; at most 10 reports a second either way.\n"
+          "--engine value: grain, wsola or vocoder; default = grain. wsola\n"
+          "                overlaps frames of --size frames aligned by similarity\n"
+          "                and is for --speed only. vocoder is a phase vocoder\n"
+          "                whose FFT size is the largest power of two <= --size.\n"
           "\n"
           "<.env file>\n"
           "            #      Lines starting with # are comments and ignored.\n"
@@ -207,6 +405,7 @@ static void handle_src_option(
    if (result == SUPPRESSION_OCCURRED)
       options->suppress_src_path = true;
    options->src_name = argv[1];
+   options->stream_src = strcmp(argv[1], STREAM_NAME) == 0;
    *checklist |= 1 << 0;
 }
 
@@ -225,6 +424,7 @@ static void handle_dest_option(
    if (result == SUPPRESSION_OCCURRED)
       options->suppress_dest_path = true;
    options->dest_name = argv[1];
+   options->stream_dest = strcmp(argv[1], STREAM_NAME) == 0;
    *checklist |= 1 << 1;
 }
 
@@ -263,7 +463,7 @@ static void handle_pitch_option(
    else option_name = OP_PITCH_ABBR;
 
    get_factor_value(option_name, src, options);
-   options->mode = 1;
+   options->mode = MODE_PITCH;
    *checklist |= 1 << 2;
 }
 
@@ -279,27 +479,336 @@ static void handle_speed_option(
    else option_name = OP_PITCH_ABBR;
    
    get_factor_value(option_name, src, options);
-   options->mode = 2;
+   options->mode = MODE_SPEED;
    *checklist |= 1 << 3;
 }
 
 static void handle_size_option(struct execution_options *options, char *src) {
-   char *indicator;
-
    if (src == NULL)
       raise_err("%s: Failed to get data for this option: %s.\n",
          __func__, OP_SIZE);
+   parse_grain_size(src, &options->size, &options->size_ms, OP_SIZE);
+}
+
+void parse_grain_size(
+   const char *src,
+   int *size,
+   int *size_ms,
+   const char *name
+) {
+   char *indicator;
+   long value;
+
    errno = 0;
-   options->size = (int) strtol(src, &indicator, 10);
+   value = strtol(src, &indicator, 10);
+   if (indicator == src || errno == ERANGE)
+      raise_err("%s: An invalid %s value: %s.", __func__, name, src);
+   *size = 0;
+   *size_ms = 0;
+   /*
+    * The range depends on the sample rate, so it is checked for each
+    * file; see fit_grain_size. Here only what no rate allows fails.
+    */
+   if (strcmp(indicator, SIZE_MS_SUFFIX) == 0) {
+      if (value < 1 || value > MAX_GRAIN_MS)
+         raise_err("%s: A %s value out of range: %s.", __func__, name, src);
+      *size_ms = (int) value;
+   }
+   else if (*indicator != '\0')
+      raise_err("%s: An invalid %s value: %s.", __func__, name, src);
+   else {
+      if (value < MIN_RT_GRAIN_SIZE
+          || value > (long) MAX_SAMPLE_RATE * MAX_GRAIN_MS / 1000)
+         raise_err("%s: A %s value out of range: %s.", __func__, name, src);
+      *size = (int) value;
+   }
+}
+
+static void handle_threads_option(
+   struct execution_options *options,
+   char *src
+) {
+   char *indicator;
+
+   if (src == NULL)
+      raise_err("%s: Failed to get data for this option: %s.",
+         __func__, OP_THREADS);
+   errno = 0;
+   options->threads = (int) strtol(src, &indicator, 10);
    if (indicator == src)
       raise_err("%s: An invalid %s value: %s.",
-         __func__, OP_SIZE, src);
+         __func__, OP_THREADS, src);
    if (errno == ERANGE)
       raise_err("%s: An invalid %s value: %s.",
-         __func__, OP_SIZE, src);
-   if (options->size < MIN_SIZE_VALUE || options->size > MAX_SIZE_VALUE)
+         __func__, OP_THREADS, src);
+   if (options->threads < MIN_THREADS_VALUE
+       || options->threads > MAX_THREADS_VALUE)
       raise_err("%s: A %s value out of range: %s.",
-         __func__, OP_SIZE, src);
+         __func__, OP_THREADS, src);
+}
+
+static void handle_engine_option(
+   struct execution_options *options,
+   char *src
+) {
+   if (src == NULL)
+      raise_err("%s: Failed to get data for this option: %s.",
+         __func__, OP_ENGINE);
+   if (strcmp(src, "grain") == 0)
+      options->engine = ENGINE_GRAIN;
+   else if (strcmp(src, "wsola") == 0)
+      options->engine = ENGINE_WSOLA;
+   else if (strcmp(src, "vocoder") == 0)
+      options->engine = ENGINE_VOCODER;
+   else
+      raise_err("%s: An invalid %s value: %s.",
+         __func__, OP_ENGINE, src);
+}
+
+static void handle_overlap_option(
+   struct execution_options *options,
+   char *src
+) {
+   if (src == NULL)
+      raise_err("%s: Failed to get data for this option: %s.",
+         __func__, OP_OVERLAP);
+   if (strcmp(src, "0") == 0)
+      options->overlap = 0;
+   else if (strcmp(src, "50") == 0)
+      options->overlap = 50;
+   else if (strcmp(src, "75") == 0)
+      options->overlap = 75;
+   else
+      raise_err("%s: An invalid %s value: %s.",
+         __func__, OP_OVERLAP, src);
+}
+
+static void handle_interp_option(
+   struct execution_options *options,
+   char *src
+) {
+   if (src == NULL)
+      raise_err("%s: Failed to get data for this option: %s.",
+         __func__, OP_INTERP);
+   if (strcmp(src, "nearest") == 0)
+      options->interp = INTERP_NEAREST;
+   else if (strcmp(src, "linear") == 0)
+      options->interp = INTERP_LINEAR;
+   else if (strcmp(src, "cubic") == 0)
+      options->interp = INTERP_CUBIC;
+   else if (strcmp(src, "sinc") == 0)
+      options->interp = INTERP_SINC;
+   else
+      raise_err("%s: An invalid %s value: %s.",
+         __func__, OP_INTERP, src);
+}
+
+static void handle_stats_option(
+   struct execution_options *options,
+   char *arg
+) {
+   if (strcmp(arg, OP_STATS) == 0)
+      options->stats = STATS_TEXT;
+   else if (strcmp(arg, OP_STATS_JSON) == 0)
+      options->stats = STATS_JSON;
+   else
+      handle_unknown_argument(arg);
+}
+
+static void handle_progress_option(
+   struct execution_options *options,
+   char *src
+) {
+   size_t len;
+   char *indicator;
+   long fd;
+
+   if (src == NULL)
+      raise_err("%s: Failed to get data for this option: %s.",
+         __func__, OP_PROGRESS);
+   len = strcspn(src, ":");
+   if (strncmp(src, "bar", len) == 0 && len == 3)
+      options->progress_style = PROGRESS_BAR;
+   else if (strncmp(src, "lines", len) == 0 && len == 5)
+      options->progress_style = PROGRESS_LINES;
+   else if (strncmp(src, "none", len) == 0 && len == 4)
+      options->progress_style = PROGRESS_NONE;
+   else
+      raise_err("%s: An invalid %s value: %s.",
+         __func__, OP_PROGRESS, src);
+   if (src[len] == '\0')
+      return;
+
+   errno = 0;
+   fd = strtol(src + len + 1, &indicator, 10);
+   if (indicator == src + len + 1 || *indicator != '\0'
+       || errno == ERANGE || fd < 0 || fd > INT_MAX)
+      raise_err("%s: An invalid file descriptor: %s.", __func__, src);
+   options->progress_fd = fd;
+}
+
+static void handle_read_ahead_option(
+   struct execution_options *options,
+   char *src
+) {
+   char *indicator;
+   long value;
+
+   if (src == NULL)
+      raise_err("%s: Failed to get data for this option: %s.",
+         __func__, OP_READ_AHEAD);
+   errno = 0;
+   value = strtol(src, &indicator, 10);
+   if (indicator == src || *indicator != '\0' || errno == ERANGE)
+      raise_err("%s: An invalid %s value: %s.",
+         __func__, OP_READ_AHEAD, src);
+   if (value < 0 || value > MAX_READ_AHEAD_VALUE)
+      raise_err("%s: A %s value out of range: %s.",
+         __func__, OP_READ_AHEAD, src);
+   options->read_ahead = value;
+}
+
+static void handle_io_option(struct execution_options *options, char *src) {
+   if (src == NULL)
+      raise_err("%s: Failed to get data for this option: %s.",
+         __func__, OP_IO);
+   if (strcmp(src, "stdio") == 0)
+      options->io_backend = IO_STDIO;
+   else if (strcmp(src, "mmap") == 0)
+      options->io_backend = IO_MMAP;
+   else if (strcmp(src, "uring") == 0)
+      options->io_backend = IO_URING;
+   else
+      raise_err("%s: An invalid %s value: %s.",
+         __func__, OP_IO, src);
+}
+
+static void handle_window_option(
+   struct execution_options *options,
+   char *src
+) {
+   char *indicator;
+   size_t len;
+
+   if (src == NULL)
+      raise_err("%s: Failed to get data for this option: %s.",
+         __func__, OP_WINDOW);
+   len = strcspn(src, ":");
+   if (strncmp(src, "linear", len) == 0 && len == strlen("linear"))
+      options->window_shape = WINDOW_LINEAR;
+   else if (strncmp(src, "hann", len) == 0 && len == strlen("hann"))
+      options->window_shape = WINDOW_HANN;
+   else if (strncmp(src, "tukey", len) == 0 && len == strlen("tukey"))
+      options->window_shape = WINDOW_TUKEY;
+   else
+      raise_err("%s: An invalid %s value: %s.",
+         __func__, OP_WINDOW, src);
+   if (src[len] == '\0')
+      return;
+   if (options->window_shape != WINDOW_TUKEY)
+      raise_err("%s: Only tukey takes a ratio: %s.",
+         __func__, src);
+
+   errno = 0;
+   options->window_ratio = strtod(src + len + 1, &indicator);
+   if (indicator == src + len + 1 || *indicator != '\0')
+      raise_err("%s: An invalid %s value: %s.",
+         __func__, OP_WINDOW, src);
+   if (errno == ERANGE)
+      raise_err("%s: An invalid %s value: %s.",
+         __func__, OP_WINDOW, src);
+   if (options->window_ratio < 0 || options->window_ratio > 1)
+      raise_err("%s: A %s value out of range: %s.",
+         __func__, OP_WINDOW, src);
+}
+
+static void handle_batch_option(
+   struct execution_options *options,
+   char *src,
+   unsigned int *checklist
+) {
+   if (src == NULL)
+      raise_err("%s: Failed to get data for this option: %s.",
+         __func__, OP_BATCH);
+   options->batch_name = src;
+   *checklist |= 1 << 4;
+}
+
+static void handle_probe_option(
+   struct execution_options *options,
+   char **paths,
+   unsigned int *checklist
+) {
+   if (*paths == NULL)
+      raise_err("%s: Failed to get data for this option: %s.",
+         __func__, OP_PROBE);
+   options->probe_names = paths;
+   while (*paths != NULL)
+      paths++;
+   options->probe_count = paths - options->probe_names;
+   *checklist |= 1 << 5;
+}
+
+static void handle_serve_option(
+   struct execution_options *options,
+   char *src,
+   unsigned int *checklist
+) {
+   if (src == NULL)
+      raise_err("%s: Failed to get data for this option: %s.",
+         __func__, OP_SERVE);
+   options->serve_name = src;
+   *checklist |= 1 << 6;
+}
+
+static void handle_jobs_option(
+   struct execution_options *options,
+   char *src
+) {
+   char *indicator;
+
+   if (src == NULL)
+      raise_err("%s: Failed to get data for this option: %s.",
+         __func__, OP_JOBS);
+   errno = 0;
+   options->jobs = (int) strtol(src, &indicator, 10);
+   if (indicator == src)
+      raise_err("%s: An invalid %s value: %s.",
+         __func__, OP_JOBS, src);
+   if (errno == ERANGE)
+      raise_err("%s: An invalid %s value: %s.",
+         __func__, OP_JOBS, src);
+   if (options->jobs < MIN_JOBS_VALUE
+       || options->jobs > MAX_JOBS_VALUE)
+      raise_err("%s: A %s value out of range: %s.",
+         __func__, OP_JOBS, src);
+}
+
+static void handle_realtime_option(
+   struct execution_options *options,
+   char *src
+) {
+   char *indicator;
+
+   if (src == NULL)
+      raise_err("%s: Failed to get data for this option: %s.",
+         __func__, OP_REALTIME);
+   errno = 0;
+   options->realtime_block = (int) strtol(src, &indicator, 10);
+   if (indicator == src)
+      raise_err("%s: An invalid %s value: %s.",
+         __func__, OP_REALTIME, src);
+   if (errno == ERANGE)
+      raise_err("%s: An invalid %s value: %s.",
+         __func__, OP_REALTIME, src);
+   if (options->realtime_block < MIN_BLOCK_VALUE
+       || options->realtime_block > MAX_BLOCK_VALUE)
+      raise_err("%s: A %s value out of range: %s.",
+         __func__, OP_REALTIME, src);
+}
+
+static void handle_direct_option(struct execution_options *options) {
+   options->direct_io = true;
 }
 
 static void handle_verbose_option(struct execution_options *options) {
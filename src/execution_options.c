@@ -2,9 +2,16 @@
 #include <stdlib.h>
 #include "execution_options.h"
 #include "miscellaneous.h"
+#include "audio_io.h"
+#include "window_table.h"
+#include "grain_plan.h"
+#include "processing.h"
+#include "stats.h"
 
 #define LEN_EXECUTION_OPTIONS 0  /* except self */
-#define DEFAULT_SIZE 2205
+#define DEFAULT_SIZE_MS 50
+#define DEFAULT_TUKEY_RATIO 0.25
+#define DEFAULT_READ_AHEAD 2
 
 static void unrealize(struct execution_options *);
 
@@ -16,10 +23,32 @@ struct execution_options *realize_execution_options(void) {
       raise_err("%s: Failed to create a new struct execution_options.", __func__);
    objptr->self = objptr;
    objptr->unrealize = unrealize;
-   objptr->size = DEFAULT_SIZE;
+   objptr->size = 0;
+   objptr->size_ms = DEFAULT_SIZE_MS;
+   objptr->threads = count_online_cpus();
+   objptr->realtime_block = 0;
+   objptr->io_backend = IO_MMAP;
+   objptr->read_ahead = DEFAULT_READ_AHEAD;
+   objptr->direct_io = false;
+   objptr->engine = ENGINE_GRAIN;
+   objptr->overlap = 0;
+   objptr->interp = INTERP_NEAREST;
+   objptr->stats = STATS_OFF;
+   objptr->window_shape = WINDOW_LINEAR;
+   objptr->window_ratio = DEFAULT_TUKEY_RATIO;
    objptr->verbose = false;
+   objptr->show_progress = true;
+   objptr->progress_style = PROGRESS_AUTO;
+   objptr->progress_fd = -1;
+   objptr->batch_name = NULL;
+   objptr->probe_names = NULL;
+   objptr->probe_count = 0;
+   objptr->serve_name = NULL;
+   objptr->jobs = 1;
    objptr->suppress_src_path = false;
    objptr->suppress_dest_path = false;
+   objptr->stream_src = false;
+   objptr->stream_dest = false;
 
    return objptr;
 };
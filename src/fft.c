@@ -0,0 +1,219 @@
+#include <math.h>
+#include <stdlib.h>
+#include "fft.h"
+#include "miscellaneous.h"
+#include "stats.h"
+
+static void unrealize(struct fft_cache *);
+static struct fft_plan *build_plan(int);
+static void transform(const struct fft_plan *, float *, float *, int);
+
+struct fft_cache *realize_fft_cache(void) {
+   struct fft_cache *objptr;
+
+   objptr = malloc(sizeof(struct fft_cache));
+   if (objptr == NULL)
+      raise_err("%s: Failed to create a new struct fft_cache.", __func__);
+   if (pthread_mutex_init(&objptr->lock, NULL) != 0)
+      raise_err("%s: Failed to initialize the mutex.", __func__);
+   objptr->self = objptr;
+   objptr->unrealize = unrealize;
+   objptr->head = NULL;
+
+   return objptr;
+}
+
+const struct fft_plan *lookup_fft_plan(struct fft_cache *cache, int size) {
+   struct fft_plan *plan;
+
+   pthread_mutex_lock(&cache->lock);
+   for (plan = cache->head; plan != NULL; plan = plan->next)
+      if (plan->size == size)
+         break;
+   if (plan == NULL) {
+      plan = build_plan(size);
+      if (plan != NULL) {
+         stats_alloc(sizeof(struct fft_plan)
+            + (sizeof(int) + 2 * sizeof(float)) * (size / 2));
+         plan->next = cache->head;
+         cache->head = plan;
+      }
+   }
+   pthread_mutex_unlock(&cache->lock);
+
+   return plan;
+}
+
+/*
+ * Note: The real FFT packs the even values into the real parts and
+ * the odd values into the imaginary parts of size / 2 complex
+ * points, transforms those, and then separates the two spectra:
+ * X[k] = E[k] + W^k O[k], with E and O taken from the pair Z[k],
+ * Z[size / 2 - k] and W = exp(-2 pi i / size).
+ */
+void fft_forward(
+   const struct fft_plan *plan,
+   const float *in,
+   float *re,
+   float *im
+) {
+   int half = plan->size / 2;
+   int k, j;
+   float er, ei, or, oi, c, s, tr, ti;
+
+   for (k = 0; k < half; k++) {
+      re[plan->bitrev[k]] = in[2 * k];
+      im[plan->bitrev[k]] = in[2 * k + 1];
+   }
+   transform(plan, re, im, 1);
+
+   er = re[0];
+   ei = im[0];
+   re[0] = er + ei;
+   im[0] = 0;
+   re[half] = er - ei;
+   im[half] = 0;
+   for (k = 1; k <= half / 2; k++) {
+      j = half - k;
+      er = (re[k] + re[j]) / 2;
+      ei = (im[k] - im[j]) / 2;
+      or = (im[k] + im[j]) / 2;
+      oi = -(re[k] - re[j]) / 2;
+      c = plan->cos_table[k];
+      s = plan->sin_table[k];
+      tr = c * or + s * oi;
+      ti = c * oi - s * or;
+      re[k] = er + tr;
+      im[k] = ei + ti;
+      re[j] = er - tr;
+      im[j] = -ei + ti;
+   }
+}
+
+void fft_inverse(
+   const struct fft_plan *plan,
+   float *re,
+   float *im,
+   float *out
+) {
+   int half = plan->size / 2;
+   int k, j;
+   float er, ei, dr, di, or, oi, c, s, t;
+
+   er = (re[0] + re[half]) / 2;
+   or = (re[0] - re[half]) / 2;
+   re[0] = er;
+   im[0] = or;
+   for (k = 1; k <= half / 2; k++) {
+      j = half - k;
+      er = (re[k] + re[j]) / 2;
+      ei = (im[k] - im[j]) / 2;
+      dr = (re[k] - re[j]) / 2;
+      di = (im[k] + im[j]) / 2;
+      c = plan->cos_table[k];
+      s = plan->sin_table[k];
+      or = dr * c - di * s;
+      oi = dr * s + di * c;
+      re[k] = er - oi;
+      im[k] = ei + or;
+      re[j] = er + oi;
+      im[j] = -ei + or;
+   }
+
+   for (k = 0; k < half; k++) {
+      j = plan->bitrev[k];
+      if (k < j) {
+         t = re[k]; re[k] = re[j]; re[j] = t;
+         t = im[k]; im[k] = im[j]; im[j] = t;
+      }
+   }
+   transform(plan, re, im, -1);
+   for (k = 0; k < half; k++) {
+      out[2 * k] = re[k] / half;
+      out[2 * k + 1] = im[k] / half;
+   }
+}
+
+/*
+ * Note: transform() is an iterative radix-2 FFT of size / 2 complex
+ * points already in bit-reversed order. sign = -1 computes the
+ * inverse transform, without the scaling.
+ */
+static void transform(
+   const struct fft_plan *plan,
+   float *re,
+   float *im,
+   int sign
+) {
+   int half = plan->size / 2;
+   int len, step, i, j, a, b;
+   float wr, wi, tr, ti;
+
+   for (len = 2; len <= half; len <<= 1) {
+      step = plan->size / len;
+      for (i = 0; i < half; i += len)
+         for (j = 0; j < len / 2; j++) {
+            wr = plan->cos_table[j * step];
+            wi = -sign * plan->sin_table[j * step];
+            a = i + j;
+            b = a + len / 2;
+            tr = wr * re[b] - wi * im[b];
+            ti = wr * im[b] + wi * re[b];
+            re[b] = re[a] - tr;
+            im[b] = im[a] - ti;
+            re[a] += tr;
+            im[a] += ti;
+         }
+   }
+}
+
+static struct fft_plan *build_plan(int size) {
+   struct fft_plan *plan;
+   int half = size / 2;
+   int bits = 0, k, b, r;
+
+   plan = malloc(sizeof(struct fft_plan));
+   if (plan == NULL)
+      return NULL;
+   plan->size = size;
+   plan->bitrev = malloc(sizeof(int) * half);
+   plan->cos_table = malloc(sizeof(float) * half);
+   plan->sin_table = malloc(sizeof(float) * half);
+   if (plan->bitrev == NULL
+       || plan->cos_table == NULL
+       || plan->sin_table == NULL) {
+      free(plan->bitrev);
+      free(plan->cos_table);
+      free(plan->sin_table);
+      free(plan);
+      return NULL;
+   }
+
+   while (1 << bits < half)
+      bits++;
+   for (k = 0; k < half; k++) {
+      r = 0;
+      for (b = 0; b < bits; b++)
+         if (k & 1 << b)
+            r |= 1 << (bits - 1 - b);
+      plan->bitrev[k] = r;
+      plan->cos_table[k] = cos(2 * M_PI * k / size);
+      plan->sin_table[k] = sin(2 * M_PI * k / size);
+   }
+
+   return plan;
+}
+
+static void unrealize(struct fft_cache *objptr) {
+   struct fft_plan *plan, *next;
+
+   for (plan = objptr->head; plan != NULL; plan = next) {
+      next = plan->next;
+      free(plan->bitrev);
+      free(plan->cos_table);
+      free(plan->sin_table);
+      free(plan);
+   }
+   pthread_mutex_destroy(&objptr->lock);
+   free(objptr->self);
+}
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include <math.h>
+#include "grain_plan.h"
+#include "window_table.h"
+
+#define RAMP_LEN 10
+#define SINC_TAPS 16
+
+static void shift_pitch(int *, int, double);
+static void stretch_time(int *, int, int);
+
+int grain_part(int mode, int grain_size, double factor) {
+   if (mode == GRAIN_SPEED)
+      return grain_size / factor;
+
+   return grain_size;
+}
+
+void plan_read_index(
+   int *read_index,
+   int mode,
+   int grain_size,
+   int part,
+   double factor
+) {
+   if (mode == GRAIN_SPEED)
+      stretch_time(read_index, grain_size, part);
+   else
+      shift_pitch(read_index, grain_size, factor);
+}
+
+/*
+ * Note: shift_pitch and stretch_time only decide which source
+ * sample each output sample is taken from. The table is the same
+ * for every grain and channel, so it is built once and the
+ * resample kernel does the rest.
+ */
+static void shift_pitch(int *read_index, int grain_size, double pitch_factor) {
+   int i;
+   double j;
+
+   for (i = 0, j = 0; i < grain_size; i++, j += pitch_factor) {
+      if (j >= grain_size)
+         j = 0;
+      read_index[i] = (int) j;
+   }
+}
+
+static void stretch_time(int *read_index, int grain_size, int part) {
+   int i, j;
+
+   for (i = 0, j = 0; i < part; i++, j++) {
+      if (j == grain_size)
+         j = 0;
+      read_index[i] = j;
+   }
+}
+
+int interp_taps(int interp) {
+   switch (interp) {
+      case INTERP_LINEAR:
+         return 2;
+      case INTERP_CUBIC:
+         return 4;
+      case INTERP_SINC:
+         return SINC_TAPS;
+      default:
+         return 1;
+   }
+}
+
+void plan_read_phase(
+   int *read_index,
+   unsigned char *phase,
+   int mode,
+   int grain_size,
+   int part,
+   double factor
+) {
+   int i, k;
+   double j;
+
+   if (mode == GRAIN_SPEED) {
+      stretch_time(read_index, grain_size, part);
+      for (i = 0; i < part; i++)
+         phase[i] = 0;
+      return;
+   }
+   for (i = 0, j = 0; i < grain_size; i++, j += factor) {
+      if (j >= grain_size)
+         j = 0;
+      read_index[i] = (int) j;
+      k = (int) lround((j - read_index[i]) * INTERP_PHASES);
+      if (k == INTERP_PHASES) {
+         k = 0;
+         if (++read_index[i] == grain_size)
+            read_index[i] = 0;
+      }
+      phase[i] = k;
+   }
+}
+
+/*
+ * Note: Row p of a table weighs the taps for the position p /
+ * INTERP_PHASES past the sample after the first interp_taps / 2 - 1
+ * taps. The sinc is stretched to the cutoff, so that reading faster
+ * than the source filters out what would alias, and each row is
+ * scaled to sum to one, so that a constant comes out unchanged.
+ */
+void fill_interp_table(float *coef, int interp, double cutoff) {
+   int taps = interp_taps(interp);
+   int p, t;
+   double f, d, x, sum;
+   double row[SINC_TAPS];
+
+   for (p = 0; p < INTERP_PHASES; p++) {
+      f = (double) p / INTERP_PHASES;
+      switch (interp) {
+         case INTERP_LINEAR:
+            row[0] = 1 - f;
+            row[1] = f;
+            break;
+         case INTERP_CUBIC:
+            row[0] = (-f * f * f + 2 * f * f - f) / 2;
+            row[1] = (3 * f * f * f - 5 * f * f + 2) / 2;
+            row[2] = (-3 * f * f * f + 4 * f * f + f) / 2;
+            row[3] = (f * f * f - f * f) / 2;
+            break;
+         case INTERP_SINC:
+            for (t = 0; t < taps; t++) {
+               d = t - (taps / 2 - 1) - f;
+               x = M_PI * cutoff * d;
+               row[t] = (x == 0 ? 1 : sin(x) / x)
+                        * (0.42 + 0.5 * cos(M_PI * d / (taps / 2))
+                           + 0.08 * cos(2 * M_PI * d / (taps / 2)));
+            }
+            break;
+         default:
+            row[0] = 1;
+      }
+      sum = 0;
+      for (t = 0; t < taps; t++)
+         sum += row[t];
+      for (t = 0; t < taps; t++)
+         coef[p * taps + t] = row[t] / sum;
+   }
+}
+
+/*
+ * Note: WINDOW_LINEAR is what the program has always used for
+ * removing 'click' sounds; its values are computed exactly as
+ * before, so the output does not change. The cosine tapers are
+ * smoother and, being tables as well, cost nothing extra per sample.
+ */
+void fill_window(double *values, int shape, int len, double ratio) {
+   int pos;
+   double x;
+
+   if (shape == WINDOW_HANN) {
+      shape = WINDOW_TUKEY;
+      ratio = 1;
+   }
+   for (pos = 0; pos < len; pos++) {
+      if (shape == WINDOW_LINEAR) {
+         if (pos < RAMP_LEN)
+            values[pos] = 0.1 * pos;
+         else if (len - RAMP_LEN <= pos)
+            values[pos] = 0.9 - 0.1 * (pos - (len - RAMP_LEN));
+         else
+            values[pos] = 1;
+         continue;
+      }
+      /* Tukey: cosine ramps over ratio / 2 of the length at each end. */
+      x = len > 1 ? (double) pos / (len - 1) : 0.5;
+      if (x > 0.5)
+         x = 1 - x;
+      if (ratio > 0 && x < ratio / 2)
+         values[pos] = 0.5 * (1 - cos(2 * M_PI * x / ratio));
+      else
+         values[pos] = 1;
+   }
+}
\ No newline at end of file
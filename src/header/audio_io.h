@@ -0,0 +1,161 @@
+#ifndef AUDIO_IO_H
+#define AUDIO_IO_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "wave_file.h"
+#include "spsc_ring.h"
+#include "uring_io.h"
+
+#define IO_STDIO 1
+#define IO_MMAP  2
+#define IO_URING 3   /* Linux io_uring; stdio where it is missing */
+
+#define DIRECT_ALIGN  4096
+#define DIRECT_BATCH  (4 << 20)   /* bytes written at a time with O_DIRECT */
+
+/*
+ * Note: struct io_buffers holds the grain buffers of the IO_STDIO
+ * backend. It outlives struct audio_io, so that the buffers can be
+ * reused from one file to the next; they only ever grow.
+ */
+struct io_buffers {
+   void (*unrealize)(struct io_buffers *);
+   size_t src_buf_len;    /* capacity in bytes */
+   size_t dest_buf_len;
+
+   /* fields to be freed */
+   unsigned char *src_buf;
+   unsigned char *dest_buf;
+   struct io_buffers *self;
+};
+
+struct audio_io {
+   void (*unrealize)(struct audio_io *);
+
+   /*
+    * read: It hands over at most count samples of the source
+    * and stores the number actually handed over to count.
+    * The samples are as in the file, sample_size bytes each.
+    * The returned memory stays valid until the next read.
+    */
+   const void *(*read)(struct audio_io *, size_t *count);
+
+   /*
+    * reserve: It returns the memory where count samples of the
+    * destination are to be written; commit then stores them.
+    */
+   void *(*reserve)(struct audio_io *, size_t count);
+   void (*commit)(struct audio_io *, size_t count);
+
+   int backend;
+   FILE *src;
+   FILE *dest;
+   int sample_size;       /* bytes per sample */
+   size_t header_size;    /* where the output audio data start */
+   size_t src_buf_len;    /* the maximum count for read */
+   size_t dest_buf_len;   /* the maximum count for reserve */
+   const bool *cancel;    /* accessed atomically; NULL if never */
+   bool is_cut_short;     /* is_io_cancelled has returned true */
+
+   /* IO_MMAP: the whole files are mapped; positions are in bytes. */
+   unsigned char *src_map;
+   size_t src_map_len;
+   size_t src_pos;
+   size_t src_end;
+   unsigned char *dest_map;
+   size_t dest_map_len;
+   size_t dest_pos;
+
+   /* IO_STDIO: borrowed from struct io_buffers */
+   unsigned char *src_buf;
+   unsigned char *dest_buf;
+
+   /*
+    * IO_STDIO with read-ahead: a reader thread fills src_ring with
+    * up to src_buf_len samples a slot, and a writer thread drains
+    * dest_ring, while the engine works in between. The failures of
+    * the two threads are only raised on the engine's side.
+    */
+   int read_ahead;         /* slots per ring; 0 for none */
+   pthread_t reader;
+   pthread_t writer;
+   uint64_t src_left;      /* bytes the reader may still read */
+   const unsigned char *src_slot;   /* the slot being handed out */
+   size_t src_slot_pos;
+   size_t src_slot_len;
+   bool src_failed;        /* accessed atomically */
+   bool dest_failed;       /* accessed atomically */
+
+   /* IO_URING: src_slot and the like are used as with read-ahead. */
+
+   /*
+    * The output file is allocated up front and cut back to what has
+    * been written in the end. With is_direct, IO_STDIO writes it
+    * past the page cache, through direct_buf, DIRECT_BATCH bytes at
+    * a time at offsets aligned to DIRECT_ALIGN.
+    */
+   bool is_allocated;
+   int direct_fd;          /* -1 unless O_DIRECT is in effect */
+   uint64_t direct_pos;    /* the file offset of direct_buf */
+   size_t direct_len;      /* bytes in direct_buf */
+
+   /* fields to be freed */
+   unsigned char *direct_buf;
+   struct uring_io *uring;
+   struct spsc_ring *src_ring;
+   struct spsc_ring *dest_ring;
+   struct audio_io *self;
+};
+
+/*
+ * realize_io_buffers: This function creates a new, empty
+ * struct io_buffers.
+ */
+struct io_buffers *realize_io_buffers(void);
+
+/*
+ * realize_audio_io: This function creates a new struct audio_io
+ * over the two streams opened by open_wav. src must be positioned
+ * at the beginning of the audio data described by info, which has
+ * passed assess_wav_info; the output takes the same format, and its
+ * header of wav_header_size(info) bytes has been written ahead by
+ * write_wav_header_ahead. dest_size_hint is the expected size of
+ * the output audio data in bytes, for which the file is allocated.
+ * If IO_MMAP is requested but the files can't be mapped, IO_STDIO
+ * is used instead, whose buffers are taken from buffers, and so it
+ * is if IO_URING is requested but unavailable. With IO_STDIO,
+ * read_ahead > 0 reads and writes on two threads of their own, up
+ * to read_ahead buffers ahead of and behind the caller; with
+ * IO_URING, read_ahead requests, at least one, of each are in
+ * flight. is_direct writes with O_DIRECT where it is supported,
+ * always by IO_STDIO. cancel may be NULL; see is_io_cancelled.
+ * is_stream means that dest is a stream.
+ */
+struct audio_io *realize_audio_io(
+   FILE *src,
+   FILE *dest,
+   int backend,
+   const struct wav_info *info,
+   uint64_t dest_size_hint,
+   size_t src_buf_len,
+   size_t dest_buf_len,
+   struct io_buffers *buffers,
+   int read_ahead,
+   bool is_direct,
+   const bool *cancel,
+   bool is_stream
+);
+
+/*
+ * is_io_cancelled: This function tells whether the cancel flag given
+ * to realize_audio_io has turned true. The engines check it once a
+ * batch or frame while output remains, and then stop as if the
+ * output were complete; io->is_cut_short tells them apart.
+ */
+bool is_io_cancelled(struct audio_io *io);
+
+#endif
\ No newline at end of file
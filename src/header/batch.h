@@ -0,0 +1,25 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include "execution_options.h"
+#include "env_data.h"
+
+/*
+ * run_batch: This function processes every job listed in the
+ * manifest file given by --batch, spreading the files across
+ * the threads. A line of the manifest reads
+ *
+ *    SRC DEST [FACTOR]
+ *
+ * where FACTOR defaults to the value of --pitch or --speed. Each
+ * file gets a status line, and a bad file does not stop the rest.
+ * It returns the number of the failed jobs.
+ */
+int run_batch(
+   struct execution_options *options,
+   struct env_data *env,
+   bool is_le
+);
+
+#endif
\ No newline at end of file
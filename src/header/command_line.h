@@ -3,6 +3,11 @@
 
 #include "execution_options.h"
 
+#define MAX_FACTOR_VALUE 3
+#define MODE_PITCH       1   /* options->mode as set by --pitch */
+#define MODE_SPEED       2   /* and by --speed */
+#define SIZE_MS_SUFFIX   "ms"
+
 /*
  * inspect_execution_options: This function checks the command line
  * arguments.
@@ -13,4 +18,18 @@ void inspect_execution_options(
    struct execution_options *options
 );
 
+/*
+ * parse_grain_size: This function reads a grain size as --size takes
+ * it, in frames or, followed by SIZE_MS_SUFFIX, in milliseconds, and
+ * sets one of *size and *size_ms to it and the other to 0. Only what
+ * no sample rate allows is out of range here; see fit_grain_size.
+ * name is the option or field, for the error message.
+ */
+void parse_grain_size(
+   const char *src,
+   int *size,
+   int *size_ms,
+   const char *name
+);
+
 #endif
\ No newline at end of file
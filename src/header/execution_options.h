@@ -6,12 +6,34 @@
 struct execution_options {
    char *src_name;
    char *dest_name;
+   char *batch_name;
+   char **probe_names;   /* the rest of argv after --probe; NULL if none */
+   int probe_count;
+   char *serve_name;   /* the socket path of --serve; NULL if none */
+   int jobs;           /* jobs --serve runs at a time */
    int mode;
    double factor;
-   int size;
+   int size;       /* frames per grain; see fit_grain_size */
+   int size_ms;    /* --size in ms; 0 unless given so */
+   int threads;
+   int realtime_block;   /* frames per block; 0 unless --realtime */
+   int io_backend;
+   int read_ahead;   /* buffers read ahead with IO_STDIO; 0 for none */
+   bool direct_io;   /* --direct */
+   int engine;
+   int overlap;    /* percent of a grain; 0, 50 or 75 */
+   int interp;     /* INTERP_*; see grain_plan.h */
+   int stats;   /* STATS_OFF, STATS_TEXT or STATS_JSON */
+   int window_shape;
+   double window_ratio;
    bool verbose;
+   bool show_progress;
+   int progress_style;
+   int progress_fd;    /* -1 for stdout */
    bool suppress_src_path;
    bool suppress_dest_path;
+   bool stream_src;    /* --src - */
+   bool stream_dest;   /* --dest - */
    
    void (*unrealize)(struct execution_options *);
    
@@ -0,0 +1,72 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <pthread.h>
+
+/*
+ * Note: struct fft_plan holds what a real FFT of size points needs
+ * besides the data: the bit-reversed order of the size / 2 complex
+ * points it is computed on and the twiddle factors
+ * exp(-2 pi i j / size), j < size / 2.
+ */
+struct fft_plan {
+   int size;   /* a power of two, at least 4 */
+   int *bitrev;
+   float *cos_table;
+   float *sin_table;
+   struct fft_plan *next;
+};
+
+/*
+ * Note: struct fft_cache keeps every plan built so far, so that
+ * the tables are computed once per size no matter how many frames
+ * and files use them. It can be shared by threads.
+ */
+struct fft_cache {
+   void (*unrealize)(struct fft_cache *);
+   pthread_mutex_t lock;
+
+   /* fields to be freed */
+   struct fft_plan *head;
+   struct fft_cache *self;
+};
+
+/*
+ * realize_fft_cache: This function creates a new, empty
+ * struct fft_cache.
+ */
+struct fft_cache *realize_fft_cache(void);
+
+/*
+ * lookup_fft_plan: This function returns the plan for a real FFT
+ * of size points, building it on the first request. size must be
+ * a power of two, at least 4. The plan belongs to the cache; NULL
+ * means a failed allocation.
+ */
+const struct fft_plan *lookup_fft_plan(struct fft_cache *cache, int size);
+
+/*
+ * fft_forward: This function computes the spectrum of the plan's
+ * size real values of in: size / 2 + 1 bins, whose real and
+ * imaginary parts are stored in re and im.
+ */
+void fft_forward(
+   const struct fft_plan *plan,
+   const float *in,
+   float *re,
+   float *im
+);
+
+/*
+ * fft_inverse: This function turns the size / 2 + 1 bins of re and
+ * im back into size real values in out, scaled so that it undoes
+ * fft_forward(). re and im are overwritten.
+ */
+void fft_inverse(
+   const struct fft_plan *plan,
+   float *re,
+   float *im,
+   float *out
+);
+
+#endif
\ No newline at end of file
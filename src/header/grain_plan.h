@@ -0,0 +1,77 @@
+#ifndef GRAIN_PLAN_H
+#define GRAIN_PLAN_H
+
+#define GRAIN_PITCH 1   /* the same numbers as execution_options.mode */
+#define GRAIN_SPEED 2
+
+#define INTERP_NEAREST 1   /* the source sample at or before the position */
+#define INTERP_LINEAR  2
+#define INTERP_CUBIC   3   /* Catmull-Rom */
+#define INTERP_SINC    4   /* Blackman-windowed sinc */
+#define INTERP_PHASES  256 /* fractional positions of an interp table */
+
+/*
+ * Everything here is computed once per run and is the same for
+ * every grain: how long an output grain is, which source sample
+ * each output sample is taken from, and the window. Nothing here
+ * allocates memory or reports errors, so it serves the program
+ * and libpitsh alike.
+ */
+
+/*
+ * grain_part: This function returns the number of frames of an
+ * output grain for the given mode.
+ */
+int grain_part(int mode, int grain_size, double factor);
+
+/*
+ * plan_read_index: This function fills read_index, part elements,
+ * with the source frame of each output frame.
+ */
+void plan_read_index(
+   int *read_index,
+   int mode,
+   int grain_size,
+   int part,
+   double factor
+);
+
+/*
+ * interp_taps: This function returns the number of source samples
+ * an output sample is interpolated from: 1, 2, 4 or 16. The taps
+ * of a sample at position read_index + phase / INTERP_PHASES start
+ * interp_taps / 2 - 1 samples before read_index.
+ */
+int interp_taps(int interp);
+
+/*
+ * plan_read_phase: This function fills read_index and phase, part
+ * elements each, with the source frame of each output frame and
+ * the fraction past it, rounded to 1 / INTERP_PHASES. The positions
+ * are those of plan_read_index() before the truncation; a fraction
+ * rounded up to the next frame wraps within the grain as they do.
+ */
+void plan_read_phase(
+   int *read_index,
+   unsigned char *phase,
+   int mode,
+   int grain_size,
+   int part,
+   double factor
+);
+
+/*
+ * fill_interp_table: This function fills coef, INTERP_PHASES rows
+ * of interp_taps(interp) elements, with the weights of the taps for
+ * each phase; the weights of a row sum to one. cutoff, 0 ~ 1 of the
+ * Nyquist frequency, only matters for INTERP_SINC.
+ */
+void fill_interp_table(float *coef, int interp, double cutoff);
+
+/*
+ * fill_window: This function fills values, len elements, with the
+ * window of the given shape (see window_table.h).
+ */
+void fill_window(double *values, int shape, int len, double ratio);
+
+#endif
\ No newline at end of file
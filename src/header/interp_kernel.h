@@ -0,0 +1,25 @@
+#ifndef INTERP_KERNEL_H
+#define INTERP_KERNEL_H
+
+/*
+ * Every interpolation kernel computes, for 0 <= i < len,
+ *
+ *    out[i] = sum of coef[taps * phase[i] + t]
+ *                    * plane[read_index[i] + t - (taps / 2 - 1)]
+ *
+ * over 0 <= t < taps, coef being a table of fill_interp_table()
+ * (see grain_plan.h). plane has to be readable that far before and
+ * after the samples indexed. The vectorized kernel may sum the taps
+ * in another order than the scalar one.
+ */
+
+/*
+ * select_interp_kernel: This function returns the fastest kernel
+ * for tables of taps elements a row, 2, 4 or 16, that this processor
+ * supports: AVX2 with FMA on x86 for 16 taps, plain C otherwise.
+ */
+void (*select_interp_kernel(int taps))(
+   const float *, float *, const int *, const unsigned char *,
+   const float *, int);
+
+#endif
\ No newline at end of file
@@ -1,9 +1,51 @@
 #ifndef MISCELLANEOUS_H
 #define MISCELLANEOUS_H
 
+#include <stdio.h>
+#include <stdbool.h>
 #include <stdarg.h>
+#include <setjmp.h>
 #include <inttypes.h>
 
+#define ERR_MSG_MAX 256
+#define ERR_CLEANUP_MAX 16   /* cleanups pushed to an err_trap at once */
+
+#define PROGRESS_AUTO  0   /* a bar if stdout is a terminal, else nothing */
+#define PROGRESS_NONE  1
+#define PROGRESS_BAR   2
+#define PROGRESS_LINES 3   /* "progress CURRENT TOTAL PERCENT" lines */
+
+/*
+ * Note: struct err_trap lets a thread get back control from raise_err
+ * instead of having the whole program exit. The thread calls setjmp
+ * on env and then set_err_trap; raise_err stores the message, runs
+ * the cleanups pushed since, the last one first, and jumps back with
+ * the value 1. What is acquired between the trap and the failure is
+ * released by those cleanups rather than skipped.
+ */
+struct err_trap {
+   jmp_buf env;
+   char msg[ERR_MSG_MAX];
+   struct err_trap *outer;   /* the one set before, to be set back */
+   bool is_unwinding;   /* the cleanups are running */
+   int cleanup_count;
+   struct {
+      void (*release)(void *);
+      void *arg;
+   } cleanups[ERR_CLEANUP_MAX];
+};
+
+/*
+ * Note: struct progress_hook lets a thread take the reports of
+ * print_progress_bar for itself instead of having them printed,
+ * e.g. to pass them on to a client. report is called as often as
+ * a report would be printed.
+ */
+struct progress_hook {
+   void (*report)(void *arg, uint32_t current, uint32_t total);
+   void *arg;
+};
+
 /*
  * endrev16: This function reverses the byte order,
  * namely endianness, for an uint16_t number.
@@ -21,11 +63,47 @@ inline void endrev32(uint32_t *p) {
         (*p & 0x00FF0000) >> 8 | (*p & 0xFF000000) >> 24;
 }
 
+/*
+ * endrev64: This function reverses the byte order,
+ * namely endianness, for an uint64_t number.
+ */
+inline void endrev64(uint64_t *p) {
+   uint32_t high = *p >> 32, low = *p;
+
+   endrev32(&high);
+   endrev32(&low);
+   *p = (uint64_t) low << 32 | high;
+}
+
 /*
  * raise_err: This funciton prints an error to the
- * stderr stream.
+ * stderr stream. If the calling thread has set an
+ * err_trap, the error is handed to it instead. It
+ * never returns.
+ */
+void raise_err(char *err_msg, ...) __attribute__((noreturn));
+
+/*
+ * set_err_trap: This function sets the err_trap of the
+ * calling thread; NULL removes it. It returns the err_trap
+ * set before, so that it can be set back with the cleanups
+ * pushed to it still in place.
  */
-void raise_err(char *err_msg, ...);
+struct err_trap *set_err_trap(struct err_trap *trap);
+
+/*
+ * push_err_cleanup: This function has release(arg) called if
+ * raise_err jumps to the err_trap of the calling thread before
+ * pop_err_cleanup(arg). Without an err_trap, it does nothing,
+ * as raise_err ends the program anyway.
+ */
+void push_err_cleanup(void (*release)(void *), void *arg);
+
+/*
+ * pop_err_cleanup: This function removes the last cleanup pushed
+ * with arg, once what it releases has been released otherwise.
+ */
+void pop_err_cleanup(void *arg);
 
 /*
  * get_endianness: This function checks which endianness
@@ -40,9 +118,29 @@ int get_endianness(void);
  */
 int count_digit(uint32_t number);
 
+/*
+ * count_online_cpus: This function returns the number of
+ * processors currently online, or 1 if it is unknown.
+ */
+int count_online_cpus(void);
+
+/*
+ * set_progress_output: This function chooses how
+ * print_progress_bar() reports, PROGRESS_BAR or PROGRESS_LINES,
+ * and where to; out = NULL means stdout.
+ */
+void set_progress_output(int style, FILE *out);
+
+/*
+ * set_progress_hook: This function sets the progress_hook of the
+ * calling thread; NULL removes it.
+ */
+void set_progress_hook(struct progress_hook *hook);
+
 /*
  * print_progress_bar: This function displays how much of the
- * work has been done.
+ * work has been done, at most ten times a second, or hands it
+ * to the progress_hook of the calling thread.
  */
 void print_progress_bar(
    uint32_t current, uint32_t total, int total_digit);
@@ -0,0 +1,45 @@
+#ifndef OLA_H
+#define OLA_H
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include "audio_io.h"
+
+#define OLA_READ_FRAMES 4096   /* frames overlap_add() reads at once */
+
+/*
+ * ola_frame_number: This function returns the number of frames
+ * overlap_add() produces out of total_frame frames.
+ */
+uint32_t ola_frame_number(int mode, uint32_t total_frame, double factor);
+
+/*
+ * overlap_add: This function changes the pitch (GRAIN_PITCH) or the
+ * speed (GRAIN_SPEED) of the audio data read from io by overlapping
+ * Hann-windowed grains of at most grain_size frames, overlap percent
+ * of a grain apart, 50 or 75, so that every grain fades into the
+ * next. For the pitch, the grains are taken a hop apart and read at
+ * factor times the speed; for the speed, they are taken factor hops
+ * apart and read as they are. A grain read at another speed is
+ * interpolated by interp, one of INTERP_*, with the table coef of
+ * lookup_interp_table(). The input and the overlap-add sums
+ * are held in ring buffers of a few grains, whatever the length of
+ * the input. The samples are of format, one of SAMPLE_*, in and out.
+ * total_frame = UINT32_MAX means "until the end of the input." It
+ * returns the number of frames written.
+ */
+uint32_t overlap_add(
+   struct audio_io *io,
+   int mode,
+   uint16_t num_channels,
+   uint32_t total_frame,
+   int grain_size,
+   int overlap,
+   double factor,
+   int interp,
+   const float *coef,
+   int format,
+   bool show_progress
+);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,136 @@
+#ifndef PITSH_H
+#define PITSH_H
+
+/*
+ * libpitsh: the pitch shifter and time stretcher of pitsh as a
+ * library. A processor is fed interleaved 16-bit frames in the
+ * byte order of the machine with pitsh_push and gives back the
+ * processed frames with pitsh_pull. Every function reports errors
+ * by its return value and none of them exits. Once configured, a
+ * processor allocates no memory while processing.
+ */
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* return values */
+#define PITSH_OK              0
+#define PITSH_ERR_ARGUMENT   -1   /* an invalid argument */
+#define PITSH_ERR_MEMORY     -2   /* a failed allocation */
+#define PITSH_ERR_STATE      -3   /* not configured yet */
+#define PITSH_ERR_AGAIN      -4   /* pull the pending output first */
+
+/* pitsh_config.mode */
+#define PITSH_MODE_PITCH 1   /* --pitch */
+#define PITSH_MODE_SPEED 2   /* --speed */
+
+/* pitsh_config.window */
+#define PITSH_WINDOW_LINEAR 1
+#define PITSH_WINDOW_HANN   2
+#define PITSH_WINDOW_TUKEY  3
+
+#define PITSH_MIN_GRAIN_SIZE 32
+#define PITSH_MAX_GRAIN_SIZE 1048576
+#define PITSH_MAX_CHANNELS   16
+#define PITSH_MAX_FACTOR     3
+
+struct pitsh_config {
+   int mode;
+   double factor;        /* 0 < factor <= PITSH_MAX_FACTOR */
+   int grain_size;       /* in frames; pitsh uses 2205 by default */
+   int num_channels;
+   int window;
+   double window_ratio;  /* only for PITSH_WINDOW_TUKEY; 0 ~ 1 */
+};
+
+struct pitsh_processor;
+
+/*
+ * pitsh_create: This function creates a new processor, which
+ * must be configured before use.
+ */
+int pitsh_create(struct pitsh_processor **processor);
+
+/*
+ * pitsh_configure: This function (re)configures the processor,
+ * allocating everything it will need, and discards any audio
+ * pushed before.
+ */
+int pitsh_configure(
+   struct pitsh_processor *processor,
+   const struct pitsh_config *config
+);
+
+/*
+ * pitsh_push: This function takes up to frame_count frames and
+ * stores the number actually taken to accepted. Fewer frames are
+ * taken when a processed grain waits to be pulled.
+ */
+int pitsh_push(
+   struct pitsh_processor *processor,
+   const int16_t *frames,
+   size_t frame_count,
+   size_t *accepted
+);
+
+/*
+ * pitsh_pull: This function gives back up to capacity processed
+ * frames and stores the number actually given to produced.
+ */
+int pitsh_pull(
+   struct pitsh_processor *processor,
+   int16_t *frames,
+   size_t capacity,
+   size_t *produced
+);
+
+/*
+ * pitsh_flush: This function processes the incomplete grain left
+ * at the end of the input, padded with silence; the output is cut
+ * to the length the incomplete grain stands for. Pull everything
+ * afterwards; then the processor is ready for a new input.
+ */
+int pitsh_flush(struct pitsh_processor *processor);
+
+/*
+ * pitsh_process_block: This function is the real-time way of using
+ * a PITSH_MODE_PITCH processor: it takes frames frames from in and
+ * puts as many into out, which come out pitsh_latency() frames
+ * later; silence comes out until then. Any block size works, the
+ * work per block is bounded by one grain, and nothing is allocated
+ * or locked. It must not be mixed with pitsh_push and pitsh_pull
+ * on the same processor.
+ */
+int pitsh_process_block(
+   struct pitsh_processor *processor,
+   const int16_t *in,
+   int16_t *out,
+   size_t frames
+);
+
+/*
+ * pitsh_latency: This function returns the number of frames to be
+ * pushed before the first processed frame can be pulled, which is
+ * also the fixed delay of pitsh_process_block.
+ */
+size_t pitsh_latency(const struct pitsh_processor *processor);
+
+/*
+ * pitsh_destroy: This function frees the processor.
+ */
+void pitsh_destroy(struct pitsh_processor *processor);
+
+/*
+ * pitsh_strerror: This function describes a return value.
+ */
+const char *pitsh_strerror(int error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
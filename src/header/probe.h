@@ -0,0 +1,21 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <stdbool.h>
+#include "execution_options.h"
+
+#define PROBE_READ_SIZE 4096      /* bytes read at first for a header */
+#define PROBE_READ_MAX  (1 << 20) /* for headers after big chunks */
+
+/*
+ * run_probe: This function reads the header of every file given
+ * to --probe, spread across the threads, and prints one JSON
+ * object per file, in the order given, with the wav_info fields
+ * and whether this program can process the file. Every object has
+ * the same keys, null where a value is unknown. A single path
+ * - reads the paths from stdin, one per line. It returns the
+ * number of the files that can't be processed.
+ */
+int run_probe(struct execution_options *options, bool is_le);
+
+#endif
\ No newline at end of file
@@ -6,17 +6,62 @@
 #include <inttypes.h>
 #include "wave_file.h"
 #include "execution_options.h"
+#include "worker_pool.h"
+#include "window_table.h"
+#include "audio_io.h"
+#include "fft.h"
+
+#define ENGINE_GRAIN   1   /* shift_pitch / stretch_time */
+#define ENGINE_WSOLA   2
+#define ENGINE_VOCODER 3
+
+#define MIN_GRAIN_MS      50   /* 2205 frames at 44100 Hz */
+#define MAX_GRAIN_MS      200  /* 8820 frames at 44100 Hz */
+#define MIN_RT_GRAIN_SIZE 64   /* frames; with --realtime */
+
+/*
+ * Note: struct processing_context gathers what the files processed
+ * one after another can share: the worker pool for the grains, the
+ * window tables, the FFT plans and the grain buffers. It owns none
+ * of them. Once *cancel turns true, the file being processed is
+ * cut short where the engine is, and is_cut_short is set unless the
+ * engine had already got to the end; see is_io_cancelled.
+ */
+struct processing_context {
+   struct worker_pool *pool;
+   struct window_cache *windows;
+   struct fft_cache *plans;
+   struct io_buffers *buffers;
+   const bool *cancel;   /* accessed atomically; NULL if never */
+   bool is_cut_short;    /* of the last file; set by process_audio_data */
+};
+
+/*
+ * fit_grain_size: This function sets options->size, the grain size
+ * in frames, for the sample rate of info: from --size in ms, or as
+ * given in frames. The size has to be MIN_GRAIN_MS ~ MAX_GRAIN_MS
+ * long, or from MIN_RT_GRAIN_SIZE frames on with --realtime.
+ */
+void fit_grain_size(
+   struct execution_options *options,
+   const struct wav_info *info
+);
 
 /*
  * process_audio_data: This function is the main part of this program.
  * It reads and processes audio data from the input wav file.
  * Also, it writes the processed results to the output wav file.
+ * The grains are processed in parallel on the worker pool of the
+ * context, whose window tables and buffers are used as well. The
+ * grain size is fitted to the input by fit_grain_size first, and
+ * context->is_cut_short is set if *context->cancel stopped it.
  */
 uint32_t process_audio_data(
    FILE *src,
    FILE *dest,
    struct wav_info *info,
    struct execution_options *options,
+   struct processing_context *context,
    bool is_le
 );
 
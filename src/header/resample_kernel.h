@@ -0,0 +1,44 @@
+#ifndef RESAMPLE_KERNEL_H
+#define RESAMPLE_KERNEL_H
+
+#include <inttypes.h>
+
+/*
+ * Every resample kernel computes, for 0 <= i < len and every channel,
+ *
+ *    dest[num_channels * i + channel]
+ *       = src[num_channels * read_index[i] + channel] * window[i]
+ *
+ * with the truncation toward zero and the saturation of int16_t.
+ * The vectorized kernels give exactly the same results as the
+ * scalar one, which is kept as the reference.
+ */
+
+/*
+ * resample_scalar: This function is the plain C resample kernel.
+ */
+void resample_scalar(
+   const int16_t *src,
+   int16_t *dest,
+   const int *read_index,
+   const double *window,
+   int len,
+   int num_channels
+);
+
+/*
+ * select_resample_kernel: This function returns the fastest resample
+ * kernel that this processor supports. The choice is made at run time:
+ * AVX2 or SSE4.1 on x86 according to CPUID, NEON on AArch64, and the
+ * scalar kernel otherwise.
+ */
+void (*select_resample_kernel(void))(
+   const int16_t *, int16_t *, const int *, const double *, int, int);
+
+/*
+ * resample_kernel_name: This function tells which kernel
+ * select_resample_kernel() chooses, e.g. "avx2".
+ */
+const char *resample_kernel_name(void);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,163 @@
+#ifndef SAMPLE_FORMAT_H
+#define SAMPLE_FORMAT_H
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define SAMPLE_INT16   1
+#define SAMPLE_INT24   2   /* packed in three bytes */
+#define SAMPLE_INT32   3
+#define SAMPLE_FLOAT32 4   /* IEEE 754 single precision */
+
+/*
+ * Note: A sample in a wav file is little-endian whatever the host
+ * is, so the samples are put together and taken apart byte by byte
+ * here; no separate swap is needed on a big-endian host.
+ */
+
+/*
+ * sample_size: This function returns the number of bytes of one
+ * sample of the format.
+ */
+int sample_size(int format);
+
+/*
+ * sample_format_name: This function returns the name of the
+ * format, e.g. "int24".
+ */
+const char *sample_format_name(int format);
+
+/*
+ * load_sample: This function reads the sample of the format at p
+ * and returns it scaled to [-1, 1); a float sample is returned
+ * as it is.
+ */
+inline float load_sample(int format, const unsigned char *p) {
+   uint32_t bits;
+   float value;
+
+   switch (format) {
+      case SAMPLE_INT16:
+         return (int16_t) (p[0] | p[1] << 8) / 32768.0f;
+      case SAMPLE_INT24:
+         bits = (uint32_t) p[0] << 8 | (uint32_t) p[1] << 16
+                | (uint32_t) p[2] << 24;
+         return (int32_t) bits / 2147483648.0f;
+      case SAMPLE_INT32:
+         bits = (uint32_t) p[0] | (uint32_t) p[1] << 8
+                | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+         return (int32_t) bits / 2147483648.0f;
+      default:
+         bits = (uint32_t) p[0] | (uint32_t) p[1] << 8
+                | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+         memcpy(&value, &bits, 4);
+         return value;
+   }
+}
+
+/*
+ * store_sample: This function writes value, scaled as load_sample()
+ * returns it, to p as a sample of the format. An integer sample is
+ * rounded to the nearest and saturated.
+ */
+inline void store_sample(int format, unsigned char *p, float value) {
+   double scaled;
+   int32_t integer;
+   uint32_t bits;
+
+   switch (format) {
+      case SAMPLE_INT16:
+         scaled = floorf(value * 32768.0f + 0.5f);
+         if (scaled > INT16_MAX) scaled = INT16_MAX;
+         if (scaled < INT16_MIN) scaled = INT16_MIN;
+         integer = (int32_t) scaled;
+         p[0] = integer;
+         p[1] = integer >> 8;
+         return;
+      case SAMPLE_INT24:
+         scaled = floor(value * 8388608.0 + 0.5);
+         if (scaled > 8388607) scaled = 8388607;
+         if (scaled < -8388608) scaled = -8388608;
+         integer = (int32_t) scaled;
+         p[0] = integer;
+         p[1] = integer >> 8;
+         p[2] = integer >> 16;
+         return;
+      case SAMPLE_INT32:
+         scaled = floor(value * 2147483648.0 + 0.5);
+         if (scaled > INT32_MAX) scaled = INT32_MAX;
+         if (scaled < INT32_MIN) scaled = INT32_MIN;
+         bits = (uint32_t) (int32_t) scaled;
+         break;
+      default:
+         memcpy(&bits, &value, 4);
+   }
+   p[0] = bits;
+   p[1] = bits >> 8;
+   p[2] = bits >> 16;
+   p[3] = bits >> 24;
+}
+
+/*
+ * Note: The engines work on planar floats: one contiguous array per
+ * channel, scaled as load_sample() returns them. The interleaved
+ * samples of the file are converted to and from them in one pass,
+ * which deinterleaves, converts and, on a big-endian host, swaps
+ * the bytes at once.
+ */
+
+/*
+ * deinterleave_samples: This function converts count frames of the
+ * interleaved samples of the format at src into
+ * planes[channel][first + i], 0 <= i < count.
+ */
+void deinterleave_samples(
+   int format,
+   const void *src,
+   float *const *planes,
+   size_t first,
+   size_t count,
+   int num_channels
+);
+
+/*
+ * interleave_samples: This function converts planes[channel][first + i],
+ * 0 <= i < count, into count frames of the interleaved samples of
+ * the format at dest, rounded as by store_sample().
+ */
+void interleave_samples(
+   int format,
+   float *const *planes,
+   size_t first,
+   void *dest,
+   size_t count,
+   int num_channels
+);
+
+/*
+ * select_planar_kernel: This function returns the resample kernel
+ * of the grain engine for the samples of the format. For one
+ * channel, it computes, for 0 <= i < len,
+ *
+ *    dest[num_channels * i] = plane[read_index[i]] * window[i]
+ *
+ * reading the contiguous plane of the channel and storing into the
+ * interleaved output of the format, dest being the first sample of
+ * the channel there. An integer sample is truncated toward zero and
+ * saturated, as resample_scalar() does for 16-bit samples, with
+ * which the results agree. 16-bit samples have AVX2 and SSE4.1
+ * kernels on x86 and a NEON one on AArch64, as resample_scalar()
+ * has; the other formats are scalar.
+ */
+void (*select_planar_kernel(int format))(
+   const float *, void *, const int *, const double *, int, int);
+
+/*
+ * planar_kernel_name: This function tells which kernel
+ * select_planar_kernel() chooses for the format, e.g. "avx2".
+ */
+const char *planar_kernel_name(int format);
+
+#endif
\ No newline at end of file
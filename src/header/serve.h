@@ -0,0 +1,39 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stdbool.h>
+#include "execution_options.h"
+#include "env_data.h"
+
+#define SERVE_LINE_MAX 4096   /* bytes per request line */
+#define SERVE_ID_MAX   64     /* bytes per job ID */
+
+/*
+ * run_server: This function listens on the Unix socket given by
+ * --serve and runs the jobs sent to it on --jobs workers, which
+ * keep their threads and buffers from one job to the next, until
+ * SIGINT or SIGTERM stops it. A client sends lines of
+ *
+ *    job ID pitch|speed FACTOR SRC DEST [size=SIZE] [priority=N]
+ *    cancel ID
+ *
+ * where SIZE is as for --size and a higher N goes first, and gets
+ * back a line per event of its jobs:
+ *
+ *    queued ID
+ *    started ID
+ *    progress ID CURRENT TOTAL PERCENT
+ *    done ID BYTES
+ *    failed ID MESSAGE
+ *    cancelled ID
+ *
+ * or "error MESSAGE" for a request it can't take. The job IDs are
+ * those of the client; another client can't cancel its jobs.
+ */
+void run_server(
+   struct execution_options *options,
+   struct env_data *env,
+   bool is_le
+);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/*
+ * Note: struct spsc_ring passes fixed-size slots from exactly one
+ * producer thread to exactly one consumer thread. Each side only
+ * ever advances its own counter, so a slot changes hands without a
+ * lock; the mutex and the condition are only taken by a side that
+ * finds the ring full or empty and has to sleep until the other
+ * side moves on.
+ */
+struct spsc_ring {
+   void (*unrealize)(struct spsc_ring *);
+   int slot_count;
+   size_t slot_size;   /* bytes per slot */
+
+   /* accessed atomically; the slots ever published and released */
+   size_t head;
+   size_t tail;
+   bool closed;
+   int sleepers;
+   pthread_mutex_t lock;
+   pthread_cond_t moved;
+
+   /* fields to be freed */
+   size_t *lens;   /* slot_count elements; bytes published per slot */
+   unsigned char *slots;
+   struct spsc_ring *self;
+};
+
+/*
+ * realize_spsc_ring: This function creates a new, empty struct
+ * spsc_ring of slot_count slots of slot_size bytes.
+ */
+struct spsc_ring *realize_spsc_ring(int slot_count, size_t slot_size);
+
+/*
+ * acquire_slot: This function returns the next slot for the
+ * producer to fill, waiting while every slot is taken. It returns
+ * NULL once the ring has been closed.
+ */
+void *acquire_slot(struct spsc_ring *ring);
+
+/*
+ * publish_slot: This function hands the slot returned by
+ * acquire_slot, len bytes of it filled, over to the consumer.
+ */
+void publish_slot(struct spsc_ring *ring, size_t len);
+
+/*
+ * peek_slot: This function returns the oldest published slot and
+ * stores its length to len, waiting while there is none. It returns
+ * NULL once the ring has been closed and every slot published
+ * before has been released.
+ */
+const void *peek_slot(struct spsc_ring *ring, size_t *len);
+
+/*
+ * release_slot: This function gives the slot returned by peek_slot
+ * back to the producer.
+ */
+void release_slot(struct spsc_ring *ring);
+
+/*
+ * close_ring: This function tells the other side that no more slots
+ * will be published or taken, waking it up if it is waiting. The
+ * producer closes the ring at its end; the consumer closes it to
+ * stop the producer early.
+ */
+void close_ring(struct spsc_ring *ring);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#define STATS_OFF  0
+#define STATS_TEXT 1   /* --stats */
+#define STATS_JSON 2   /* --stats=json */
+
+#define STAGE_READ     0   /* reading or mapping the input */
+#define STAGE_PROCESS  1   /* resampling grains; WSOLA or vocoder frames */
+#define STAGE_CONVERT  2   /* interleaved samples to planar floats and back */
+#define STAGE_WRITE    3
+#define STAGE_PROGRESS 4   /* print_progress_bar */
+#define STAGE_COUNT    5
+
+#define COUNT_GRAINS        0
+#define COUNT_FRAMES        1   /* WSOLA or vocoder frames */
+#define COUNT_BYTES_READ    2
+#define COUNT_BYTES_WRITTEN 3
+#define COUNT_ALLOCS        4   /* buffers and tables; none per grain */
+#define COUNT_ALLOC_BYTES   5
+#define COUNT_COUNT         6
+
+/*
+ * Note: struct run_stats adds up, over the whole run and every
+ * thread, the time spent in each stage and a few counters. The
+ * times of the stages run by the workers are summed over them, so
+ * they may exceed the wall time.
+ */
+struct run_stats {
+   uint64_t start_ns;
+   uint64_t stage_ns[STAGE_COUNT];
+   uint64_t stage_calls[STAGE_COUNT];
+   uint64_t counters[COUNT_COUNT];
+};
+
+/* NULL unless --stats is set; then nothing else is measured. */
+extern struct run_stats *run_stats;
+
+/*
+ * enable_stats: This function starts measuring the run.
+ */
+void enable_stats(void);
+
+/*
+ * stats_clock: This function returns the monotonic clock in ns.
+ */
+uint64_t stats_clock(void);
+
+/*
+ * stats_begin: This function returns the time a stage starts at,
+ * or 0 without measuring anything when the stats are off.
+ */
+inline uint64_t stats_begin(void) {
+   return run_stats != NULL ? stats_clock() : 0;
+}
+
+/*
+ * stats_end: This function adds the time since start to the stage.
+ */
+inline void stats_end(int stage, uint64_t start) {
+   if (run_stats != NULL) {
+      __atomic_fetch_add(&run_stats->stage_ns[stage],
+         stats_clock() - start, __ATOMIC_RELAXED);
+      __atomic_fetch_add(&run_stats->stage_calls[stage], 1, __ATOMIC_RELAXED);
+   }
+}
+
+/*
+ * stats_count: This function adds amount to the counter.
+ */
+inline void stats_count(int counter, uint64_t amount) {
+   if (run_stats != NULL)
+      __atomic_fetch_add(&run_stats->counters[counter], amount, __ATOMIC_RELAXED);
+}
+
+/*
+ * stats_alloc: This function counts an allocation of bytes bytes.
+ */
+inline void stats_alloc(uint64_t bytes) {
+   stats_count(COUNT_ALLOCS, 1);
+   stats_count(COUNT_ALLOC_BYTES, bytes);
+}
+
+/*
+ * print_stats: This function prints the breakdown of the run to
+ * fp, as a table or, with as_json, as one JSON object.
+ */
+void print_stats(FILE *fp, bool as_json);
+
+#endif
\ No newline at end of file
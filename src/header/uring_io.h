@@ -0,0 +1,109 @@
+#ifndef URING_IO_H
+#define URING_IO_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+/*
+ * Note: struct uring_io reads the source and writes the destination
+ * through a Linux io_uring, set up by the raw system calls. Its
+ * buffers are registered with the kernel once, so the requests are
+ * READ_FIXED and WRITE_FIXED ones, and up to slot_count of each are
+ * in flight at once: the reads run ahead at the following offsets
+ * while the caller works on the oldest one, and each write is
+ * submitted as soon as it is committed. The slots are handed out in
+ * the order of their offsets.
+ */
+struct uring_io {
+   void (*unrealize)(struct uring_io *);
+   int ring_fd;
+   int src_fd;
+   int dest_fd;
+   int slot_count;        /* per direction */
+   size_t src_slot_size;  /* bytes */
+   size_t dest_slot_size;
+   uint64_t src_offset;   /* where the next read is submitted at */
+   uint64_t src_end;      /* UINT64_MAX if unknown */
+   uint64_t dest_offset;  /* where the next write is submitted at */
+   int src_next;          /* the slot handed out next */
+   int dest_next;
+   int in_flight;
+   bool is_src_done;      /* a read has come back short */
+   int src_error;         /* errno of a failed read, or 0 */
+   bool is_dest_failed;
+
+   /* the rings shared with the kernel */
+   unsigned *sq_head;
+   unsigned *sq_tail;
+   unsigned *sq_mask;
+   unsigned *sq_array;
+   void *sqes;
+   unsigned *cq_head;
+   unsigned *cq_tail;
+   unsigned *cq_mask;
+   void *cqes;
+   void *sq_map;
+   size_t sq_map_len;
+   void *cq_map;
+   size_t cq_map_len;
+   size_t sqes_len;
+
+   /* fields to be freed */
+   int *states;      /* 2 * slot_count; the sources come first */
+   int *lens;        /* 2 * slot_count; bytes asked for, then done */
+   unsigned char *buffers;   /* page-aligned */
+   struct uring_io *self;
+};
+
+/*
+ * realize_uring_io: This function creates a new struct uring_io
+ * reading src_fd from src_offset, up to src_size bytes or the end
+ * of the file, and writing dest_fd from dest_offset, and submits
+ * the first reads. It returns NULL, leaving nothing behind, if the
+ * kernel lacks io_uring, the buffers can't be registered or either
+ * file is not a regular one; the caller then falls back on stdio.
+ */
+struct uring_io *realize_uring_io(
+   int src_fd,
+   uint64_t src_offset,
+   uint64_t src_size,
+   int dest_fd,
+   uint64_t dest_offset,
+   size_t src_slot_size,
+   size_t dest_slot_size,
+   int slot_count
+);
+
+/*
+ * peek_uring_slot: This function waits for the oldest read and
+ * returns its slot, storing the number of bytes read to len. It
+ * returns NULL at the end of the source.
+ */
+const void *peek_uring_slot(struct uring_io *uring, size_t *len);
+
+/*
+ * release_uring_slot: This function gives the slot returned by
+ * peek_uring_slot back, to be read into again further on.
+ */
+void release_uring_slot(struct uring_io *uring);
+
+/*
+ * reserve_uring_slot: This function returns the next destination
+ * slot, waiting for its previous write to complete.
+ */
+void *reserve_uring_slot(struct uring_io *uring);
+
+/*
+ * commit_uring_slot: This function submits the write of len bytes
+ * of the slot returned by reserve_uring_slot.
+ */
+void commit_uring_slot(struct uring_io *uring, size_t len);
+
+/*
+ * finish_uring_io: This function waits for every request in flight.
+ * It returns false if a write has failed.
+ */
+bool finish_uring_io(struct uring_io *uring);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef VOCODER_H
+#define VOCODER_H
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include "audio_io.h"
+#include "fft.h"
+#include "worker_pool.h"
+
+#define VOCODER_READ_FRAMES 4096   /* frames vocode() reads at once */
+
+/*
+ * vocoder_frame_size: This function returns the FFT size the
+ * vocoder uses for the given grain size: the largest power of two
+ * not above it.
+ */
+int vocoder_frame_size(int grain_size);
+
+/*
+ * vocoder_frame_number: This function returns the number of frames
+ * vocode() produces out of total_frame frames.
+ */
+uint32_t vocoder_frame_number(int mode, uint32_t total_frame, double factor);
+
+/*
+ * vocode: This function changes the pitch (GRAIN_PITCH) or the
+ * speed (GRAIN_SPEED) of the audio data read from io by a phase
+ * vocoder with identity phase locking. Frames of the plan's size
+ * are analyzed a quarter frame apart. For the pitch, the audio is
+ * stretched by factor and then resampled back to its length. The
+ * channels of a frame are processed in parallel on pool.
+ * The samples are of format, one of SAMPLE_*, in and out.
+ * total_frame = UINT32_MAX means "until the end of the input." It
+ * returns the number of frames written.
+ */
+uint32_t vocode(
+   struct audio_io *io,
+   struct worker_pool *pool,
+   const struct fft_plan *plan,
+   int mode,
+   uint16_t num_channels,
+   uint32_t total_frame,
+   double factor,
+   int format,
+   bool show_progress
+);
+
+#endif
\ No newline at end of file
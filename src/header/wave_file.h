@@ -6,9 +6,28 @@
 #include "execution_options.h"
 #include "env_data.h"
 
+#define STREAM_NAME "-"   /* --src - or --dest - */
+#define WAV_UNKNOWN_SIZE UINT64_MAX   /* the data size of an endless stream */
+#define WAV_SIZE_PLACEHOLDER 0xFFFFFFFF   /* a 32-bit size given elsewhere */
+#define DS64_CHUNK_SIZE 36   /* the ds64 chunk of RF64 without a table */
+
+#define MIN_SAMPLE_RATE 8000
+#define MAX_SAMPLE_RATE 192000
+#define MAX_CHANNELS    16   /* up to 7.1 stems and then some */
+
+#define WAVE_FORMAT_PCM        0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+/*
+ * Note: An RF64 or BW64 file is a wav file whose sizes don't fit in
+ * 32 bits: it says so in a ds64 chunk, right after WAVE, and puts
+ * WAV_SIZE_PLACEHOLDER in the RIFF and data sizes. struct wav_info
+ * holds the sizes in 64 bits either way.
+ */
 struct wav_info {
    uint32_t chunk_id;
-   uint32_t chunk_size;
+   uint64_t chunk_size;
    uint32_t format;
    uint32_t subchunk_1_id;
    uint32_t subchunk_1_size;
@@ -18,14 +37,23 @@ struct wav_info {
    uint32_t byte_rate;
    uint16_t block_align;
    uint16_t bits_per_sample;
+   uint16_t extension_size;   /* cbSize; 22 for WAVE_FORMAT_EXTENSIBLE */
+   uint16_t valid_bits;
+   uint32_t channel_mask;
+   uint16_t sub_format;       /* the format code at the head of the GUID */
+   int sample_format;         /* SAMPLE_*; set by assess_wav_info */
    uint32_t subchunk_2_id;
-   uint32_t subchunk_2_size;
+   uint64_t subchunk_2_size;   /* or WAV_UNKNOWN_SIZE */
+   bool has_ds64;   /* the output header has room for ds64; see fit_wav_header */
+   bool has_header;   /* the output header has been written ahead */
+   uint64_t header_data_size;   /* the data size in it, if so */
 };
 
 /*
  * observe_wav: This function checks the metadata of the input
  * wav file. Also, it saves the acquired information to the
- * struct wav_info for later use.
+ * struct wav_info for later use. A file that doesn't start as
+ * RIFF/WAVE (or RF64, BW64) is rejected before its chunks.
  */
 void observe_wav(
    FILE *src,
@@ -42,26 +70,67 @@ void show_wav_info(char *file_name, struct wav_info *info);
 
 /*
  * assess_wav_info: This function sees whether the input wav
- * file can be processed by this program.
+ * file can be processed by this program, and if so, sets the
+ * sample_format of info.
  */
 void assess_wav_info(struct wav_info *info);
 
+/*
+ * fit_wav_header: This function decides whether the header of the
+ * output wav file has room for a ds64 chunk, for data_size bytes of
+ * audio data or WAV_UNKNOWN_SIZE: if the sizes may not fit in 32
+ * bits and, for a stream, are known in advance. It has to be called
+ * before the output header is written or wav_header_size() is used
+ * for it.
+ */
+void fit_wav_header(struct wav_info *info, uint64_t data_size, bool is_stream);
+
+/*
+ * wav_header_size: This function returns the size in bytes of the
+ * header written for the output wav file, which carries the fmt
+ * subchunk as the input has it: 44 bytes, or 46 or 68 with the
+ * extension of the fmt subchunk, and DS64_CHUNK_SIZE more with the
+ * room for a ds64 chunk.
+ */
+uint32_t wav_header_size(const struct wav_info *info);
+
 /*
  * write_wav_header: This function writes the metadata for the
- * output wav file.
+ * output wav file: RIFF, or RF64 if the sizes don't fit in 32 bits,
+ * in which case the room left by fit_wav_header is a ds64 chunk
+ * rather than a JUNK one. The header written ahead is left as is if
+ * it holds the right size already, or if the output is a stream,
+ * which can't be rewound. It returns the size of the output wav
+ * file in bytes.
  */
-void write_wav_header(
+uint64_t write_wav_header(
    FILE *dest,
    struct wav_info *info,
    uint32_t sample_number,
    bool is_le,
-   char *dest_path
+   bool is_stream
+);
+
+/*
+ * write_wav_header_ahead: This function writes the metadata for the
+ * output in advance of the audio data, with the sizes expected
+ * for sample_number frames, so that the output is written from the
+ * beginning to the end. sample_number may be UINT32_MAX, for an
+ * endless stream, whose sizes are written as WAV_SIZE_PLACEHOLDER.
+ */
+void write_wav_header_ahead(
+   FILE *dest,
+   struct wav_info *info,
+   uint32_t sample_number,
+   bool is_le
 );
 
 /*
  * open_wav: This function opens two streams for
  * the input wav file and the output wave file
- * before processings are to take place.
+ * before processings are to take place. The name "-"
+ * stands for the standard input or output; for the latter,
+ * *dest must have been set by divert_stdout().
  */
 char *open_wav(
    struct execution_options *options,
@@ -70,6 +139,14 @@ char *open_wav(
    FILE **dest
 );
 
+/*
+ * divert_stdout: This function returns a new stream for the
+ * standard output and points stdout at the standard error, so
+ * that the messages of this program are kept out of the output
+ * wav stream. It must be called before anything is printed.
+ */
+FILE *divert_stdout(void);
+
 /*
  * close_wav: This function closes two streams for
  * the input wav file and the output wave file
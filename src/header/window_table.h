@@ -0,0 +1,73 @@
+#ifndef WINDOW_TABLE_H
+#define WINDOW_TABLE_H
+
+#include <pthread.h>
+
+#define WINDOW_LINEAR 1   /* 10-sample linear ramps at both ends */
+#define WINDOW_HANN   2
+#define WINDOW_TUKEY  3   /* cosine ramps over ratio of the length */
+
+struct window_table {
+   int shape;
+   double ratio;
+   int len;
+   double *values;
+   struct window_table *next;
+};
+
+struct interp_table {
+   int interp;
+   double cutoff;
+   float *coef;
+   struct interp_table *next;
+};
+
+/*
+ * Note: struct window_cache keeps every window table built so far,
+ * so that a table is computed once per shape and length no matter
+ * how many grains and files use it. The interpolation tables are
+ * kept alike, once per kind and cutoff. It can be shared by threads.
+ */
+struct window_cache {
+   void (*unrealize)(struct window_cache *);
+   pthread_mutex_t lock;
+
+   /* fields to be freed */
+   struct window_table *head;
+   struct interp_table *interp_head;
+   struct window_cache *self;
+};
+
+/*
+ * realize_window_cache: This function creates a new, empty
+ * struct window_cache.
+ */
+struct window_cache *realize_window_cache(void);
+
+/*
+ * lookup_window: This function returns the len values of the
+ * window of the given shape, building the table on the first
+ * request. ratio only matters for WINDOW_TUKEY. The table
+ * belongs to the cache; NULL means a failed allocation.
+ */
+const double *lookup_window(
+   struct window_cache *cache,
+   int shape,
+   double ratio,
+   int len
+);
+
+/*
+ * lookup_interp_table: This function returns the coefficients of
+ * the given interpolation, INTERP_PHASES rows of interp_taps(interp)
+ * elements (see grain_plan.h), building the table on the first
+ * request. cutoff only matters for INTERP_SINC. The table belongs
+ * to the cache; NULL means a failed allocation.
+ */
+const float *lookup_interp_table(
+   struct window_cache *cache,
+   int interp,
+   double cutoff
+);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "miscellaneous.h"
+
+struct worker_pool {
+   void (*unrealize)(struct worker_pool *);
+   int num_threads;  /* including the thread calling run_worker_pool */
+
+   /* shared state; guarded by lock */
+   pthread_mutex_t lock;
+   pthread_cond_t work_ready;
+   pthread_cond_t work_done;
+   void (*task)(void *, int);
+   void *arg;
+   int count;
+   int next;
+   int pending;
+   bool quit;
+   bool is_failed;         /* a task of this run has raised an error */
+   char msg[ERR_MSG_MAX];  /* the first error raised */
+
+   /* fields to be freed */
+   pthread_t *threads;
+   struct worker_pool *self;
+};
+
+/*
+ * realize_worker_pool: This function creates a new struct
+ * worker_pool which owns num_threads - 1 background threads.
+ * The calling thread works as the last one.
+ */
+struct worker_pool *realize_worker_pool(int num_threads);
+
+/*
+ * run_worker_pool: This function calls task(arg, i) for every
+ * i in [0, count) on the threads of the pool and returns
+ * after all of the calls have finished. If a task raises an
+ * error, the tasks not started yet are skipped, and the error
+ * is raised again on the calling thread once the others are
+ * over.
+ */
+void run_worker_pool(
+   struct worker_pool *pool,
+   void (*task)(void *, int),
+   void *arg,
+   int count
+);
+
+#endif
\ No newline at end of file
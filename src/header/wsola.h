@@ -0,0 +1,36 @@
+#ifndef WSOLA_H
+#define WSOLA_H
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include "audio_io.h"
+
+#define WSOLA_READ_FRAMES 4096   /* frames stretch_wsola() reads at once */
+
+/*
+ * wsola_frame_number: This function returns the number of frames
+ * stretch_wsola() produces out of total_frame frames.
+ */
+uint32_t wsola_frame_number(uint32_t total_frame, double speed_factor);
+
+/*
+ * stretch_wsola: This function changes the speed of the audio data
+ * read from io by WSOLA (waveform-similarity overlap-add): frames of
+ * frame_len frames are overlap-added at half a frame apart, each
+ * taken from where, around its nominal position, it best matches
+ * the continuation of the previous one. The samples are of format,
+ * one of SAMPLE_*, in and out. total_frame = UINT32_MAX means
+ * "until the end of the input." It returns the number of frames
+ * written.
+ */
+uint32_t stretch_wsola(
+   struct audio_io *io,
+   uint16_t num_channels,
+   uint32_t total_frame,
+   int frame_len,
+   double speed_factor,
+   int format,
+   bool show_progress
+);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "interp_kernel.h"
+#include "grain_plan.h"
+
+#if !defined(PITSH_NO_SIMD) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/*
+ * Note: The number of taps is fixed in each kernel, so that the
+ * compiler unrolls the sum.
+ */
+#define DEFINE_INTERP_KERNEL(name, taps) \
+   static void name( \
+      const float *plane, \
+      float *out, \
+      const int *read_index, \
+      const unsigned char *phase, \
+      const float *coef, \
+      int len \
+   ) { \
+      const float *x, *c; \
+      float sum; \
+      int i, t; \
+   \
+      for (i = 0; i < len; i++) { \
+         x = plane + read_index[i] - ((taps) / 2 - 1); \
+         c = coef + (taps) * phase[i]; \
+         sum = 0; \
+         for (t = 0; t < (taps); t++) \
+            sum += c[t] * x[t]; \
+         out[i] = sum; \
+      } \
+   }
+
+DEFINE_INTERP_KERNEL(interpolate_linear, 2)
+DEFINE_INTERP_KERNEL(interpolate_cubic, 4)
+DEFINE_INTERP_KERNEL(interpolate_sinc, 16)
+
+#ifdef HAVE_X86_KERNELS
+/*
+ * Note: A row of 16 taps is two vectors. The products of eight
+ * outputs are summed across by a tree of horizontal additions, which
+ * leaves the eight sums in order in one vector.
+ */
+__attribute__((target("avx2,fma")))
+static void interpolate_sinc_avx2(
+   const float *plane,
+   float *out,
+   const int *read_index,
+   const unsigned char *phase,
+   const float *coef,
+   int len
+) {
+   __m256 v[8], low, high;
+   const float *x, *c;
+   int i, k, t;
+   float sum;
+
+   for (i = 0; i + 8 <= len; i += 8) {
+      for (k = 0; k < 8; k++) {
+         x = plane + read_index[i + k] - 7;
+         c = coef + 16 * phase[i + k];
+         v[k] = _mm256_fmadd_ps(_mm256_loadu_ps(x + 8), _mm256_loadu_ps(c + 8),
+                   _mm256_mul_ps(_mm256_loadu_ps(x), _mm256_loadu_ps(c)));
+      }
+      low = _mm256_hadd_ps(_mm256_hadd_ps(v[0], v[1]),
+                           _mm256_hadd_ps(v[2], v[3]));
+      high = _mm256_hadd_ps(_mm256_hadd_ps(v[4], v[5]),
+                            _mm256_hadd_ps(v[6], v[7]));
+      _mm256_storeu_ps(out + i, _mm256_add_ps(
+         _mm256_permute2f128_ps(low, high, 0x20),
+         _mm256_permute2f128_ps(low, high, 0x31)));
+   }
+   for (; i < len; i++) {
+      x = plane + read_index[i] - 7;
+      c = coef + 16 * phase[i];
+      sum = 0;
+      for (t = 0; t < 16; t++)
+         sum += c[t] * x[t];
+      out[i] = sum;
+   }
+}
+#endif
+
+void (*select_interp_kernel(int taps))(
+   const float *, float *, const int *, const unsigned char *,
+   const float *, int) {
+   switch (taps) {
+      case 2:
+         return interpolate_linear;
+      case 4:
+         return interpolate_cubic;
+   }
+#ifdef HAVE_X86_KERNELS
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      return interpolate_sinc_avx2;
+#endif
+   return interpolate_sinc;
+}
\ No newline at end of file
@@ -1,3 +1,5 @@
+#include <stdlib.h>
+#include <unistd.h>
 #include "wave_file.h"
 #include "miscellaneous.h"
 #include "execution_options.h"
@@ -5,29 +7,89 @@
 #include "command_line.h"
 #include "envfile_reader.h"
 #include "processing.h"
+#include "worker_pool.h"
+#include "window_table.h"
+#include "audio_io.h"
+#include "batch.h"
+#include "probe.h"
+#include "serve.h"
+#include "stats.h"
 
 int main(int argc, char **argv) {
    FILE *src, *dest;
+   FILE *progress = NULL;
    struct wav_info info;
    struct execution_options *options;
    struct env_data *env;
+   struct processing_context context;
    uint32_t sample_number;
+   uint64_t size;
+   int failed;
    char *dest_path;
    bool is_le = get_endianness();
 
    options = realize_execution_options();
    env = realize_env_data();
    inspect_execution_options(argc, argv, options);
+   if (options->stats != STATS_OFF)
+      enable_stats();
+   if (options->stream_dest)
+      dest = divert_stdout();
+   /* The bar is for a person at a terminal; lines are for programs. */
+   if (options->progress_fd >= 0) {
+      progress = fdopen(options->progress_fd, "w");
+      if (progress == NULL)
+         raise_err("%s: Failed to open the file descriptor %d.",
+            __func__, options->progress_fd);
+   }
+   if (options->progress_style == PROGRESS_AUTO)
+      options->progress_style
+         = progress != NULL || isatty(STDOUT_FILENO)
+           ? PROGRESS_BAR : PROGRESS_NONE;
+   options->show_progress = options->progress_style != PROGRESS_NONE;
+   set_progress_output(options->progress_style, progress);
+   if (options->probe_names != NULL) {
+      failed = run_probe(options, is_le);
+      print_stats(stderr, options->stats == STATS_JSON);
+      options->unrealize(options->self);
+      env->unrealize(env->self);
+      return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+   }
    read_env(env, options);
+   if (options->batch_name != NULL) {
+      failed = run_batch(options, env, is_le);
+      print_stats(stderr, options->stats == STATS_JSON);
+      options->unrealize(options->self);
+      env->unrealize(env->self);
+      return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+   }
+   if (options->serve_name != NULL) {
+      run_server(options, env, is_le);
+      print_stats(stderr, options->stats == STATS_JSON);
+      options->unrealize(options->self);
+      env->unrealize(env->self);
+      return EXIT_SUCCESS;
+   }
    dest_path = open_wav(options, env, &src, &dest);
    observe_wav(src, &info, is_le, options->verbose);
    if (options->verbose)
       show_wav_info(options->src_name, &info);
    assess_wav_info(&info);
+   context.pool = realize_worker_pool(options->threads);
+   context.windows = realize_window_cache();
+   context.plans = realize_fft_cache();
+   context.buffers = realize_io_buffers();
+   context.cancel = NULL;
    sample_number = process_audio_data(
-      src, dest, &info, options, is_le);
-   write_wav_header(
-      dest, &info, sample_number, is_le, dest_path);
+      src, dest, &info, options, &context, is_le);
+   context.buffers->unrealize(context.buffers->self);
+   context.plans->unrealize(context.plans->self);
+   context.windows->unrealize(context.windows->self);
+   context.pool->unrealize(context.pool->self);
+   size = write_wav_header(
+      dest, &info, sample_number, is_le, options->stream_dest);
+   printf("\a\nDone: %s, %" PRIu64 " (bytes)\n", dest_path, size);
+   print_stats(stderr, options->stats == STATS_JSON);
    close_wav(src, dest);
    options->unrealize(options->self);
    env->unrealize(env->self);
@@ -1,20 +1,94 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include "miscellaneous.h"
+#include "stats.h"
 
 extern void endrev16(uint16_t *);
 extern void endrev32(uint32_t *);
+extern void endrev64(uint64_t *);
 
+#define PROGRESS_INTERVAL_NS 100000000u   /* at most 10 reports a second */
+
+static _Thread_local struct err_trap *err_trap = NULL;
+static int progress_style = PROGRESS_BAR;
+static FILE *progress_out = NULL;   /* stdout unless set */
+static _Thread_local uint64_t progress_last_ns;
+static _Thread_local bool progress_started;
+static _Thread_local struct progress_hook *progress_hook = NULL;
+
+/*
+ * Note: A cleanup failing in turn only cuts the other cleanups
+ * short; the first message is the one kept.
+ */
 void raise_err(char *err_msg, ...) {
+   struct err_trap *trap = err_trap;
    va_list ap;
    
    va_start(ap, err_msg);
+   if (trap != NULL) {
+      if (!trap->is_unwinding)
+         vsnprintf(trap->msg, ERR_MSG_MAX, err_msg, ap);
+      va_end(ap);
+      trap->is_unwinding = true;
+      while (trap->cleanup_count > 0) {
+         trap->cleanup_count--;
+         trap->cleanups[trap->cleanup_count].release(
+            trap->cleanups[trap->cleanup_count].arg);
+      }
+      longjmp(trap->env, 1);
+   }
    vfprintf(stderr, err_msg, ap);
    va_end(ap);
    fprintf(stderr, "\n");
    exit(EXIT_FAILURE);
 }
 
+/*
+ * Note: An err_trap being set back, the outer one of the err_trap
+ * set now, is not a new one; its cleanups are kept.
+ */
+struct err_trap *set_err_trap(struct err_trap *trap) {
+   struct err_trap *prev = err_trap;
+
+   if (trap != NULL && (prev == NULL || prev->outer != trap)) {
+      trap->outer = prev;
+      trap->is_unwinding = false;
+      trap->cleanup_count = 0;
+   }
+   err_trap = trap;
+
+   return prev;
+}
+
+void push_err_cleanup(void (*release)(void *), void *arg) {
+   if (err_trap == NULL)
+      return;
+   if (err_trap->cleanup_count == ERR_CLEANUP_MAX) {
+      /* Released at once, as it could not be later on. */
+      release(arg);
+      raise_err("%s: Too many cleanups pushed.", __func__);
+   }
+   err_trap->cleanups[err_trap->cleanup_count].release = release;
+   err_trap->cleanups[err_trap->cleanup_count].arg = arg;
+   err_trap->cleanup_count++;
+}
+
+void pop_err_cleanup(void *arg) {
+   int i;
+
+   if (err_trap == NULL)
+      return;
+   for (i = err_trap->cleanup_count - 1; i >= 0; i--)
+      if (err_trap->cleanups[i].arg == arg)
+         break;
+   if (i < 0)
+      return;
+   for (; i < err_trap->cleanup_count - 1; i++)
+      err_trap->cleanups[i] = err_trap->cleanups[i + 1];
+   err_trap->cleanup_count--;
+}
+
 int get_endianness(void) {
    int test = 1;
    char *test_ptr = (char *) &test;
@@ -32,26 +106,60 @@ int count_digit(uint32_t number) {
    return count;
 }
 
-static void move_cursor_to_line_start(int n) {
-   for (int i = 0; i < n; i++)
-      putchar('\b');
+int count_online_cpus(void) {
+   long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+   return count < 1 ? 1 : (int) count;
 }
 
+void set_progress_output(int style, FILE *out) {
+   progress_style = style;
+   progress_out = out;
+}
+
+void set_progress_hook(struct progress_hook *hook) {
+   progress_hook = hook;
+}
+
+/*
+ * Note: Whatever the caller does, the progress is written at most
+ * PROGRESS_INTERVAL_NS apart, apart from the first and the last
+ * report, so calling this after every batch of grains costs only a
+ * clock read.
+ */
 void print_progress_bar(uint32_t current, uint32_t total, int total_digit) {
+   FILE *out = progress_out != NULL ? progress_out : stdout;
    int i;
-   int progress_percent = (current * 100 / total);
+   int progress_percent = ((uint64_t) current * 100 / total);
    int progress = progress_percent / 5;
    int remains = 20 - progress;
+   uint64_t now = stats_clock();
+   uint64_t start;
+
+   if (current < total && progress_started
+       && now - progress_last_ns < PROGRESS_INTERVAL_NS)
+      return;
+   progress_started = current < total;
+   progress_last_ns = now;
+   if (progress_hook != NULL) {
+      progress_hook->report(progress_hook->arg, current, total);
+      return;
+   }
+   start = stats_begin();
 
-   /* In progress: [***************-----] _75% (_750/1000) */
-
-   /* printf("\033[%dD", 44 + total_digit * 2); */
-   move_cursor_to_line_start(44 + total_digit * 2);
-   fputs("In progress: [", stdout);
-   for (i = 0; i < progress; i++)
-      putchar('*');
-   for (i = 0; i < remains; i++)
-      putchar('-');
-   printf("] %3d%% (%*d/%d)",
-          progress_percent, total_digit, current, total);
+   if (progress_style == PROGRESS_LINES)
+      fprintf(out, "progress %" PRIu32 " %" PRIu32 " %d\n",
+         current, total, progress_percent);
+   else {
+      /* In progress: [***************-----] _75% (_750/1000) */
+      fputs("\rIn progress: [", out);
+      for (i = 0; i < progress; i++)
+         putc('*', out);
+      for (i = 0; i < remains; i++)
+         putc('-', out);
+      fprintf(out, "] %3d%% (%*" PRIu32 "/%" PRIu32 ")",
+         progress_percent, total_digit, current, total);
+   }
+   fflush(out);
+   stats_end(STAGE_PROGRESS, start);
 }
\ No newline at end of file
@@ -0,0 +1,407 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ola.h"
+#include "miscellaneous.h"
+#include "grain_plan.h"
+#include "sample_format.h"
+#include "interp_kernel.h"
+#include "stats.h"
+
+#if !defined(PITSH_NO_SIMD) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/*
+ * Note: struct ola keeps the input and the overlap-add sums in ring
+ * buffers, one array per channel, each a power of two long so that
+ * frame t lives at index t & mask. The first span frames of the
+ * input ring are repeated past its end, so a grain is read from one
+ * contiguous run however it lies in the ring. The input is preceded
+ * by lead frames of silence and the output by the grains that end
+ * within its first frames, which are not written, so that the
+ * output is not faded in. When interpolating, a grain is read from
+ * the taps before its start on and interpolated into grain first.
+ */
+struct ola {
+   int len;          /* frames per grain */
+   int hop;          /* output frames per grain */
+   int grains;       /* grains overlapping at any frame */
+   double in_hop;    /* input frames per grain */
+   uint16_t num_channels;
+   int format;
+   int sample_size;
+   struct audio_io *io;
+   void (*add)(float *, const float *, const float *, const int *, int);
+   void (*interpolate)(
+      const float *, float *, const int *, const unsigned char *,
+      const float *, int);
+   int taps;         /* 1 unless interpolating */
+   int before;       /* taps before the position */
+   const float *coef;
+
+   long in_mask;
+   long span;        /* input frames a grain reads */
+   long acc_mask;
+   long filled;      /* input frames in the ring, the lead included */
+   long lead;
+   bool is_eof;
+   long total_in;    /* frames read */
+
+   /* fields to be freed */
+   int *read_index;  /* len elements */
+   float *window;    /* len elements */
+   unsigned char *phase;   /* len elements, if interpolating */
+   int *in_order;    /* 0 ~ len - 1, if interpolating */
+   float *grain;     /* len elements, if interpolating */
+   float **in;       /* [channel][in_mask + 1 + span] */
+   float **acc;      /* [channel][acc_mask + 1] */
+};
+
+static void prepare(struct ola *, long, long);
+static void release_ola(void *);
+static void fill(struct ola *, const unsigned char *, long, size_t);
+static void emit(struct ola *, long, int, bool);
+static long ring_size(long);
+static void add_scalar(float *, const float *, const float *, const int *, int);
+#ifdef HAVE_X86_KERNELS
+static void add_avx2(float *, const float *, const float *, const int *, int);
+#endif
+
+uint32_t ola_frame_number(int mode, uint32_t total_frame, double factor) {
+   if (mode == GRAIN_PITCH)
+      return total_frame;
+   return total_frame / factor;
+}
+
+uint32_t overlap_add(
+   struct audio_io *io,
+   int mode,
+   uint16_t num_channels,
+   uint32_t total_frame,
+   int grain_size,
+   int overlap,
+   double factor,
+   int interp,
+   const float *coef,
+   int format,
+   bool show_progress
+) {
+   struct ola o;
+   double j;
+   uint32_t out_total, written = 0;
+   int total_digit;
+   long k, from, at;
+   uint64_t start;
+   int channel, i, count, part;
+   const float *in;
+   const int *index;
+   float *acc;
+
+   /* The grain is a whole number of hops for the Hann windows to sum flat. */
+   o.grains = 100 / (100 - overlap);
+   o.hop = grain_size / o.grains;
+   o.len = o.hop * o.grains;
+   o.in_hop = mode == GRAIN_PITCH ? o.hop : o.hop * factor;
+   o.num_channels = num_channels;
+   o.format = format;
+   o.sample_size = sample_size(format);
+   o.io = io;
+   o.add = add_scalar;
+   o.taps = mode == GRAIN_PITCH ? interp_taps(interp) : 1;
+   o.before = o.taps > 1 ? o.taps / 2 - 1 : 0;
+   o.coef = coef;
+   o.lead = lround((o.grains - 1) * o.in_hop) + o.before;
+   o.filled = o.lead;
+   o.is_eof = false;
+   o.total_in = 0;
+#ifdef HAVE_X86_KERNELS
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2"))
+      o.add = add_avx2;
+#endif
+
+   o.read_index = malloc(sizeof(int) * o.len);
+   o.window = malloc(sizeof(float) * o.len);
+   o.phase = NULL;
+   o.in_order = NULL;
+   o.grain = NULL;
+   o.in = NULL;
+   o.acc = NULL;
+   push_err_cleanup(release_ola, &o);
+   if (o.taps > 1) {
+      o.interpolate = select_interp_kernel(o.taps);
+      o.phase = malloc(o.len);
+      o.in_order = malloc(sizeof(int) * o.len);
+      o.grain = malloc(sizeof(float) * o.len);
+      if (o.phase == NULL || o.in_order == NULL || o.grain == NULL)
+         raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   }
+   if (o.read_index == NULL || o.window == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   for (i = 0; i < o.len; i++) {
+      o.read_index[i] = mode == GRAIN_PITCH ? (int) (i * factor) : i;
+      if (o.taps > 1) {
+         /* The fraction is rounded; one rounded up reads the next frame. */
+         j = i * factor - o.read_index[i];
+         count = (int) lround(j * INTERP_PHASES);
+         if (count == INTERP_PHASES) {
+            count = 0;
+            o.read_index[i]++;
+         }
+         o.phase[i] = count;
+         o.in_order[i] = i;
+      }
+      /* The periodic Hann window sums to grains / 2 at a hop apart. */
+      o.window[i] = (0.5 - 0.5 * cos(2 * M_PI * i / o.len)) * 2 / o.grains;
+   }
+   o.span = o.read_index[o.len - 1] + 1 + o.before + o.taps / 2;
+   o.in_mask = ring_size(o.span + OLA_READ_FRAMES + o.lead) - 1;
+   o.acc_mask = ring_size(o.len) - 1;
+   o.in = calloc(num_channels, sizeof(float *));
+   o.acc = calloc(num_channels, sizeof(float *));
+   if (o.in == NULL || o.acc == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   for (channel = 0; channel < num_channels; channel++) {
+      o.in[channel] = calloc(o.in_mask + 1 + o.span, sizeof(float));
+      o.acc[channel] = calloc(o.acc_mask + 1, sizeof(float));
+      if (o.in[channel] == NULL || o.acc[channel] == NULL)
+         raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   }
+   stats_alloc(sizeof(float) * num_channels
+               * (o.in_mask + 1 + o.span + o.acc_mask + 1));
+
+   out_total = total_frame == UINT32_MAX
+               ? UINT32_MAX : ola_frame_number(mode, total_frame, factor);
+   total_digit = count_digit(out_total);
+
+   for (k = 0; written < out_total && !is_io_cancelled(io); k++) {
+      from = lround(k * o.in_hop);
+      prepare(&o, from, from + o.span);
+      if (o.is_eof && total_frame == UINT32_MAX) {
+         out_total = ola_frame_number(mode, o.total_in, factor);
+         if (written >= out_total)
+            break;
+      }
+
+      start = stats_begin();
+      at = k * o.hop;
+      i = (at & o.acc_mask) + o.len - (o.acc_mask + 1);
+      part = i > 0 ? o.len - i : o.len;
+      for (channel = 0; channel < num_channels; channel++) {
+         in = o.in[channel] + (from & o.in_mask);
+         acc = o.acc[channel];
+         index = o.read_index;
+         if (o.taps > 1) {
+            o.interpolate(in + o.before, o.grain,
+               o.read_index, o.phase, o.coef, o.len);
+            in = o.grain;
+            index = o.in_order;
+         }
+         o.add(acc + (at & o.acc_mask), o.window, in, index, part);
+         if (part < o.len)
+            o.add(acc, o.window + part, in, index + part, o.len - part);
+      }
+      stats_end(STAGE_PROCESS, start);
+      stats_count(COUNT_GRAINS, 1);
+
+      /*
+       * The first hop frames of the grain are final now. Those of
+       * the first grains - 1 grains precede the output.
+       */
+      count = o.hop;
+      if (k >= o.grains - 1 && out_total - written < (uint32_t) count)
+         count = out_total - written;
+      emit(&o, at, count, k >= o.grains - 1);
+      if (k >= o.grains - 1) {
+         written += count;
+         if (show_progress)
+            print_progress_bar(written, out_total, total_digit);
+      }
+   }
+
+   pop_err_cleanup(&o);
+   release_ola(&o);
+
+   return written;
+}
+
+/*
+ * Note: release_ola() is also the cleanup of the engine if the file
+ * fails, when the arrays may be allocated only in part.
+ */
+static void release_ola(void *arg) {
+   struct ola *o = arg;
+   int channel;
+
+   for (channel = 0; channel < o->num_channels; channel++) {
+      if (o->in != NULL)
+         free(o->in[channel]);
+      if (o->acc != NULL)
+         free(o->acc[channel]);
+   }
+   free(o->in);
+   free(o->acc);
+   free(o->read_index);
+   free(o->window);
+   free(o->phase);
+   free(o->in_order);
+   free(o->grain);
+}
+
+/*
+ * Note: prepare() makes the input from frame from up to frame end
+ * available, reading over the frames before from, which no grain
+ * reaches any longer. Past the end of the input come zeros.
+ */
+static void prepare(struct ola *o, long from, long end) {
+   long first, size = o->in_mask + 1;
+   size_t count, part;
+   const unsigned char *data;
+   uint16_t nc = o->num_channels;
+   uint64_t start;
+
+   while (o->filled < end) {
+      count = size - (o->filled - from);
+      if (count > OLA_READ_FRAMES)
+         count = OLA_READ_FRAMES;
+      data = NULL;
+      if (!o->is_eof) {
+         count *= nc;
+         if (count > o->io->src_buf_len)
+            count = o->io->src_buf_len / nc * nc;
+         data = o->io->read(o->io, &count);
+         count /= nc;
+         if (count == 0) {
+            o->is_eof = true;
+            data = NULL;
+            count = end - o->filled;
+         }
+      }
+      if (o->is_eof && (long) count > end - o->filled)
+         count = end - o->filled;
+
+      start = stats_begin();
+      first = o->filled & o->in_mask;
+      part = size - first < (long) count ? (size_t) (size - first) : count;
+      fill(o, data, first, part);
+      if (part < count)
+         fill(o, data == NULL ? NULL : data + part * nc * o->sample_size,
+            0, count - part);
+      stats_end(STAGE_CONVERT, start);
+      if (data != NULL)
+         o->total_in += count;
+      o->filled += count;
+   }
+}
+
+/*
+ * Note: fill() converts count frames of data, or zeros if data is
+ * NULL, into the input ring from index first on, without wrapping,
+ * and repeats those within the first span frames past its end.
+ */
+static void fill(
+   struct ola *o,
+   const unsigned char *data,
+   long first,
+   size_t count
+) {
+   long size = o->in_mask + 1, end = first + count;
+   int channel;
+   uint16_t nc = o->num_channels;
+
+   if (data != NULL)
+      deinterleave_samples(o->format, data, o->in, first, count, nc);
+   else
+      for (channel = 0; channel < nc; channel++)
+         memset(o->in[channel] + first, 0, sizeof(float) * count);
+   if (end > o->span)
+      end = o->span;
+   if (first < end)
+      for (channel = 0; channel < nc; channel++)
+         memcpy(o->in[channel] + size + first, o->in[channel] + first,
+            sizeof(float) * (end - first));
+}
+
+/*
+ * Note: emit() writes count frames of the sums from frame at on, if
+ * is_written, and clears hop frames there for the grains to come.
+ */
+static void emit(struct ola *o, long at, int count, bool is_written) {
+   long first = at & o->acc_mask, size = o->acc_mask + 1;
+   int part;
+   int channel;
+   uint16_t nc = o->num_channels;
+   unsigned char *dest;
+   uint64_t start;
+
+   if (is_written && count > 0) {
+      dest = o->io->reserve(o->io, (size_t) count * nc);
+      start = stats_begin();
+      part = size - first < count ? size - first : count;
+      interleave_samples(o->format, o->acc, first, dest, part, nc);
+      if (part < count)
+         interleave_samples(o->format, o->acc, 0,
+            dest + (size_t) part * nc * o->sample_size, count - part, nc);
+      stats_end(STAGE_CONVERT, start);
+      o->io->commit(o->io, (size_t) count * nc);
+   }
+   part = size - first < o->hop ? size - first : o->hop;
+   for (channel = 0; channel < nc; channel++) {
+      memset(o->acc[channel] + first, 0, sizeof(float) * part);
+      memset(o->acc[channel], 0, sizeof(float) * (o->hop - part));
+   }
+}
+
+static long ring_size(long len) {
+   long size = 1;
+
+   while (size < len)
+      size <<= 1;
+   return size;
+}
+
+/*
+ * Note: The add kernels sum one channel of a grain into acc:
+ * acc[i] += window[i] * src[read_index[i]], 0 <= i < len.
+ */
+static void add_scalar(
+   float *acc,
+   const float *window,
+   const float *src,
+   const int *read_index,
+   int len
+) {
+   int i;
+
+   for (i = 0; i < len; i++)
+      acc[i] += window[i] * src[read_index[i]];
+}
+
+#ifdef HAVE_X86_KERNELS
+/*
+ * Note: Without fused multiply-add, the sums are the same as those
+ * of add_scalar().
+ */
+__attribute__((target("avx2")))
+static void add_avx2(
+   float *acc,
+   const float *window,
+   const float *src,
+   const int *read_index,
+   int len
+) {
+   __m256 values;
+   int i;
+
+   for (i = 0; i + 8 <= len; i += 8) {
+      values = _mm256_i32gather_ps(src,
+         _mm256_loadu_si256((const __m256i *) (read_index + i)), 4);
+      _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i),
+         _mm256_mul_ps(_mm256_loadu_ps(window + i), values)));
+   }
+   for (; i < len; i++)
+      acc[i] += window[i] * src[read_index[i]];
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "pitsh.h"
+#include "grain_plan.h"
+#include "resample_kernel.h"
+
+struct pitsh_processor {
+   struct pitsh_config config;
+   bool is_configured;
+   void (*resample)(
+      const int16_t *, int16_t *, const int *, const double *, int, int);
+   int part;
+   size_t src_len;     /* samples per source grain */
+   size_t dest_len;    /* samples per destination grain */
+   size_t src_fill;    /* samples pushed into src_buf */
+   size_t dest_pos;    /* samples pulled from dest_buf */
+   size_t dest_fill;   /* samples processed into dest_buf */
+
+   /* fields to be freed */
+   int *read_index;
+   double *window;
+   int16_t *src_buf;
+   int16_t *dest_buf;
+};
+
+static void release(struct pitsh_processor *);
+static void advance(struct pitsh_processor *);
+
+int pitsh_create(struct pitsh_processor **processor) {
+   struct pitsh_processor *objptr;
+
+   if (processor == NULL)
+      return PITSH_ERR_ARGUMENT;
+   objptr = calloc(1, sizeof(struct pitsh_processor));
+   if (objptr == NULL)
+      return PITSH_ERR_MEMORY;
+   *processor = objptr;
+
+   return PITSH_OK;
+}
+
+int pitsh_configure(
+   struct pitsh_processor *processor,
+   const struct pitsh_config *config
+) {
+   struct pitsh_processor *p = processor;
+
+   if (p == NULL || config == NULL)
+      return PITSH_ERR_ARGUMENT;
+   if ((config->mode != PITSH_MODE_PITCH && config->mode != PITSH_MODE_SPEED)
+       || !(config->factor > 0 && config->factor <= PITSH_MAX_FACTOR)
+       || config->grain_size < PITSH_MIN_GRAIN_SIZE
+       || config->grain_size > PITSH_MAX_GRAIN_SIZE
+       || config->num_channels < 1
+       || config->num_channels > PITSH_MAX_CHANNELS
+       || (config->window != PITSH_WINDOW_LINEAR
+           && config->window != PITSH_WINDOW_HANN
+           && config->window != PITSH_WINDOW_TUKEY)
+       || !(config->window_ratio >= 0 && config->window_ratio <= 1))
+      return PITSH_ERR_ARGUMENT;
+
+   release(p);
+   p->config = *config;
+   p->part = grain_part(config->mode, config->grain_size, config->factor);
+   p->src_len = (size_t) config->grain_size * config->num_channels;
+   p->dest_len = (size_t) p->part * config->num_channels;
+   p->read_index = malloc(sizeof(int) * p->part);
+   p->window = malloc(sizeof(double) * p->part);
+   p->src_buf = malloc(sizeof(int16_t) * p->src_len);
+   p->dest_buf = malloc(sizeof(int16_t) * p->dest_len);
+   if (p->read_index == NULL || p->window == NULL
+       || p->src_buf == NULL || p->dest_buf == NULL) {
+      release(p);
+      return PITSH_ERR_MEMORY;
+   }
+
+   /* PITSH_MODE_* and PITSH_WINDOW_* are the numbers used inside. */
+   plan_read_index(p->read_index, config->mode,
+      config->grain_size, p->part, config->factor);
+   fill_window(p->window, config->window, p->part, config->window_ratio);
+   p->resample = select_resample_kernel();
+   p->is_configured = true;
+
+   return PITSH_OK;
+}
+
+int pitsh_push(
+   struct pitsh_processor *processor,
+   const int16_t *frames,
+   size_t frame_count,
+   size_t *accepted
+) {
+   struct pitsh_processor *p = processor;
+   size_t channels, count, taken = 0;
+
+   if (p == NULL || accepted == NULL || (frames == NULL && frame_count > 0))
+      return PITSH_ERR_ARGUMENT;
+   *accepted = 0;
+   if (!p->is_configured)
+      return PITSH_ERR_STATE;
+
+   channels = p->config.num_channels;
+   while (taken < frame_count && p->src_fill < p->src_len) {
+      count = (p->src_len - p->src_fill) / channels;
+      if (count > frame_count - taken)
+         count = frame_count - taken;
+      memcpy(p->src_buf + p->src_fill, frames + taken * channels,
+         sizeof(int16_t) * count * channels);
+      p->src_fill += count * channels;
+      taken += count;
+      advance(p);
+   }
+   *accepted = taken;
+
+   return PITSH_OK;
+}
+
+int pitsh_pull(
+   struct pitsh_processor *processor,
+   int16_t *frames,
+   size_t capacity,
+   size_t *produced
+) {
+   struct pitsh_processor *p = processor;
+   size_t channels, count, given = 0;
+
+   if (p == NULL || produced == NULL || (frames == NULL && capacity > 0))
+      return PITSH_ERR_ARGUMENT;
+   *produced = 0;
+   if (!p->is_configured)
+      return PITSH_ERR_STATE;
+
+   channels = p->config.num_channels;
+   while (given < capacity && p->dest_pos < p->dest_fill) {
+      count = (p->dest_fill - p->dest_pos) / channels;
+      if (count > capacity - given)
+         count = capacity - given;
+      memcpy(frames + given * channels, p->dest_buf + p->dest_pos,
+         sizeof(int16_t) * count * channels);
+      p->dest_pos += count * channels;
+      given += count;
+      advance(p);
+   }
+   *produced = given;
+
+   return PITSH_OK;
+}
+
+int pitsh_flush(struct pitsh_processor *processor) {
+   struct pitsh_processor *p = processor;
+   size_t channels, frames;
+
+   if (p == NULL)
+      return PITSH_ERR_ARGUMENT;
+   if (!p->is_configured)
+      return PITSH_ERR_STATE;
+   if (p->dest_pos < p->dest_fill)
+      return PITSH_ERR_AGAIN;
+   if (p->src_fill == 0)
+      return PITSH_OK;
+
+   channels = p->config.num_channels;
+   frames = p->src_fill / channels;
+   memset(p->src_buf + p->src_fill, 0,
+      sizeof(int16_t) * (p->src_len - p->src_fill));
+   p->src_fill = p->src_len;
+   advance(p);
+   p->dest_fill = frames * p->part / p->config.grain_size * channels;
+
+   return PITSH_OK;
+}
+
+int pitsh_process_block(
+   struct pitsh_processor *processor,
+   const int16_t *in,
+   int16_t *out,
+   size_t frames
+) {
+   struct pitsh_processor *p = processor;
+   size_t channels, count, done = 0;
+
+   if (p == NULL || ((in == NULL || out == NULL) && frames > 0))
+      return PITSH_ERR_ARGUMENT;
+   if (!p->is_configured)
+      return PITSH_ERR_STATE;
+   if (p->config.mode != PITSH_MODE_PITCH)
+      return PITSH_ERR_ARGUMENT;
+
+   /*
+    * The input and the output move in step: the grain being filled
+    * and the previous grain being played back share one position,
+    * so the previous grain has been played entirely at the moment
+    * the next one is complete and replaces it.
+    */
+   channels = p->config.num_channels;
+   while (done < frames) {
+      count = (p->src_len - p->src_fill) / channels;
+      if (count > frames - done)
+         count = frames - done;
+      if (p->dest_fill == 0)
+         memset(out + done * channels, 0, sizeof(int16_t) * count * channels);
+      else
+         memcpy(out + done * channels, p->dest_buf + p->src_fill,
+            sizeof(int16_t) * count * channels);
+      memcpy(p->src_buf + p->src_fill, in + done * channels,
+         sizeof(int16_t) * count * channels);
+      p->src_fill += count * channels;
+      done += count;
+      if (p->src_fill == p->src_len) {
+         p->resample(p->src_buf, p->dest_buf, p->read_index, p->window,
+            p->part, p->config.num_channels);
+         p->src_fill = 0;
+         p->dest_fill = p->dest_len;
+      }
+   }
+
+   return PITSH_OK;
+}
+
+size_t pitsh_latency(const struct pitsh_processor *processor) {
+   if (processor == NULL || !processor->is_configured)
+      return 0;
+
+   return processor->config.grain_size;
+}
+
+void pitsh_destroy(struct pitsh_processor *processor) {
+   if (processor == NULL)
+      return;
+   release(processor);
+   free(processor);
+}
+
+const char *pitsh_strerror(int error) {
+   switch (error) {
+      case PITSH_OK: return "Success.";
+      case PITSH_ERR_ARGUMENT: return "An invalid argument.";
+      case PITSH_ERR_MEMORY: return "Failed to allocate memory dynamically.";
+      case PITSH_ERR_STATE: return "The processor is not configured.";
+      case PITSH_ERR_AGAIN: return "The processed frames need to be pulled first.";
+      default: return "An unknown error.";
+   }
+}
+
+/*
+ * Note: advance() processes the source grain as soon as it is
+ * complete and the previous output has been pulled entirely.
+ */
+static void advance(struct pitsh_processor *p) {
+   if (p->src_fill < p->src_len || p->dest_pos < p->dest_fill)
+      return;
+   p->resample(p->src_buf, p->dest_buf, p->read_index, p->window,
+      p->part, p->config.num_channels);
+   p->src_fill = 0;
+   p->dest_pos = 0;
+   p->dest_fill = p->dest_len;
+}
+
+static void release(struct pitsh_processor *p) {
+   free(p->read_index);
+   free(p->window);
+   free(p->src_buf);
+   free(p->dest_buf);
+   p->read_index = NULL;
+   p->window = NULL;
+   p->src_buf = NULL;
+   p->dest_buf = NULL;
+   p->is_configured = false;
+   p->src_fill = 0;
+   p->dest_pos = 0;
+   p->dest_fill = 0;
+}
\ No newline at end of file
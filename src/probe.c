@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "probe.h"
+#include "wave_file.h"
+#include "sample_format.h"
+#include "worker_pool.h"
+#include "miscellaneous.h"
+#include "stats.h"
+
+struct probe_result {
+   struct wav_info info;
+   uint64_t file_size;
+   long data_offset;     /* where the audio data start */
+   bool is_opened;       /* file_size is known */
+   bool is_parsed;       /* observe_wav got through the header */
+   bool is_compatible;   /* and so did assess_wav_info */
+   char msg[ERR_MSG_MAX];
+};
+
+struct probe {
+   char **names;
+   int count;
+   bool is_le;
+
+   /* fields to be freed */
+   struct probe_result *results;
+};
+
+static char **read_names(int *, char **);
+static void probe_file(void *, int);
+static bool parse_header(
+   unsigned char *, size_t, struct probe_result *, bool);
+static void print_result(const char *, const struct probe_result *);
+static void print_json_string(const char *);
+static void print_fourcc(uint32_t);
+
+int run_probe(struct execution_options *options, bool is_le) {
+   struct probe probe;
+   struct worker_pool *pool;
+   char *text = NULL;
+   int failed = 0;
+   int i;
+
+   probe.names = options->probe_names;
+   probe.count = options->probe_count;
+   probe.is_le = is_le;
+   if (probe.count == 1 && strcmp(probe.names[0], STREAM_NAME) == 0)
+      probe.names = read_names(&probe.count, &text);
+   probe.results = malloc(sizeof(struct probe_result) * (probe.count + 1));
+   if (probe.results == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+
+   pool = realize_worker_pool(options->threads);
+   run_worker_pool(pool, probe_file, &probe, probe.count);
+   pool->unrealize(pool->self);
+
+   for (i = 0; i < probe.count; i++) {
+      print_result(probe.names[i], &probe.results[i]);
+      if (!probe.results[i].is_compatible)
+         failed++;
+   }
+
+   free(probe.results);
+   if (text != NULL) {
+      free(probe.names);
+      free(text);
+   }
+
+   return failed;
+}
+
+/*
+ * Note: read_names() reads stdin at once, as read_manifest() does
+ * the manifest of --batch, and cuts it into the paths in place,
+ * stored to text. Empty lines are ignored.
+ */
+static char **read_names(int *count, char **text) {
+   char **names = NULL, **grown;
+   char *line, *next_line;
+   size_t len = 0, capacity = BUFSIZ;
+   int name_capacity = 0;
+
+   *text = malloc(capacity + 1);
+   if (*text == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   while ((len += fread(*text + len, 1, capacity - len, stdin)) == capacity) {
+      capacity *= 2;
+      line = realloc(*text, capacity + 1);
+      if (line == NULL)
+         raise_err("%s: Failed to allocate memory dynamically.", __func__);
+      *text = line;
+   }
+   if (ferror(stdin))
+      raise_err("%s: Failed to read the paths from stdin.", __func__);
+   (*text)[len] = '\0';
+
+   *count = 0;
+   for (line = *text; line != NULL; line = next_line) {
+      next_line = strchr(line, '\n');
+      if (next_line != NULL)
+         *next_line++ = '\0';
+      line[strcspn(line, "\r")] = '\0';
+      if (line[0] == '\0')
+         continue;
+      if (*count == name_capacity) {
+         name_capacity = name_capacity == 0 ? 64 : name_capacity * 2;
+         grown = realloc(names, sizeof(char *) * name_capacity);
+         if (grown == NULL)
+            raise_err("%s: Failed to allocate memory dynamically.", __func__);
+         names = grown;
+      }
+      names[(*count)++] = line;
+   }
+
+   return names;
+}
+
+/*
+ * Note: probe_file() reads the first PROBE_READ_SIZE bytes of the
+ * file, which hold the whole header of almost every wav file, with
+ * a single pread. Only a WAVE file whose chunks before the audio
+ * data run past them is read again, up to PROBE_READ_MAX bytes.
+ */
+static void probe_file(void *arg, int idx) {
+   struct probe *probe = arg;
+   struct probe_result *result = &probe->results[idx];
+   unsigned char head[PROBE_READ_SIZE];
+   unsigned char *buf = head;
+   size_t len = PROBE_READ_SIZE;
+   struct stat st;
+   ssize_t count;
+   int fd;
+
+   result->is_opened = false;
+   result->is_parsed = false;
+   result->is_compatible = false;
+   fd = open(probe->names[idx], O_RDONLY);
+   if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+      snprintf(result->msg, ERR_MSG_MAX,
+         "%s: Failed to open the regular file.", __func__);
+      if (fd >= 0)
+         close(fd);
+      return;
+   }
+   result->is_opened = true;
+   result->file_size = st.st_size;
+
+   for (;;) {
+      count = pread(fd, buf, len, 0);
+      if (count < 0) {
+         snprintf(result->msg, ERR_MSG_MAX,
+            "%s: Failed to read the file.", __func__);
+         break;
+      }
+      stats_count(COUNT_BYTES_READ, count);
+      if (parse_header(buf, count, result, probe->is_le)
+          || (size_t) count < len || len == PROBE_READ_MAX
+          || memcmp(buf + 8, "WAVE", 4) != 0)
+         break;
+      len = PROBE_READ_MAX;
+      buf = malloc(len);
+      if (buf == NULL)
+         raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   }
+
+   if (buf != head)
+      free(buf);
+   close(fd);
+}
+
+/*
+ * Note: parse_header() goes through observe_wav and assess_wav_info
+ * over the len bytes of buf, with their errors caught rather than
+ * ending the program. It returns false if the header went on past
+ * buf, true otherwise, whether the file turned out compatible or
+ * not.
+ */
+static bool parse_header(
+   unsigned char *buf,
+   size_t len,
+   struct probe_result *result,
+   bool is_le
+) {
+   struct err_trap trap, *outer;
+   FILE *src;
+   bool is_short;
+
+   if (len == 0) {
+      snprintf(result->msg, ERR_MSG_MAX, "%s: An empty file.", __func__);
+      return true;
+   }
+   src = fmemopen(buf, len, "r");
+   if (src == NULL)
+      raise_err("%s: Failed to open a memory stream.", __func__);
+
+   outer = set_err_trap(&trap);
+   if (setjmp(trap.env) == 0) {
+      observe_wav(src, &result->info, is_le, false);
+      result->is_parsed = true;
+      result->data_offset = ftell(src);
+      assess_wav_info(&result->info);
+      result->is_compatible = true;
+   }
+   else
+      memcpy(result->msg, trap.msg, ERR_MSG_MAX);
+   set_err_trap(outer);
+   is_short = !result->is_parsed && feof(src);
+   fclose(src);
+
+   return !is_short;
+}
+
+/*
+ * Note: print_result() prints every key whatever became of the file,
+ * with null for what it didn't get to, so that each line can be read
+ * the same way.
+ */
+static void print_result(const char *name, const struct probe_result *result) {
+   const struct wav_info *info = &result->info;
+
+   printf("{\"path\":");
+   print_json_string(name);
+   printf(",\"compatible\":%s,\"error\":",
+      result->is_compatible ? "true" : "false");
+   if (result->is_compatible)
+      printf("null");
+   else
+      print_json_string(result->msg);
+   printf(",\"file_size\":");
+   if (result->is_opened)
+      printf("%" PRIu64, result->file_size);
+   else
+      printf("null");
+
+   if (result->is_parsed) {
+      printf(",\"chunk_id\":");
+      print_fourcc(info->chunk_id);
+      printf(",\"chunk_size\":%" PRIu64 ",\"format\":", info->chunk_size);
+      print_fourcc(info->format);
+      printf(",\"audio_format\":%d,\"num_channels\":%d"
+             ",\"sample_rate\":%" PRIu32 ",\"byte_rate\":%" PRIu32
+             ",\"block_align\":%d,\"bits_per_sample\":%d"
+             ",\"valid_bits\":%d,\"channel_mask\":%" PRIu32
+             ",\"sub_format\":%d,\"data_offset\":%ld,\"data_size\":",
+         info->audio_format, info->num_channels,
+         info->sample_rate, info->byte_rate,
+         info->block_align, info->bits_per_sample,
+         info->valid_bits, info->channel_mask,
+         info->sub_format, result->data_offset);
+      if (info->subchunk_2_size == WAV_UNKNOWN_SIZE)
+         printf("null");
+      else
+         printf("%" PRIu64, info->subchunk_2_size);
+   }
+   else
+      printf(",\"chunk_id\":null,\"chunk_size\":null,\"format\":null"
+             ",\"audio_format\":null,\"num_channels\":null"
+             ",\"sample_rate\":null,\"byte_rate\":null"
+             ",\"block_align\":null,\"bits_per_sample\":null"
+             ",\"valid_bits\":null,\"channel_mask\":null"
+             ",\"sub_format\":null,\"data_offset\":null,\"data_size\":null");
+   printf(",\"frames\":");
+   if (!result->is_parsed || info->block_align == 0
+       || info->subchunk_2_size == WAV_UNKNOWN_SIZE)
+      printf("null");
+   else
+      printf("%" PRIu64, info->subchunk_2_size / info->block_align);
+   printf(",\"sample_format\":");
+   if (result->is_compatible)
+      printf("\"%s\"", sample_format_name(info->sample_format));
+   else
+      printf("null");
+   printf("}\n");
+}
+
+/* Note: Only the characters JSON forbids in a string are escaped. */
+static void print_json_string(const char *str) {
+   const unsigned char *pos;
+
+   putchar('"');
+   for (pos = (const unsigned char *) str; *pos != '\0'; pos++) {
+      if (*pos == '"' || *pos == '\\')
+         printf("\\%c", *pos);
+      else if (*pos < 0x20)
+         printf("\\u%04x", *pos);
+      else
+         putchar(*pos);
+   }
+   putchar('"');
+}
+
+/* Note: This function prints 0x52494646 as "RIFF". */
+static void print_fourcc(uint32_t id) {
+   char fourcc[5] = {0};
+   int i;
+
+   for (i = 3; i >= 0; i--)
+      fourcc[3 - i] = (id >> (i * 8)) & 0xFF;
+   print_json_string(fourcc);
+}
\ No newline at end of file
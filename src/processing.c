@@ -1,177 +1,668 @@
+#include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 #include "processing.h"
 #include "miscellaneous.h"
+#include "audio_io.h"
+#include "grain_plan.h"
+#include "interp_kernel.h"
+#include "pitsh.h"
+#include "wsola.h"
+#include "ola.h"
+#include "vocoder.h"
+#include "sample_format.h"
+#include "stats.h"
 
-static uint32_t shift_pitch(
+#define GRAINS_PER_THREAD 8
+
+/*
+ * Note: struct grain_engine holds everything the resample kernel
+ * needs to turn one source grain into one destination grain. Every
+ * grain depends only on its own source samples, so grains can
+ * be handed to the workers in any order. A source grain is first
+ * made planar, one contiguous array per channel, and resample then
+ * works channel by channel, storing into the output format. When
+ * interpolating, each plane is framed by the taps it needs, wrapped
+ * around as the grain loops, and a channel is interpolated into the
+ * part after the planes before being stored in order.
+ */
+struct grain_engine {
+   void (*resample)(
+      const float *, void *, const int *, const double *, int, int);
+   void (*interpolate)(
+      const float *, float *, const int *, const unsigned char *,
+      const float *, int);
+   int format;
+   int sample_size;
+   int grain_size;
+   int part;
+   double factor;
+   uint16_t num_channels;
+   int src_len;    /* samples per source grain */
+   int dest_len;   /* samples per destination grain */
+   int taps;        /* 1 unless interpolating */
+   int plane_len;   /* grain_size + taps - 1 */
+   int scratch_len; /* planar elements for each grain of a batch */
+   const double *window;   /* part elements; owned by the window cache */
+   const float *coef;      /* owned by the window cache; if interpolating */
+
+   /* fields to be freed */
+   int *read_index;   /* part elements; the same for every grain */
+   unsigned char *phase;   /* part elements, if interpolating */
+   int *in_order;     /* 0 ~ part - 1, if interpolating */
+   float *planar;
+};
+
+/* Note: struct realtime is what run_realtime() has to release. */
+struct realtime {
+   struct pitsh_processor *processor;
+   int16_t *in_buf;
+   int16_t *out_buf;
+};
+
+struct grain_batch {
+   const struct grain_engine *engine;
+   const unsigned char *src_buf;
+   unsigned char *dest_buf;
+};
+
+static void plan_interpolation(
+   struct grain_engine *, struct execution_options *, struct window_cache *);
+static void release_grain_engine(void *);
+static void release_realtime(void *);
+static uint32_t run_grain_engine(
+   struct audio_io *,
+   struct grain_engine *, uint32_t, int,
+   struct worker_pool *, bool);
+static uint32_t run_realtime(
    FILE *, FILE *,
    struct wav_info *, struct execution_options *,
    bool);
-static uint32_t stretch_time(
+static uint32_t run_wsola(
    FILE *, FILE *,
    struct wav_info *, struct execution_options *,
-   bool);
+   struct processing_context *, bool);
+static uint32_t run_vocoder(
+   FILE *, FILE *,
+   struct wav_info *, struct execution_options *,
+   struct processing_context *, bool);
+static uint32_t run_overlap_add(
+   FILE *, FILE *,
+   struct wav_info *, struct execution_options *,
+   struct processing_context *, bool);
+
+void fit_grain_size(
+   struct execution_options *options,
+   const struct wav_info *info
+) {
+   uint32_t rate = info->sample_rate;
+   int min = (uint64_t) rate * MIN_GRAIN_MS / 1000;
+   int max = (uint64_t) rate * MAX_GRAIN_MS / 1000;
+
+   if (options->size_ms > 0)
+      options->size = (uint64_t) rate * options->size_ms / 1000;
+   if (options->realtime_block > 0)
+      min = MIN_RT_GRAIN_SIZE;
+   if (options->size < min || options->size > max)
+      raise_err("%s: The grain size %d is out of %d ~ %d frames at %" PRIu32 " Hz.",
+         __func__, options->size, min, max, rate);
+}
 
 uint32_t process_audio_data(
    FILE *src,
    FILE *dest,
    struct wav_info *info,
    struct execution_options *options,
+   struct processing_context *context,
    bool is_le
 ) {
-   uint32_t sample_number;
+   struct grain_engine engine;
+   struct audio_io *io;
+   struct worker_pool *pool = context->pool;
+   int batch_unit = pool->num_threads * GRAINS_PER_THREAD;
+   bool show_progress;
+   uint32_t total_sample, total_unit;
+   uint32_t sample_number = 0;
+   uint64_t frame_number;
+
+   context->is_cut_short = false;
+   fit_grain_size(options, info);
+   if (options->realtime_block > 0)
+      return run_realtime(src, dest, info, options, is_le);
+   if ((options->engine != ENGINE_GRAIN || options->overlap > 0)
+       && options->factor <= 0)
+      raise_err("%s: The engine needs a factor above 0.", __func__);
+   if (options->engine == ENGINE_WSOLA)
+      return run_wsola(src, dest, info, options, context, is_le);
+   if (options->engine == ENGINE_VOCODER)
+      return run_vocoder(src, dest, info, options, context, is_le);
+   if (options->overlap > 0)
+      return run_overlap_add(src, dest, info, options, context, is_le);
+
+   engine.grain_size = options->size;
+   engine.factor = options->factor;
+   engine.num_channels = info->num_channels;
+   engine.src_len = engine.grain_size * engine.num_channels;
+   engine.format = info->sample_format;
+   engine.sample_size = sample_size(engine.format);
+   total_sample = info->subchunk_2_size
+                  / (info->num_channels * (info->bits_per_sample / 8));
+   total_unit = total_sample / engine.grain_size;
+   /* A stream of unknown length is read until its end. */
+   if (info->subchunk_2_size == WAV_UNKNOWN_SIZE)
+      total_unit = UINT32_MAX;
+
+   if (options->mode != GRAIN_PITCH && options->mode != GRAIN_SPEED)
+      return sample_number;
+   /* A grain slowed down that much would not be counted in an int. */
+   if (options->mode == GRAIN_SPEED
+       && !(engine.factor
+            > (double) engine.grain_size * engine.num_channels / INT_MAX))
+      raise_err("%s: The speed factor is too small for the grain size.",
+         __func__);
+   engine.part = grain_part(options->mode, engine.grain_size, engine.factor);
+   /* UINT32_MAX frames stands for an unknown length. */
+   if (total_unit != UINT32_MAX
+       && (uint64_t) total_unit * engine.part >= UINT32_MAX)
+      raise_err("%s: The output would have too many frames.", __func__);
+   engine.dest_len = engine.part * engine.num_channels;
+   engine.resample = select_planar_kernel(engine.format);
+   if (options->verbose)
+      printf("Resample kernel: planar %s, %s\n",
+         sample_format_name(engine.format), planar_kernel_name(engine.format));
+   engine.window = lookup_window(
+      context->windows, options->window_shape, options->window_ratio, engine.part);
+   if (engine.window == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   engine.phase = NULL;
+   engine.in_order = NULL;
+   engine.planar = NULL;
+   engine.read_index = malloc(sizeof(int) * engine.part);
+   push_err_cleanup(release_grain_engine, &engine);
+   if (engine.read_index == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   stats_alloc(sizeof(int) * engine.part);
+   plan_interpolation(&engine, options, context->windows);
+   engine.planar = malloc(sizeof(float) * batch_unit * engine.scratch_len);
+   if (engine.planar == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   stats_alloc(sizeof(float) * batch_unit * engine.scratch_len);
 
-   if (options->mode == 1)
-      sample_number
-         = shift_pitch(src, dest, info, options, is_le);
-   else if (options->mode == 2)
-      sample_number
-         = stretch_time(src, dest, info, options, is_le);
+   fit_wav_header(info,
+      total_unit == UINT32_MAX
+      ? WAV_UNKNOWN_SIZE : (uint64_t) total_unit * engine.dest_len * engine.sample_size,
+      options->stream_dest);
+   write_wav_header_ahead(dest, info,
+      total_unit == UINT32_MAX
+      ? UINT32_MAX : (uint32_t) ((uint64_t) total_unit * engine.part),
+      is_le);
+   io = realize_audio_io(
+      src, dest, options->io_backend, info,
+      total_unit == UINT32_MAX
+      ? 0 : (uint64_t) total_unit * engine.dest_len * engine.sample_size,
+      (size_t) batch_unit * engine.src_len,
+      (size_t) batch_unit * engine.dest_len,
+      context->buffers,
+      options->read_ahead,
+      options->direct_io,
+      context->cancel,
+      options->stream_dest);
+
+   /* the number of total samples. */
+   show_progress = options->show_progress && total_unit != UINT32_MAX;
+   frame_number
+      = (uint64_t) run_grain_engine(
+           io, &engine, total_unit, batch_unit, pool, show_progress)
+        * engine.part;
+   /* Only a stream of unknown length can get this far. */
+   sample_number = frame_number >= UINT32_MAX ? UINT32_MAX : frame_number;
+   context->is_cut_short = io->is_cut_short;
+   io->unrealize(io->self);
+   pop_err_cleanup(&engine);
+   release_grain_engine(&engine);
 
    return sample_number;
 }
 
+/* Note: This is also the cleanup of the engine if the file fails. */
+static void release_grain_engine(void *arg) {
+   struct grain_engine *engine = arg;
+
+   free(engine->read_index);
+   free(engine->phase);
+   free(engine->in_order);
+   free(engine->planar);
+}
+
 /*
- * Note: the function 'window' is for removing 'click' sounds
- * through multiplying the return value of this function
- * by the audio data.
+ * plan_interpolation: This function fills the read positions of the
+ * engine: the source frames alone by default, or with the phases and
+ * the table of --interp when the pitch is shifted. The sinc is cut
+ * off at the Nyquist frequency of the shifted grain when it is read
+ * faster than the source. The positions of --speed are whole frames,
+ * so there is nothing to interpolate.
  */
-inline static double window(int pos, int len) {
-   if (pos < 10)
-      return 0.1 * pos;
-   else if (len - 10 <= pos)
-      return 0.9 - 0.1 * (pos - (len - 10));
-   else
-      return 1;
+static void plan_interpolation(
+   struct grain_engine *engine,
+   struct execution_options *options,
+   struct window_cache *windows
+) {
+   int i;
+
+   engine->taps = 1;
+   engine->coef = NULL;
+   if (options->mode == GRAIN_PITCH)
+      engine->taps = interp_taps(options->interp);
+   engine->plane_len = engine->grain_size + engine->taps - 1;
+   engine->scratch_len = engine->plane_len * engine->num_channels;
+   if (engine->taps == 1) {
+      plan_read_index(engine->read_index, options->mode,
+         engine->grain_size, engine->part, engine->factor);
+      return;
+   }
+
+   engine->scratch_len += engine->part;
+   engine->interpolate = select_interp_kernel(engine->taps);
+   engine->coef = lookup_interp_table(windows, options->interp,
+      engine->factor > 1 ? 1 / engine->factor : 1);
+   engine->phase = malloc(engine->part);
+   engine->in_order = malloc(sizeof(int) * engine->part);
+   if (engine->coef == NULL || engine->phase == NULL
+       || engine->in_order == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   stats_alloc((sizeof(int) + 1) * engine->part);
+   plan_read_phase(engine->read_index, engine->phase, options->mode,
+      engine->grain_size, engine->part, engine->factor);
+   for (i = 0; i < engine->part; i++)
+      engine->in_order[i] = i;
+   if (options->verbose)
+      printf("Interpolation: %d taps.\n", engine->taps);
+}
+
+/*
+ * Note: This is the task given to the worker pool; idx = grain.
+ * The grain is converted to planar floats right before it is
+ * resampled, by the same thread, so they are still in its cache.
+ */
+static void process_grain(void *arg, int idx) {
+   struct grain_batch *batch = arg;
+   const struct grain_engine *engine = batch->engine;
+   int size = engine->sample_size;
+   int before = engine->taps / 2 - 1, after = engine->taps / 2;
+   const unsigned char *src_buf
+      = batch->src_buf + (size_t) idx * engine->src_len * size;
+   unsigned char *dest_buf
+      = batch->dest_buf + (size_t) idx * engine->dest_len * size;
+   float *planar = engine->planar + (size_t) idx * engine->scratch_len;
+   float *interpolated
+      = planar + (size_t) engine->num_channels * engine->plane_len;
+   float *planes[MAX_CHANNELS];
+   float *plane;
+   int channel, k;
+   uint64_t start = stats_begin();
+
+   if (before < 0)
+      before = 0;
+   for (channel = 0; channel < engine->num_channels; channel++)
+      planes[channel]
+         = planar + (size_t) channel * engine->plane_len + before;
+   deinterleave_samples(engine->format, src_buf, planes,
+      0, engine->grain_size, engine->num_channels);
+   for (channel = 0; channel < engine->num_channels; channel++) {
+      plane = planes[channel];
+      for (k = 1; k <= before; k++)
+         plane[-k] = plane[engine->grain_size - k];
+      for (k = 0; k < after; k++)
+         plane[engine->grain_size + k] = plane[k];
+   }
+   stats_end(STAGE_CONVERT, start);
+
+   start = stats_begin();
+   for (channel = 0; channel < engine->num_channels; channel++)
+      if (engine->taps == 1)
+         engine->resample(
+            planes[channel], dest_buf + (size_t) channel * size,
+            engine->read_index, engine->window, engine->part,
+            engine->num_channels);
+      else {
+         engine->interpolate(planes[channel], interpolated,
+            engine->read_index, engine->phase, engine->coef, engine->part);
+         engine->resample(
+            interpolated, dest_buf + (size_t) channel * size,
+            engine->in_order, engine->window, engine->part,
+            engine->num_channels);
+      }
+   stats_end(STAGE_PROCESS, start);
+   stats_count(COUNT_GRAINS, 1);
+}
+
+/*
+ * run_grain_engine: This function reads a batch of grains at once,
+ * lets the worker pool process them in parallel, and writes the
+ * batch back in the original order. The result is identical to
+ * processing the grains one by one. It returns the number of
+ * grains processed. total_unit = UINT32_MAX means "until the end
+ * of the input."
+ */
+static uint32_t run_grain_engine(
+   struct audio_io *io,
+   struct grain_engine *engine,
+   uint32_t total_unit,
+   int batch_unit,
+   struct worker_pool *pool,
+   bool show_progress
+) {
+   int total_uint_digit = count_digit(total_unit);
+
+   size_t count;
+   int grain_count;
+   uint32_t unit;
+   struct grain_batch batch;
+
+   batch.engine = engine;
+
+   for (unit = 0; unit < total_unit && !is_io_cancelled(io);
+        unit += grain_count) {
+      grain_count = batch_unit;
+      if (total_unit - unit < (uint32_t) grain_count)
+         grain_count = total_unit - unit;
+
+      /* Only complete grains are processed, as a partial one is dropped. */
+      count = (size_t) grain_count * engine->src_len;
+      batch.src_buf = io->read(io, &count);
+      grain_count = count / engine->src_len;
+      if (grain_count == 0) break;
+
+      count = (size_t) grain_count * engine->dest_len;
+      batch.dest_buf = io->reserve(io, count);
+      run_worker_pool(pool, process_grain, &batch, grain_count);
+      io->commit(io, count);
+
+      if (show_progress)
+         print_progress_bar(unit + grain_count, total_unit, total_uint_digit);
+   }
+
+   return unit;
 }
 
-static uint32_t shift_pitch(
+/*
+ * run_realtime: This function streams the audio data block by block
+ * through a libpitsh processor, writing every block as soon as it
+ * has been processed, which is what a live chain needs. The output
+ * is delayed by the latency of the processor, so the input is
+ * followed by as much silence for its end to come out. It returns
+ * the number of frames written.
+ */
+static uint32_t run_realtime(
    FILE *src,
    FILE *dest,
    struct wav_info *info,
    struct execution_options *options,
    bool is_le
 ) {
-   int grain_size = options->size;
-   double pitch_factor = options->factor;
+   int block = options->realtime_block;
    uint16_t num_channels = info->num_channels;
-   uint32_t total_sample = info->subchunk_2_size
-                           / (num_channels * (info->bits_per_sample / 8));
-   uint32_t total_unit = total_sample / grain_size;
-   int src_buf_len = grain_size * num_channels;
-   int dest_buf_len = src_buf_len;
-   int total_uint_digit = count_digit(total_unit);
+   size_t frame_size = (size_t) num_channels * 2;
+   uint32_t total_frame = info->subchunk_2_size / frame_size;
+   bool is_endless = info->subchunk_2_size == WAV_UNKNOWN_SIZE;
 
    int result;
-   int i;
-   double j;
-   int channel;
-   uint32_t unit;
-   int16_t *src_buf, *dest_buf;
+   size_t i, count, latency, tail;
+   uint32_t frame = 0, written = 0;
+   int16_t *in_buf, *out_buf;
+   struct realtime rt = {NULL, NULL, NULL};
+   struct pitsh_config config;
+
+   if (info->sample_format != SAMPLE_INT16)
+      raise_err("%s: The real-time mode needs 16-bit samples.", __func__);
+   config.mode = PITSH_MODE_PITCH;
+   config.factor = options->factor;
+   config.grain_size = options->size;
+   config.num_channels = num_channels;
+   config.window = options->window_shape;
+   config.window_ratio = options->window_ratio;
+   push_err_cleanup(release_realtime, &rt);
+   result = pitsh_create(&rt.processor);
+   if (result == PITSH_OK)
+      result = pitsh_configure(rt.processor, &config);
+   if (result != PITSH_OK)
+      raise_err("%s: %s", __func__, pitsh_strerror(result));
+   latency = pitsh_latency(rt.processor);
+   if (options->verbose)
+      printf("Real-time mode: %d frames per block, latency %zu frames.\n",
+         block, latency);
 
-   result = fseek(dest, 44L, SEEK_SET);
-   if (result != 0)
-      raise_err("%s: Failed to seek the file position.", __func__);
-   src_buf = malloc(src_buf_len * 2);
-   if (src_buf == NULL)
+   in_buf = rt.in_buf = malloc(frame_size * block);
+   if (in_buf == NULL)
       raise_err("%s: Failed to allocate memory dynamically.", __func__);
-   dest_buf = malloc(dest_buf_len * 2);
-   if (dest_buf == NULL)
+   out_buf = rt.out_buf = malloc(frame_size * block);
+   if (out_buf == NULL)
       raise_err("%s: Failed to allocate memory dynamically.", __func__);
 
-   for (unit = 0; unit < total_unit; unit++) {
-      result = fread(src_buf, 2, src_buf_len, src);
-      if (result != src_buf_len) break;
-
-      for (channel = 0; channel < num_channels; channel++)
-         for (i = 0, j = 0; i < grain_size; i++, j += pitch_factor) {
-            if (j >= grain_size)
-               j = 0;
-            dest_buf[num_channels * i + channel]
-               = src_buf[num_channels * (int) j + channel]
-                 * window(i, grain_size);
-         }
+   fit_wav_header(info,
+      is_endless ? WAV_UNKNOWN_SIZE : (uint64_t) (total_frame + latency) * frame_size,
+      options->stream_dest);
+   write_wav_header_ahead(dest, info,
+      is_endless ? UINT32_MAX : total_frame + latency, is_le);
+
+   tail = latency;
+   for (;;) {
+      count = block;
+      if (!is_endless && total_frame - frame < count)
+         count = total_frame - frame;
+      if (count > 0)
+         count = fread(in_buf, frame_size, count, src);
+      if (count == 0) {
+         /* The end of the input: push silence until all of it is out. */
+         if (ferror(src))
+            raise_err("%s: Failed to read audio data.", __func__);
+         if (tail == 0)
+            break;
+         count = tail < (size_t) block ? tail : (size_t) block;
+         memset(in_buf, 0, frame_size * count);
+         tail -= count;
+      }
+      else
+         frame += count;
+
       if (!is_le)
-            for (i = 0; i < dest_buf_len; i++)
-               endrev16(&dest_buf[i]);
+         for (i = 0; i < count * num_channels; i++)
+            endrev16((uint16_t *) &in_buf[i]);
+      pitsh_process_block(rt.processor, in_buf, out_buf, count);
+      if (!is_le)
+         for (i = 0; i < count * num_channels; i++)
+            endrev16((uint16_t *) &out_buf[i]);
 
-      result = fwrite(dest_buf, 2, dest_buf_len, dest);
-      if (result != dest_buf_len)
+      if (fwrite(out_buf, frame_size, count, dest) != count)
          raise_err("%s: Failed to write data.", __func__);
-
-      print_progress_bar(unit + 1, total_unit, total_uint_digit);
+      if (options->stream_dest)
+         fflush(dest);
+      written += count;
    }
-   if (ferror(src))
-      raise_err("%s: Failed to read audio data.", __func__);
 
-   free(src_buf);
-   free(dest_buf);
+   pop_err_cleanup(&rt);
+   release_realtime(&rt);
 
-   /* the number of total samples. */
-   return unit * grain_size;
+   return written;
 }
 
-static uint32_t stretch_time(
+/* Note: This is also the cleanup of run_realtime() if the file fails. */
+static void release_realtime(void *arg) {
+   struct realtime *rt = arg;
+
+   free(rt->in_buf);
+   free(rt->out_buf);
+   pitsh_destroy(rt->processor);
+}
+
+/*
+ * run_wsola: This function changes the speed of the audio data by
+ * the WSOLA engine. Each frame depends on where the previous one was
+ * taken from, so the work is not shared among the workers. It
+ * returns the number of frames written.
+ */
+static uint32_t run_wsola(
    FILE *src,
    FILE *dest,
    struct wav_info *info,
    struct execution_options *options,
+   struct processing_context *context,
    bool is_le
 ) {
-   int grain_size = options->size;
-   double speed_factor = options->factor;
-   int part = grain_size / speed_factor;
    uint16_t num_channels = info->num_channels;
-   uint32_t total_sample = info->subchunk_2_size
-                           / (num_channels * (info->bits_per_sample / 8));
-   uint32_t total_unit = total_sample / grain_size;
-   int src_buf_len = grain_size * num_channels;
-   int dest_buf_len = part * num_channels;
-   int total_uint_digit = count_digit(total_unit);
+   size_t frame_size = (size_t) num_channels * sample_size(info->sample_format);
+   uint32_t total_frame = info->subchunk_2_size / frame_size;
+   uint32_t out_frame;
+   uint32_t sample_number;
+   struct audio_io *io;
 
-   int result;
-   int i, j;
-   int channel;
-   uint32_t unit;
-   int16_t *src_buf, *dest_buf;
+   if (info->subchunk_2_size == WAV_UNKNOWN_SIZE)
+      total_frame = UINT32_MAX;
+   out_frame = total_frame == UINT32_MAX
+               ? UINT32_MAX : wsola_frame_number(total_frame, options->factor);
+   if (options->verbose)
+      printf("Engine: wsola, frame length %d.\n", options->size);
 
-   result = fseek(dest, 44L, SEEK_SET);
-   if (result != 0)
-      raise_err("%s: Failed to seek the file position.", __func__);
-   src_buf = malloc(src_buf_len * 2);
-   if (src_buf == NULL)
-      raise_err("%s: Failed to allocate memory dynamically.", __func__);
-   dest_buf = malloc(dest_buf_len * 2);
-   if (dest_buf == NULL)
+   fit_wav_header(info,
+      out_frame == UINT32_MAX ? WAV_UNKNOWN_SIZE : (uint64_t) out_frame * frame_size,
+      options->stream_dest);
+   write_wav_header_ahead(dest, info, out_frame, is_le);
+   io = realize_audio_io(
+      src, dest, options->io_backend, info,
+      out_frame == UINT32_MAX ? 0 : (uint64_t) out_frame * frame_size,
+      (size_t) WSOLA_READ_FRAMES * num_channels,
+      (size_t) options->size * num_channels,
+      context->buffers,
+      options->read_ahead,
+      options->direct_io,
+      context->cancel,
+      options->stream_dest);
+
+   sample_number = stretch_wsola(
+      io, num_channels, total_frame, options->size, options->factor,
+      info->sample_format,
+      options->show_progress && total_frame != UINT32_MAX);
+   context->is_cut_short = io->is_cut_short;
+   io->unrealize(io->self);
+
+   return sample_number;
+}
+
+/*
+ * run_vocoder: This function changes the pitch or the speed of the
+ * audio data by the phase vocoder. Like WSOLA, each frame depends on
+ * the previous one, so the frames are processed in order, but the
+ * channels of each frame go to the workers. It returns the number
+ * of frames written.
+ */
+static uint32_t run_vocoder(
+   FILE *src,
+   FILE *dest,
+   struct wav_info *info,
+   struct execution_options *options,
+   struct processing_context *context,
+   bool is_le
+) {
+   uint16_t num_channels = info->num_channels;
+   size_t frame_size = (size_t) num_channels * sample_size(info->sample_format);
+   uint32_t total_frame = info->subchunk_2_size / frame_size;
+   uint32_t out_frame;
+   uint32_t sample_number;
+   const struct fft_plan *plan;
+   struct audio_io *io;
+
+   plan = lookup_fft_plan(context->plans, vocoder_frame_size(options->size));
+   if (plan == NULL)
       raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   if (info->subchunk_2_size == WAV_UNKNOWN_SIZE)
+      total_frame = UINT32_MAX;
+   out_frame = total_frame == UINT32_MAX
+               ? UINT32_MAX
+               : vocoder_frame_number(options->mode, total_frame, options->factor);
+   if (options->verbose)
+      printf("Engine: vocoder, FFT size %d.\n", plan->size);
 
-   for (unit = 0; unit < total_unit; unit++) {
-      result = fread(src_buf, 2, src_buf_len, src);
-      if (result !=  src_buf_len) break;
-
-      for (channel = 0; channel < num_channels; channel++)
-         for (i = 0, j = 0; i < part; i++, j++) {
-            if (j == grain_size)
-               j = 0;
-            dest_buf[num_channels * i + channel]
-               = src_buf[num_channels * j + channel]
-                 * window(i, part);
-         }
-      if (!is_le)
-         for (i = 0; i < dest_buf_len; i++)
-            endrev16(&dest_buf[i]);
+   fit_wav_header(info,
+      out_frame == UINT32_MAX ? WAV_UNKNOWN_SIZE : (uint64_t) out_frame * frame_size,
+      options->stream_dest);
+   write_wav_header_ahead(dest, info, out_frame, is_le);
+   io = realize_audio_io(
+      src, dest, options->io_backend, info,
+      out_frame == UINT32_MAX ? 0 : (uint64_t) out_frame * frame_size,
+      (size_t) VOCODER_READ_FRAMES * num_channels,
+      (size_t) plan->size * num_channels,
+      context->buffers,
+      options->read_ahead,
+      options->direct_io,
+      context->cancel,
+      options->stream_dest);
 
-      result = fwrite(dest_buf, 2, dest_buf_len, dest);
-      if (result != dest_buf_len)
-         raise_err("%s: Failed to write data.", __func__);
+   sample_number = vocode(
+      io, context->pool, plan, options->mode, num_channels, total_frame, options->factor,
+      info->sample_format,
+      options->show_progress && total_frame != UINT32_MAX);
+   context->is_cut_short = io->is_cut_short;
+   io->unrealize(io->self);
 
-      print_progress_bar(unit + 1, total_unit, total_uint_digit);
-   }
-   if (ferror(src))
-      raise_err("%s: Failed to read audio data.", __func__);
+   return sample_number;
+}
 
-   free(src_buf);
-   free(dest_buf);
+/*
+ * run_overlap_add: This function changes the pitch or the speed of
+ * the audio data by overlapping grains, each crossfaded into the
+ * next. The grains overlap, so they are summed in order on one
+ * thread per file. It returns the number of frames written.
+ */
+static uint32_t run_overlap_add(
+   FILE *src,
+   FILE *dest,
+   struct wav_info *info,
+   struct execution_options *options,
+   struct processing_context *context,
+   bool is_le
+) {
+   uint16_t num_channels = info->num_channels;
+   size_t frame_size = (size_t) num_channels * sample_size(info->sample_format);
+   uint32_t total_frame = info->subchunk_2_size / frame_size;
+   uint32_t out_frame;
+   uint32_t sample_number;
+   const float *coef;
+   struct audio_io *io;
 
-   /* the number of total samples. */
-   return unit * part;
+   coef = lookup_interp_table(context->windows, options->interp,
+      options->factor > 1 ? 1 / options->factor : 1);
+   if (coef == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   if (info->subchunk_2_size == WAV_UNKNOWN_SIZE)
+      total_frame = UINT32_MAX;
+   out_frame = total_frame == UINT32_MAX
+               ? UINT32_MAX
+               : ola_frame_number(options->mode, total_frame, options->factor);
+   if (options->verbose)
+      printf("Engine: grain, %d%% overlap.\n", options->overlap);
+
+   fit_wav_header(info,
+      out_frame == UINT32_MAX ? WAV_UNKNOWN_SIZE : (uint64_t) out_frame * frame_size,
+      options->stream_dest);
+   write_wav_header_ahead(dest, info, out_frame, is_le);
+   io = realize_audio_io(
+      src, dest, options->io_backend, info,
+      out_frame == UINT32_MAX ? 0 : (uint64_t) out_frame * frame_size,
+      (size_t) OLA_READ_FRAMES * num_channels,
+      (size_t) options->size * num_channels,
+      context->buffers,
+      options->read_ahead,
+      options->direct_io,
+      context->cancel,
+      options->stream_dest);
+
+   sample_number = overlap_add(
+      io, options->mode, num_channels, total_frame, options->size,
+      options->overlap, options->factor, options->interp, coef,
+      info->sample_format,
+      options->show_progress && total_frame != UINT32_MAX);
+   context->is_cut_short = io->is_cut_short;
+   io->unrealize(io->self);
+
+   return sample_number;
 }
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include <stdint.h>
+#include "resample_kernel.h"
+
+#if !defined(PITSH_NO_SIMD) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#elif !defined(PITSH_NO_SIMD) && defined(__aarch64__)
+#define HAVE_NEON_KERNEL
+#include <arm_neon.h>
+#endif
+
+void resample_scalar(
+   const int16_t *src,
+   int16_t *dest,
+   const int *read_index,
+   const double *window,
+   int len,
+   int num_channels
+) {
+   int i;
+   int channel;
+
+   for (channel = 0; channel < num_channels; channel++)
+      for (i = 0; i < len; i++)
+         dest[num_channels * i + channel]
+            = src[num_channels * read_index[i] + channel] * window[i];
+}
+
+/*
+ * Note: store_lanes() puts n converted samples of one channel
+ * back into the interleaved destination.
+ */
+inline static void store_lanes(
+   int16_t *dest,
+   const int16_t *lanes,
+   int n,
+   int num_channels
+) {
+   int k;
+
+   for (k = 0; k < n; k++)
+      dest[num_channels * k] = lanes[k];
+}
+
+#ifdef HAVE_X86_KERNELS
+
+__attribute__((target("avx2")))
+static void resample_avx2(
+   const int16_t *src,
+   int16_t *dest,
+   const int *read_index,
+   const double *window,
+   int len,
+   int num_channels
+) {
+   int src_len;
+   int last = 0;
+   int i, k;
+   int channel;
+   int16_t lanes[8];
+   __m256i offset, sample;
+   __m128i packed;
+
+   /*
+    * A 32-bit gather reads one sample past the requested one, so a
+    * block touching the very last sample of the grain goes scalar.
+    */
+   for (i = 0; i < len; i++)
+      if (read_index[i] > last)
+         last = read_index[i];
+   src_len = num_channels * (last + 1);
+
+   for (channel = 0; channel < num_channels; channel++) {
+      for (i = 0; i + 8 <= len; i += 8) {
+         offset = _mm256_add_epi32(
+            _mm256_mullo_epi32(
+               _mm256_loadu_si256((const __m256i *) (read_index + i)),
+               _mm256_set1_epi32(num_channels)),
+            _mm256_set1_epi32(channel));
+         if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(
+                offset, _mm256_set1_epi32(src_len - 1))) != 0) {
+            for (k = i; k < i + 8; k++)
+               dest[num_channels * k + channel]
+                  = src[num_channels * read_index[k] + channel]
+                    * window[k];
+            continue;
+         }
+         sample = _mm256_i32gather_epi32((const int *) src, offset, 2);
+         sample = _mm256_srai_epi32(_mm256_slli_epi32(sample, 16), 16);
+         packed = _mm_packs_epi32(
+            _mm256_cvttpd_epi32(_mm256_mul_pd(
+               _mm256_cvtepi32_pd(_mm256_castsi256_si128(sample)),
+               _mm256_loadu_pd(window + i))),
+            _mm256_cvttpd_epi32(_mm256_mul_pd(
+               _mm256_cvtepi32_pd(_mm256_extracti128_si256(sample, 1)),
+               _mm256_loadu_pd(window + i + 4))));
+         if (num_channels == 1)
+            _mm_storeu_si128((__m128i *) (dest + i), packed);
+         else {
+            _mm_storeu_si128((__m128i *) lanes, packed);
+            store_lanes(dest + num_channels * i + channel,
+               lanes, 8, num_channels);
+         }
+      }
+      for (; i < len; i++)
+         dest[num_channels * i + channel]
+            = src[num_channels * read_index[i] + channel] * window[i];
+   }
+}
+
+__attribute__((target("sse4.1")))
+static void resample_sse41(
+   const int16_t *src,
+   int16_t *dest,
+   const int *read_index,
+   const double *window,
+   int len,
+   int num_channels
+) {
+   int i;
+   int channel;
+   int16_t lanes[8];
+   const int16_t *s;
+   __m128i sample, packed;
+
+   for (channel = 0; channel < num_channels; channel++) {
+      s = src + channel;
+      for (i = 0; i + 4 <= len; i += 4) {
+         sample = _mm_set_epi32(
+            s[num_channels * read_index[i + 3]],
+            s[num_channels * read_index[i + 2]],
+            s[num_channels * read_index[i + 1]],
+            s[num_channels * read_index[i]]);
+         packed = _mm_packs_epi32(
+            _mm_unpacklo_epi64(
+               _mm_cvttpd_epi32(_mm_mul_pd(
+                  _mm_cvtepi32_pd(sample), _mm_loadu_pd(window + i))),
+               _mm_cvttpd_epi32(_mm_mul_pd(
+                  _mm_cvtepi32_pd(_mm_srli_si128(sample, 8)),
+                  _mm_loadu_pd(window + i + 2)))),
+            _mm_setzero_si128());
+         if (num_channels == 1)
+            _mm_storel_epi64((__m128i *) (dest + i), packed);
+         else {
+            _mm_storeu_si128((__m128i *) lanes, packed);
+            store_lanes(dest + num_channels * i + channel,
+               lanes, 4, num_channels);
+         }
+      }
+      for (; i < len; i++)
+         dest[num_channels * i + channel]
+            = s[num_channels * read_index[i]] * window[i];
+   }
+}
+
+#endif
+
+#ifdef HAVE_NEON_KERNEL
+
+static void resample_neon(
+   const int16_t *src,
+   int16_t *dest,
+   const int *read_index,
+   const double *window,
+   int len,
+   int num_channels
+) {
+   int i;
+   int channel;
+   int32_t gathered[4];
+   int16_t lanes[4];
+   const int16_t *s;
+   int32x4_t sample;
+   int64x2_t lo, hi;
+
+   for (channel = 0; channel < num_channels; channel++) {
+      s = src + channel;
+      for (i = 0; i + 4 <= len; i += 4) {
+         gathered[0] = s[num_channels * read_index[i]];
+         gathered[1] = s[num_channels * read_index[i + 1]];
+         gathered[2] = s[num_channels * read_index[i + 2]];
+         gathered[3] = s[num_channels * read_index[i + 3]];
+         sample = vld1q_s32(gathered);
+         lo = vcvtq_s64_f64(vmulq_f64(
+            vcvtq_f64_s64(vmovl_s32(vget_low_s32(sample))),
+            vld1q_f64(window + i)));
+         hi = vcvtq_s64_f64(vmulq_f64(
+            vcvtq_f64_s64(vmovl_s32(vget_high_s32(sample))),
+            vld1q_f64(window + i + 2)));
+         vst1_s16(lanes, vqmovn_s32(
+            vcombine_s32(vqmovn_s64(lo), vqmovn_s64(hi))));
+         store_lanes(dest + num_channels * i + channel,
+            lanes, 4, num_channels);
+      }
+      for (; i < len; i++)
+         dest[num_channels * i + channel]
+            = s[num_channels * read_index[i]] * window[i];
+   }
+}
+
+#endif
+
+void (*select_resample_kernel(void))(
+   const int16_t *, int16_t *, const int *, const double *, int, int
+) {
+#ifdef HAVE_X86_KERNELS
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2"))
+      return resample_avx2;
+   if (__builtin_cpu_supports("sse4.1"))
+      return resample_sse41;
+#endif
+#ifdef HAVE_NEON_KERNEL
+   return resample_neon;
+#endif
+   return resample_scalar;
+}
+
+const char *resample_kernel_name(void) {
+   void (*kernel)(const int16_t *, int16_t *, const int *, const double *, int, int)
+      = select_resample_kernel();
+
+#ifdef HAVE_X86_KERNELS
+   if (kernel == resample_avx2)
+      return "avx2";
+   if (kernel == resample_sse41)
+      return "sse4.1";
+#endif
+#ifdef HAVE_NEON_KERNEL
+   if (kernel == resample_neon)
+      return "neon";
+#endif
+   return kernel == resample_scalar ? "scalar" : "unknown";
+}
\ No newline at end of file
@@ -0,0 +1,567 @@
+#include <stddef.h>
+#include <stdbool.h>
+#include "sample_format.h"
+
+#if !defined(PITSH_NO_SIMD) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#elif !defined(PITSH_NO_SIMD) && defined(__aarch64__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define HAVE_NEON_KERNEL
+#include <arm_neon.h>
+#endif
+
+extern float load_sample(int, const unsigned char *);
+extern void store_sample(int, unsigned char *, float);
+
+#ifdef HAVE_X86_KERNELS
+static void resample_int16_avx2(
+   const float *, void *, const int *, const double *, int, int);
+static void resample_int16_sse41(
+   const float *, void *, const int *, const double *, int, int);
+static void deinterleave_int16_avx2(
+   const unsigned char *, float *const *, size_t, size_t, int);
+static void deinterleave_int24_ssse3(
+   const unsigned char *, float *const *, size_t, size_t, int);
+static void interleave_int16_avx2(
+   float *const *, size_t, unsigned char *, size_t, int);
+#endif
+#ifdef HAVE_NEON_KERNEL
+static void resample_int16_neon(
+   const float *, void *, const int *, const double *, int, int);
+#endif
+
+/*
+ * Note: The conversions are the same loops for every format; only
+ * how a sample is loaded and stored differs, so each loop is written
+ * once as a macro and expanded per format. With the format constant
+ * in each expansion, the switch of load_sample() and store_sample()
+ * folds away and no dispatch is left per sample.
+ */
+#define DEFINE_DEINTERLEAVE(name, format, size) \
+   static void name( \
+      const unsigned char *src, \
+      float *const *planes, \
+      size_t first, \
+      size_t count, \
+      int num_channels \
+   ) { \
+      size_t i; \
+      int channel; \
+   \
+      for (i = 0; i < count; i++) \
+         for (channel = 0; channel < num_channels; channel++) \
+            planes[channel][first + i] = load_sample(format, \
+               src + (size) * ((size_t) num_channels * i + channel)); \
+   }
+
+#define DEFINE_INTERLEAVE(name, format, size) \
+   static void name( \
+      float *const *planes, \
+      size_t first, \
+      unsigned char *dest, \
+      size_t count, \
+      int num_channels \
+   ) { \
+      size_t i; \
+      int channel; \
+   \
+      for (i = 0; i < count; i++) \
+         for (channel = 0; channel < num_channels; channel++) \
+            store_sample(format, \
+               dest + (size) * ((size_t) num_channels * i + channel), \
+               planes[channel][first + i]); \
+   }
+
+/*
+ * Note: STORE takes the product in double, so that a 16-bit or
+ * 24-bit sample is truncated exactly as its integer would be.
+ */
+#define DEFINE_PLANAR_KERNEL(name, size, STORE) \
+   static void name( \
+      const float *plane, \
+      void *dest, \
+      const int *read_index, \
+      const double *window, \
+      int len, \
+      int num_channels \
+   ) { \
+      unsigned char *out = dest; \
+      size_t stride = (size_t) (size) * num_channels; \
+      int i; \
+   \
+      for (i = 0; i < len; i++) \
+         STORE(out + stride * i, plane[read_index[i]] * window[i]); \
+   }
+
+static inline void truncate_int16(unsigned char *p, double value) {
+   int32_t integer;
+
+   value *= 32768.0;
+   if (value > INT16_MAX) value = INT16_MAX;
+   if (value < INT16_MIN) value = INT16_MIN;
+   integer = (int32_t) value;
+   p[0] = integer;
+   p[1] = integer >> 8;
+}
+
+static inline void truncate_int24(unsigned char *p, double value) {
+   int32_t integer;
+
+   value *= 8388608.0;
+   if (value > 8388607) value = 8388607;
+   if (value < -8388608) value = -8388608;
+   integer = (int32_t) value;
+   p[0] = integer;
+   p[1] = integer >> 8;
+   p[2] = integer >> 16;
+}
+
+static inline void truncate_int32(unsigned char *p, double value) {
+   uint32_t bits;
+
+   value *= 2147483648.0;
+   if (value > INT32_MAX) value = INT32_MAX;
+   if (value < INT32_MIN) value = INT32_MIN;
+   bits = (uint32_t) (int32_t) value;
+   p[0] = bits;
+   p[1] = bits >> 8;
+   p[2] = bits >> 16;
+   p[3] = bits >> 24;
+}
+
+static inline void narrow_float32(unsigned char *p, double value) {
+   store_sample(SAMPLE_FLOAT32, p, value);
+}
+
+DEFINE_DEINTERLEAVE(deinterleave_int16, SAMPLE_INT16, 2)
+DEFINE_DEINTERLEAVE(deinterleave_int24, SAMPLE_INT24, 3)
+DEFINE_DEINTERLEAVE(deinterleave_int32, SAMPLE_INT32, 4)
+DEFINE_DEINTERLEAVE(deinterleave_float32, SAMPLE_FLOAT32, 4)
+
+DEFINE_INTERLEAVE(interleave_int16, SAMPLE_INT16, 2)
+DEFINE_INTERLEAVE(interleave_int24, SAMPLE_INT24, 3)
+DEFINE_INTERLEAVE(interleave_int32, SAMPLE_INT32, 4)
+DEFINE_INTERLEAVE(interleave_float32, SAMPLE_FLOAT32, 4)
+
+DEFINE_PLANAR_KERNEL(resample_int16, 2, truncate_int16)
+DEFINE_PLANAR_KERNEL(resample_int24, 3, truncate_int24)
+DEFINE_PLANAR_KERNEL(resample_int32, 4, truncate_int32)
+DEFINE_PLANAR_KERNEL(resample_float32, 4, narrow_float32)
+
+int sample_size(int format) {
+   switch (format) {
+      case SAMPLE_INT16:
+         return 2;
+      case SAMPLE_INT24:
+         return 3;
+      default:
+         return 4;
+   }
+}
+
+const char *sample_format_name(int format) {
+   switch (format) {
+      case SAMPLE_INT16:
+         return "int16";
+      case SAMPLE_INT24:
+         return "int24";
+      case SAMPLE_INT32:
+         return "int32";
+      default:
+         return "float32";
+   }
+}
+
+void deinterleave_samples(
+   int format,
+   const void *src,
+   float *const *planes,
+   size_t first,
+   size_t count,
+   int num_channels
+) {
+#ifdef HAVE_X86_KERNELS
+   if (num_channels <= 2) {
+      if (format == SAMPLE_INT16 && __builtin_cpu_supports("avx2")) {
+         deinterleave_int16_avx2(src, planes, first, count, num_channels);
+         return;
+      }
+      if (format == SAMPLE_INT24 && __builtin_cpu_supports("ssse3")) {
+         deinterleave_int24_ssse3(src, planes, first, count, num_channels);
+         return;
+      }
+   }
+#endif
+   switch (format) {
+      case SAMPLE_INT16:
+         deinterleave_int16(src, planes, first, count, num_channels);
+      break;
+      case SAMPLE_INT24:
+         deinterleave_int24(src, planes, first, count, num_channels);
+      break;
+      case SAMPLE_INT32:
+         deinterleave_int32(src, planes, first, count, num_channels);
+      break;
+      default:
+         deinterleave_float32(src, planes, first, count, num_channels);
+   }
+}
+
+void interleave_samples(
+   int format,
+   float *const *planes,
+   size_t first,
+   void *dest,
+   size_t count,
+   int num_channels
+) {
+#ifdef HAVE_X86_KERNELS
+   if (format == SAMPLE_INT16 && num_channels <= 2
+       && __builtin_cpu_supports("avx2")) {
+      interleave_int16_avx2(planes, first, dest, count, num_channels);
+      return;
+   }
+#endif
+   switch (format) {
+      case SAMPLE_INT16:
+         interleave_int16(planes, first, dest, count, num_channels);
+      break;
+      case SAMPLE_INT24:
+         interleave_int24(planes, first, dest, count, num_channels);
+      break;
+      case SAMPLE_INT32:
+         interleave_int32(planes, first, dest, count, num_channels);
+      break;
+      default:
+         interleave_float32(planes, first, dest, count, num_channels);
+   }
+}
+
+void (*select_planar_kernel(int format))(
+   const float *, void *, const int *, const double *, int, int) {
+#ifdef HAVE_X86_KERNELS
+   __builtin_cpu_init();
+   if (format == SAMPLE_INT16 && __builtin_cpu_supports("avx2"))
+      return resample_int16_avx2;
+   if (format == SAMPLE_INT16 && __builtin_cpu_supports("sse4.1"))
+      return resample_int16_sse41;
+#endif
+#ifdef HAVE_NEON_KERNEL
+   if (format == SAMPLE_INT16)
+      return resample_int16_neon;
+#endif
+   switch (format) {
+      case SAMPLE_INT16:
+         return resample_int16;
+      case SAMPLE_INT24:
+         return resample_int24;
+      case SAMPLE_INT32:
+         return resample_int32;
+      default:
+         return resample_float32;
+   }
+}
+
+const char *planar_kernel_name(int format) {
+   void (*kernel)(const float *, void *, const int *, const double *, int, int)
+      = select_planar_kernel(format);
+
+#ifdef HAVE_X86_KERNELS
+   if (kernel == resample_int16_avx2)
+      return "avx2";
+   if (kernel == resample_int16_sse41)
+      return "sse4.1";
+#endif
+#ifdef HAVE_NEON_KERNEL
+   if (kernel == resample_int16_neon)
+      return "neon";
+#endif
+   return "scalar";
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/*
+ * Note: The x86 kernels cover 16-bit and 24-bit samples of one or
+ * two channels, by far the most common; the rest go through the
+ * scalar ones. The file and the host are both little-endian here,
+ * so the byte shuffles only move whole samples: they split the
+ * channels apart and, for 24-bit samples, spread three bytes over
+ * four. The results are exactly those of the scalar kernels.
+ */
+__attribute__((target("avx2")))
+static void deinterleave_int16_avx2(
+   const unsigned char *src,
+   float *const *planes,
+   size_t first,
+   size_t count,
+   int num_channels
+) {
+   /* per 128-bit lane: the left samples, then the right ones */
+   const __m256i split = _mm256_setr_epi8(
+      0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15,
+      0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+   const __m256 scale = _mm256_set1_ps(1 / 32768.0f);
+   size_t i = 0;
+   int channel;
+   __m256i frames;
+
+   if (num_channels == 1)
+      for (; i + 8 <= count; i += 8)
+         _mm256_storeu_ps(planes[0] + first + i, _mm256_mul_ps(
+            _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+               _mm_loadu_si128((const __m128i *) (src + 2 * i)))),
+            scale));
+   else
+      for (; i + 8 <= count; i += 8) {
+         frames = _mm256_shuffle_epi8(
+            _mm256_loadu_si256((const __m256i *) (src + 4 * i)), split);
+         /* 64-bit blocks L0-3 R0-3 L4-7 R4-7 to L0-7 R0-7 */
+         frames = _mm256_permute4x64_epi64(frames, 0xD8);
+         _mm256_storeu_ps(planes[0] + first + i, _mm256_mul_ps(
+            _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+               _mm256_castsi256_si128(frames))),
+            scale));
+         _mm256_storeu_ps(planes[1] + first + i, _mm256_mul_ps(
+            _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+               _mm256_extracti128_si256(frames, 1))),
+            scale));
+      }
+   for (; i < count; i++)
+      for (channel = 0; channel < num_channels; channel++)
+         planes[channel][first + i] = load_sample(SAMPLE_INT16,
+            src + 2 * ((size_t) num_channels * i + channel));
+}
+
+/*
+ * Note: A load takes 16 bytes, of which four 24-bit samples fill
+ * 12, so the last samples are left to the scalar loop lest the load
+ * run past the end of src.
+ */
+__attribute__((target("ssse3")))
+static void deinterleave_int24_ssse3(
+   const unsigned char *src,
+   float *const *planes,
+   size_t first,
+   size_t count,
+   int num_channels
+) {
+   /* four samples into the upper three bytes of 32 bits each */
+   const __m128i spread = _mm_setr_epi8(
+      -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+   /* L0 R0 L1 R1 into L0 L1 R0 R1 */
+   const __m128i split = _mm_setr_epi8(
+      -1, 0, 1, 2, -1, 6, 7, 8, -1, 3, 4, 5, -1, 9, 10, 11);
+   const __m128 scale = _mm_set1_ps(1 / 2147483648.0f);
+   size_t i = 0, samples = count * num_channels;
+   int channel;
+   __m128 values;
+
+   if (num_channels == 1)
+      for (; i + 6 <= samples; i += 4)
+         _mm_storeu_ps(planes[0] + first + i, _mm_mul_ps(
+            _mm_cvtepi32_ps(_mm_shuffle_epi8(
+               _mm_loadu_si128((const __m128i *) (src + 3 * i)), spread)),
+            scale));
+   else
+      for (; 2 * i + 6 <= samples; i += 2) {
+         values = _mm_mul_ps(
+            _mm_cvtepi32_ps(_mm_shuffle_epi8(
+               _mm_loadu_si128((const __m128i *) (src + 6 * i)), split)),
+            scale);
+         _mm_storel_pi((__m64 *) (planes[0] + first + i), values);
+         _mm_storeh_pi((__m64 *) (planes[1] + first + i), values);
+      }
+   for (; i < count; i++)
+      for (channel = 0; channel < num_channels; channel++)
+         planes[channel][first + i] = load_sample(SAMPLE_INT24,
+            src + 3 * ((size_t) num_channels * i + channel));
+}
+
+/*
+ * Note: The samples are rounded as by store_sample(), the product
+ * and the sum taken in float, and saturated by the packing.
+ */
+__attribute__((target("avx2")))
+static void interleave_int16_avx2(
+   float *const *planes,
+   size_t first,
+   unsigned char *dest,
+   size_t count,
+   int num_channels
+) {
+   /* per 128-bit lane: L0-3 R0-3 to L0 R0 L1 R1 ... */
+   const __m256i merge = _mm256_setr_epi8(
+      0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15,
+      0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15);
+   const __m256 scale = _mm256_set1_ps(32768.0f);
+   const __m256 half = _mm256_set1_ps(0.5f);
+   const float *left = planes[0] + first;
+   const float *right = planes[num_channels - 1] + first;
+   size_t i = 0;
+   int channel;
+   __m256i low, high;
+
+#define ROUND_INT16(p) _mm256_cvtps_epi32(_mm256_floor_ps(_mm256_add_ps( \
+           _mm256_mul_ps(_mm256_loadu_ps(p), scale), half)))
+   if (num_channels == 1)
+      for (; i + 16 <= count; i += 16) {
+         low = ROUND_INT16(left + i);
+         high = ROUND_INT16(left + i + 8);
+         _mm256_storeu_si256((__m256i *) (dest + 2 * i),
+            _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xD8));
+      }
+   else
+      for (; i + 8 <= count; i += 8) {
+         low = ROUND_INT16(left + i);
+         high = ROUND_INT16(right + i);
+         _mm256_storeu_si256((__m256i *) (dest + 4 * i),
+            _mm256_shuffle_epi8(_mm256_packs_epi32(low, high), merge));
+      }
+#undef ROUND_INT16
+   for (; i < count; i++)
+      for (channel = 0; channel < num_channels; channel++)
+         store_sample(SAMPLE_INT16,
+            dest + 2 * ((size_t) num_channels * i + channel),
+            planes[channel][first + i]);
+}
+
+/*
+ * Note: The products are taken in double as by the scalar kernel.
+ * A sample of the plane may exceed 1 in magnitude, e.g. where the
+ * sinc of --interp overshoots, so the packing saturates as the
+ * scalar kernel clamps, and the results stay the same.
+ */
+__attribute__((target("avx2")))
+static void resample_int16_avx2(
+   const float *plane,
+   void *dest,
+   const int *read_index,
+   const double *window,
+   int len,
+   int num_channels
+) {
+   unsigned char *out = dest;
+   size_t stride = (size_t) 2 * num_channels;
+   const __m256d scale = _mm256_set1_pd(32768.0);
+   int16_t lanes[8];
+   int i, k;
+   __m256 gathered;
+   __m128i packed;
+
+   for (i = 0; i + 8 <= len; i += 8) {
+      gathered = _mm256_i32gather_ps(plane,
+         _mm256_loadu_si256((const __m256i *) (read_index + i)), 4);
+      packed = _mm_packs_epi32(
+         _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_mul_pd(
+            _mm256_cvtps_pd(_mm256_castps256_ps128(gathered)),
+            _mm256_loadu_pd(window + i)), scale)),
+         _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_mul_pd(
+            _mm256_cvtps_pd(_mm256_extractf128_ps(gathered, 1)),
+            _mm256_loadu_pd(window + i + 4)), scale)));
+      if (num_channels == 1)
+         _mm_storeu_si128((__m128i *) (out + 2 * (size_t) i), packed);
+      else {
+         _mm_storeu_si128((__m128i *) lanes, packed);
+         for (k = 0; k < 8; k++)
+            memcpy(out + stride * (i + k), &lanes[k], 2);
+      }
+   }
+   for (; i < len; i++)
+      truncate_int16(out + stride * i, plane[read_index[i]] * window[i]);
+}
+
+/*
+ * Note: Without AVX2 there is no gather, so the SSE4.1 kernel loads
+ * four samples one by one and vectorizes the rest, four at a time.
+ */
+__attribute__((target("sse4.1")))
+static void resample_int16_sse41(
+   const float *plane,
+   void *dest,
+   const int *read_index,
+   const double *window,
+   int len,
+   int num_channels
+) {
+   unsigned char *out = dest;
+   size_t stride = (size_t) 2 * num_channels;
+   const __m128d scale = _mm_set1_pd(32768.0);
+   int16_t lanes[8];
+   int i, k;
+   __m128 gathered;
+   __m128i packed;
+
+   for (i = 0; i + 4 <= len; i += 4) {
+      gathered = _mm_set_ps(
+         plane[read_index[i + 3]], plane[read_index[i + 2]],
+         plane[read_index[i + 1]], plane[read_index[i]]);
+      packed = _mm_packs_epi32(
+         _mm_unpacklo_epi64(
+            _mm_cvttpd_epi32(_mm_mul_pd(_mm_mul_pd(
+               _mm_cvtps_pd(gathered), _mm_loadu_pd(window + i)), scale)),
+            _mm_cvttpd_epi32(_mm_mul_pd(_mm_mul_pd(
+               _mm_cvtps_pd(_mm_movehl_ps(gathered, gathered)),
+               _mm_loadu_pd(window + i + 2)), scale))),
+         _mm_setzero_si128());
+      if (num_channels == 1)
+         _mm_storel_epi64((__m128i *) (out + 2 * (size_t) i), packed);
+      else {
+         _mm_storeu_si128((__m128i *) lanes, packed);
+         for (k = 0; k < 4; k++)
+            memcpy(out + stride * (i + k), &lanes[k], 2);
+      }
+   }
+   for (; i < len; i++)
+      truncate_int16(out + stride * i, plane[read_index[i]] * window[i]);
+}
+
+#endif
+
+#ifdef HAVE_NEON_KERNEL
+
+/*
+ * Note: The NEON kernel follows the SSE4.1 one: four samples loaded
+ * one by one, the products in double, truncated toward zero and
+ * narrowed with saturation, two lanes at a time.
+ */
+static void resample_int16_neon(
+   const float *plane,
+   void *dest,
+   const int *read_index,
+   const double *window,
+   int len,
+   int num_channels
+) {
+   unsigned char *out = dest;
+   size_t stride = (size_t) 2 * num_channels;
+   const float64x2_t scale = vdupq_n_f64(32768.0);
+   float gathered[4];
+   int16_t lanes[4];
+   int i, k;
+   float32x4_t sample;
+   int64x2_t lo, hi;
+
+   for (i = 0; i + 4 <= len; i += 4) {
+      gathered[0] = plane[read_index[i]];
+      gathered[1] = plane[read_index[i + 1]];
+      gathered[2] = plane[read_index[i + 2]];
+      gathered[3] = plane[read_index[i + 3]];
+      sample = vld1q_f32(gathered);
+      lo = vcvtq_s64_f64(vmulq_f64(vmulq_f64(
+         vcvt_f64_f32(vget_low_f32(sample)), vld1q_f64(window + i)), scale));
+      hi = vcvtq_s64_f64(vmulq_f64(vmulq_f64(
+         vcvt_high_f64_f32(sample), vld1q_f64(window + i + 2)), scale));
+      vst1_s16(lanes, vqmovn_s32(
+         vcombine_s32(vqmovn_s64(lo), vqmovn_s64(hi))));
+      if (num_channels == 1)
+         memcpy(out + 2 * (size_t) i, lanes, sizeof(lanes));
+      else
+         for (k = 0; k < 4; k++)
+            memcpy(out + stride * (i + k), &lanes[k], 2);
+   }
+   for (; i < len; i++)
+      truncate_int16(out + stride * i, plane[read_index[i]] * window[i]);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,772 @@
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "serve.h"
+#include "command_line.h"
+#include "wave_file.h"
+#include "processing.h"
+#include "worker_pool.h"
+#include "window_table.h"
+#include "audio_io.h"
+#include "fft.h"
+#include "miscellaneous.h"
+
+#define DELIMITERS       " \t\r"
+#define OUTBOX_MAX       (64 * 1024)   /* bytes a client may fall behind */
+
+struct client {
+   int fd;     /* -1 once the connection has been closed */
+   int refs;   /* the connection and its jobs; guarded by the server lock */
+   size_t len;             /* bytes in line */
+   char line[SERVE_LINE_MAX];
+
+   /* guarded by lock */
+   pthread_mutex_t lock;
+   bool is_failed;         /* gone, or too far behind; to be closed */
+   size_t out_len;         /* bytes in outbox, not written to fd yet */
+   char outbox[OUTBOX_MAX];
+};
+
+struct serve_job {
+   char id[SERVE_ID_MAX + 1];
+   int mode;
+   double factor;
+   int size;       /* as options->size and options->size_ms */
+   int size_ms;
+   int priority;   /* the higher, the sooner */
+   bool is_cancelled;   /* accessed atomically */
+   struct client *client;
+   struct serve_job *next;
+
+   /* Note: kept here rather than on the stack to survive longjmp. */
+   FILE *src;
+   FILE *dest;
+   char *dest_path;
+
+   /* fields to be freed */
+   char *src_name;
+   char *dest_name;
+};
+
+struct server {
+   struct execution_options *options;
+   struct env_data *env;
+   bool is_le;
+   struct window_cache *windows;
+   struct fft_cache *plans;
+   int grain_threads;   /* threads per job */
+
+   /* guarded by lock */
+   pthread_mutex_t lock;
+   pthread_cond_t job_ready;
+   struct serve_job *queue;     /* by priority, then in arrival order */
+   struct serve_job *running;
+   bool is_stopping;
+
+   /* touched by the main thread only */
+   struct client **clients;
+   int client_count;
+   int client_capacity;
+};
+
+static int stop_pipe[2] = {-1, -1};   /* written to by on_signal */
+static int wake_pipe[2] = {-1, -1};   /* written to by send_line */
+
+static int open_socket(const char *);
+static void on_signal(int);
+static void *work(void *);
+static void run_job(
+   struct server *, struct serve_job *, struct processing_context *);
+static void report_progress(void *, uint32_t, uint32_t);
+static void accept_client(struct server *, int);
+static bool poll_client(struct server *, struct client *, short);
+static bool read_client(struct server *, struct client *);
+static void take_request(struct server *, struct client *, char *);
+static void handle_request(struct server *, struct client *, char *);
+static void queue_job(struct server *, struct client *, char **);
+static void cancel_job(struct server *, struct client *, char **);
+static struct serve_job *find_job(
+   struct serve_job *, const struct client *, const char *);
+static void close_client(struct server *, int);
+static void release_client(struct server *, struct client *);
+static void free_job(struct server *, struct serve_job *);
+static void send_line(struct client *, const char *, ...);
+static void flush_client(struct client *);
+static void set_nonblocking(int);
+
+void run_server(
+   struct execution_options *options,
+   struct env_data *env,
+   bool is_le
+) {
+   struct server server;
+   struct sigaction action;
+   struct pollfd *fds = NULL, *grown;
+   struct serve_job *job;
+   struct client *client;
+   pthread_t *workers;
+   int listen_fd, fd_capacity = 0, count;
+   int i;
+   char wake[64];
+
+   server.options = options;
+   server.env = env;
+   server.is_le = is_le;
+   server.grain_threads = options->threads / options->jobs;
+   if (server.grain_threads < 1)
+      server.grain_threads = 1;
+   server.queue = NULL;
+   server.running = NULL;
+   server.is_stopping = false;
+   server.clients = NULL;
+   server.client_count = 0;
+   server.client_capacity = 0;
+   if (pthread_mutex_init(&server.lock, NULL) != 0
+       || pthread_cond_init(&server.job_ready, NULL) != 0)
+      raise_err("%s: Failed to initialize the synchronization objects.", __func__);
+
+   listen_fd = open_socket(options->serve_name);
+   memset(&action, 0, sizeof(action));
+   action.sa_handler = on_signal;
+   sigemptyset(&action.sa_mask);
+   if (pipe(stop_pipe) != 0 || sigaction(SIGINT, &action, NULL) != 0
+       || sigaction(SIGTERM, &action, NULL) != 0)
+      raise_err("%s: Failed to set up the signal handlers.", __func__);
+   /* A client that has gone shows up as a failed write instead. */
+   signal(SIGPIPE, SIG_IGN);
+   if (pipe(wake_pipe) != 0)
+      raise_err("%s: Failed to create a pipe.", __func__);
+   set_nonblocking(wake_pipe[0]);
+   set_nonblocking(wake_pipe[1]);
+
+   /* The workers are warm from here on; only the buffers still grow. */
+   server.windows = realize_window_cache();
+   server.plans = realize_fft_cache();
+   workers = malloc(sizeof(pthread_t) * options->jobs);
+   if (workers == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   for (i = 0; i < options->jobs; i++)
+      if (pthread_create(&workers[i], NULL, work, &server) != 0)
+         raise_err("%s: Failed to create a worker thread.", __func__);
+   printf("Serving on %s: %d workers of %d threads.\n",
+      options->serve_name, options->jobs, server.grain_threads);
+   fflush(stdout);
+
+   for (;;) {
+      count = server.client_count;
+      if (fd_capacity < count + 3) {
+         fd_capacity = (count + 3) * 2;
+         grown = realloc(fds, sizeof(struct pollfd) * fd_capacity);
+         if (grown == NULL)
+            raise_err("%s: Failed to allocate memory dynamically.", __func__);
+         fds = grown;
+      }
+      fds[0].fd = listen_fd;
+      fds[1].fd = stop_pipe[0];
+      fds[2].fd = wake_pipe[0];
+      for (i = 0; i < 3; i++)
+         fds[i].events = POLLIN;
+      /* A client with lines left to write is waited on for POLLOUT too. */
+      for (i = 0; i < count; i++) {
+         client = server.clients[i];
+         fds[i + 3].fd = client->fd;
+         pthread_mutex_lock(&client->lock);
+         fds[i + 3].events = client->out_len > 0 ? POLLIN | POLLOUT : POLLIN;
+         pthread_mutex_unlock(&client->lock);
+      }
+      if (poll(fds, count + 3, -1) < 0) {
+         if (errno == EINTR)
+            continue;
+         raise_err("%s: Failed to wait for the clients.", __func__);
+      }
+      if (fds[1].revents != 0)
+         break;
+      /* Only to poll again with the outboxes as they are now. */
+      if (fds[2].revents != 0)
+         while (read(wake_pipe[0], wake, sizeof(wake)) > 0)
+            ;
+      /* Closing a client moves the last one, already seen, into its place. */
+      for (i = count - 1; i >= 0; i--)
+         if (!poll_client(&server, server.clients[i], fds[i + 3].revents))
+            close_client(&server, i);
+      if (fds[0].revents & POLLIN)
+         accept_client(&server, listen_fd);
+   }
+
+   /* The running jobs stop where they are; the queued ones never start. */
+   pthread_mutex_lock(&server.lock);
+   server.is_stopping = true;
+   for (job = server.running; job != NULL; job = job->next)
+      __atomic_store_n(&job->is_cancelled, true, __ATOMIC_RELAXED);
+   pthread_cond_broadcast(&server.job_ready);
+   pthread_mutex_unlock(&server.lock);
+   for (i = 0; i < options->jobs; i++)
+      pthread_join(workers[i], NULL);
+   while ((job = server.queue) != NULL) {
+      server.queue = job->next;
+      send_line(job->client, "cancelled %s", job->id);
+      free_job(&server, job);
+   }
+   while (server.client_count > 0)
+      close_client(&server, server.client_count - 1);
+
+   close(listen_fd);
+   unlink(options->serve_name);
+   close(stop_pipe[0]);
+   close(stop_pipe[1]);
+   close(wake_pipe[0]);
+   close(wake_pipe[1]);
+   free(fds);
+   free(workers);
+   free(server.clients);
+   server.plans->unrealize(server.plans->self);
+   server.windows->unrealize(server.windows->self);
+   pthread_cond_destroy(&server.job_ready);
+   pthread_mutex_destroy(&server.lock);
+}
+
+/*
+ * Note: open_socket() replaces a socket file left behind by a
+ * server that has gone, but not one that is still listening.
+ */
+static int open_socket(const char *name) {
+   struct sockaddr_un addr;
+   struct stat st;
+   int fd;
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   if (strlen(name) >= sizeof(addr.sun_path))
+      raise_err("%s: The socket path is too long: %s.", __func__, name);
+   strcpy(addr.sun_path, name);
+
+   if (lstat(name, &st) == 0 && S_ISSOCK(st.st_mode)) {
+      fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (fd >= 0 && connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0)
+         raise_err("%s: A server is already listening on %s.", __func__, name);
+      if (fd >= 0)
+         close(fd);
+      unlink(name);
+   }
+   fd = socket(AF_UNIX, SOCK_STREAM, 0);
+   if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0
+       || listen(fd, SOMAXCONN) != 0)
+      raise_err("%s: Failed to listen on %s.", __func__, name);
+
+   return fd;
+}
+
+/* Note: The main thread is woken up whichever thread gets the signal. */
+static void on_signal(int signum) {
+   ssize_t result;
+
+   (void) signum;
+   result = write(stop_pipe[1], "", 1);
+   (void) result;
+}
+
+/*
+ * Note: Each worker keeps its own grain threads and buffers from one
+ * job to the next, while the window tables and the FFT plans are
+ * shared by all of them, as in --batch.
+ */
+static void *work(void *arg) {
+   struct server *server = arg;
+   struct processing_context context;
+   struct serve_job *job, **link;
+
+   context.pool = realize_worker_pool(server->grain_threads);
+   context.windows = server->windows;
+   context.plans = server->plans;
+   context.buffers = realize_io_buffers();
+
+   pthread_mutex_lock(&server->lock);
+   for (;;) {
+      while (server->queue == NULL && !server->is_stopping)
+         pthread_cond_wait(&server->job_ready, &server->lock);
+      if (server->is_stopping)
+         break;
+      job = server->queue;
+      server->queue = job->next;
+      job->next = server->running;
+      server->running = job;
+      pthread_mutex_unlock(&server->lock);
+
+      run_job(server, job, &context);
+
+      pthread_mutex_lock(&server->lock);
+      for (link = &server->running; *link != job; link = &(*link)->next)
+         ;
+      *link = job->next;
+      pthread_mutex_unlock(&server->lock);
+      free_job(server, job);
+      pthread_mutex_lock(&server->lock);
+   }
+   pthread_mutex_unlock(&server->lock);
+
+   context.buffers->unrealize(context.buffers->self);
+   context.pool->unrealize(context.pool->self);
+
+   return NULL;
+}
+
+/*
+ * Note: run_job() goes through the same steps as process_job() of
+ * --batch, with the progress sent to the client. A cancelled job
+ * stops at the next batch of grains or frame, and what it has
+ * written is removed, as is that of a failed job. One cancelled
+ * after the engine got to the end is done all the same.
+ */
+static void run_job(
+   struct server *server,
+   struct serve_job *job,
+   struct processing_context *context
+) {
+   struct err_trap trap;
+   struct progress_hook hook;
+   struct execution_options options = *server->options;
+   struct wav_info info;
+   uint32_t sample_number;
+   uint64_t size;
+
+   options.src_name = job->src_name;
+   options.dest_name = job->dest_name;
+   options.mode = job->mode;
+   options.factor = job->factor;
+   options.size = job->size;
+   options.size_ms = job->size_ms;
+   options.realtime_block = 0;
+   options.stream_src = false;
+   options.stream_dest = false;
+   options.verbose = false;
+   options.show_progress = true;
+   context->cancel = &job->is_cancelled;
+   hook.report = report_progress;
+   hook.arg = job;
+
+   send_line(job->client, "started %s", job->id);
+   set_progress_hook(&hook);
+   if (setjmp(trap.env) == 0) {
+      set_err_trap(&trap);
+      job->dest_path = open_wav(&options, server->env, &job->src, &job->dest);
+      observe_wav(job->src, &info, server->is_le, false);
+      assess_wav_info(&info);
+      sample_number = process_audio_data(
+         job->src, job->dest, &info, &options, context, server->is_le);
+      if (context->is_cut_short) {
+         fclose(job->src);
+         fclose(job->dest);
+         job->src = NULL;
+         job->dest = NULL;
+         unlink(job->dest_path);
+         send_line(job->client, "cancelled %s", job->id);
+      }
+      else {
+         size = write_wav_header(
+            job->dest, &info, sample_number, server->is_le, false);
+         close_wav(job->src, job->dest);
+         job->src = NULL;
+         job->dest = NULL;
+         send_line(job->client, "done %s %" PRIu64, job->id, size);
+      }
+   }
+   else {
+      if (job->src != NULL)
+         fclose(job->src);
+      if (job->dest != NULL)
+         fclose(job->dest);
+      if (job->dest_path != NULL)
+         unlink(job->dest_path);
+      send_line(job->client, "failed %s %s", job->id, trap.msg);
+   }
+   set_err_trap(NULL);
+   set_progress_hook(NULL);
+   context->cancel = NULL;
+}
+
+static void report_progress(void *arg, uint32_t current, uint32_t total) {
+   struct serve_job *job = arg;
+
+   send_line(job->client, "progress %s %" PRIu32 " %" PRIu32 " %d", job->id,
+      current, total, total == 0 ? 100 : (int) ((uint64_t) current * 100 / total));
+}
+
+static void accept_client(struct server *server, int listen_fd) {
+   struct client *client, **grown;
+   int fd;
+
+   /* The client may have gone already. */
+   fd = accept(listen_fd, NULL, NULL);
+   if (fd < 0)
+      return;
+   if (server->client_count == server->client_capacity) {
+      server->client_capacity
+         = server->client_capacity == 0 ? 16 : server->client_capacity * 2;
+      grown = realloc(server->clients,
+                      sizeof(struct client *) * server->client_capacity);
+      if (grown == NULL)
+         raise_err("%s: Failed to allocate memory dynamically.", __func__);
+      server->clients = grown;
+   }
+   client = malloc(sizeof(struct client));
+   if (client == NULL)
+      raise_err("%s: Failed to create a new struct client.", __func__);
+   set_nonblocking(fd);
+   client->fd = fd;
+   client->refs = 1;
+   client->len = 0;
+   client->is_failed = false;
+   client->out_len = 0;
+   if (pthread_mutex_init(&client->lock, NULL) != 0)
+      raise_err("%s: Failed to initialize the mutex.", __func__);
+   server->clients[server->client_count++] = client;
+}
+
+/*
+ * Note: poll_client() writes out what it can of the outbox of the
+ * client and reads its requests, as revents of poll allows. It
+ * returns false once the connection is to be closed.
+ */
+static bool poll_client(struct server *server, struct client *client, short revents) {
+   bool is_failed;
+
+   pthread_mutex_lock(&client->lock);
+   if (revents & POLLOUT)
+      flush_client(client);
+   is_failed = client->is_failed;
+   pthread_mutex_unlock(&client->lock);
+   if (is_failed)
+      return false;
+   if (revents & (POLLIN | POLLHUP | POLLERR))
+      return read_client(server, client);
+
+   return true;
+}
+
+/*
+ * Note: read_client() takes every complete line the client has sent
+ * so far and keeps the rest for later. It returns false once the
+ * connection is to be closed.
+ */
+static bool read_client(struct server *server, struct client *client) {
+   ssize_t count;
+   char *line, *end;
+
+   count = read(client->fd, client->line + client->len,
+                SERVE_LINE_MAX - client->len);
+   if (count < 0 && (errno == EINTR || errno == EAGAIN))
+      return true;
+   if (count <= 0)
+      return false;
+   client->len += count;
+
+   line = client->line;
+   while ((end = memchr(line, '\n', client->line + client->len - line)) != NULL) {
+      *end = '\0';
+      take_request(server, client, line);
+      line = end + 1;
+   }
+   client->len -= line - client->line;
+   memmove(client->line, line, client->len);
+   if (client->len == SERVE_LINE_MAX) {
+      send_line(client, "error A request line is too long (>= %d).",
+         SERVE_LINE_MAX);
+      return false;
+   }
+
+   return true;
+}
+
+/* Note: A bad request only fails itself, as a bad file of --batch. */
+static void take_request(struct server *server, struct client *client, char *line) {
+   struct err_trap trap;
+
+   if (setjmp(trap.env) == 0) {
+      set_err_trap(&trap);
+      handle_request(server, client, line);
+   }
+   else
+      send_line(client, "error %s", trap.msg);
+   set_err_trap(NULL);
+}
+
+static void handle_request(struct server *server, struct client *client, char *line) {
+   char *rest, *word;
+
+   word = strtok_r(line, DELIMITERS, &rest);
+   if (word == NULL)
+      return;
+   if (strcmp(word, "job") == 0)
+      queue_job(server, client, &rest);
+   else if (strcmp(word, "cancel") == 0)
+      cancel_job(server, client, &rest);
+   else
+      raise_err("%s: An unknown request: %s.", __func__, word);
+}
+
+/*
+ * Note: queue_job() checks everything but the files before the job
+ * is queued; the files are only looked at when the job runs.
+ */
+static void queue_job(struct server *server, struct client *client, char **rest) {
+   struct serve_job job, *objptr, **link;
+   char *id, *mode, *factor, *src_name, *dest_name, *word, *indicator;
+   long value;
+
+   id = strtok_r(NULL, DELIMITERS, rest);
+   mode = strtok_r(NULL, DELIMITERS, rest);
+   factor = strtok_r(NULL, DELIMITERS, rest);
+   src_name = strtok_r(NULL, DELIMITERS, rest);
+   dest_name = strtok_r(NULL, DELIMITERS, rest);
+   if (dest_name == NULL)
+      raise_err("%s: A job needs ID, MODE, FACTOR, SRC and DEST.", __func__);
+   if (strlen(id) > SERVE_ID_MAX)
+      raise_err("%s: A job ID is too long (> %d).", __func__, SERVE_ID_MAX);
+   if (strcmp(mode, "pitch") == 0)
+      job.mode = MODE_PITCH;
+   else if (strcmp(mode, "speed") == 0)
+      job.mode = MODE_SPEED;
+   else
+      raise_err("%s: An invalid mode: %s.", __func__, mode);
+   errno = 0;
+   job.factor = strtod(factor, &indicator);
+   if (indicator == factor || *indicator != '\0' || errno == ERANGE
+       || job.factor < 0 || job.factor > MAX_FACTOR_VALUE)
+      raise_err("%s: An invalid factor: %s.", __func__, factor);
+   if (strcmp(src_name, STREAM_NAME) == 0 || strcmp(dest_name, STREAM_NAME) == 0)
+      raise_err("%s: Streams can't be used by a job.", __func__);
+
+   job.size = server->options->size;
+   job.size_ms = server->options->size_ms;
+   job.priority = 0;
+   while ((word = strtok_r(NULL, DELIMITERS, rest)) != NULL) {
+      if (strncmp(word, "size=", 5) == 0)
+         parse_grain_size(word + 5, &job.size, &job.size_ms, "size");
+      else if (strncmp(word, "priority=", 9) == 0) {
+         errno = 0;
+         value = strtol(word + 9, &indicator, 10);
+         if (indicator == word + 9 || *indicator != '\0' || errno == ERANGE
+             || value < INT_MIN || value > INT_MAX)
+            raise_err("%s: An invalid priority: %s.", __func__, word + 9);
+         job.priority = (int) value;
+      }
+      else
+         raise_err("%s: An unknown field: %s.", __func__, word);
+   }
+
+   objptr = malloc(sizeof(struct serve_job));
+   if (objptr == NULL)
+      raise_err("%s: Failed to create a new struct serve_job.", __func__);
+   *objptr = job;
+   strcpy(objptr->id, id);
+   objptr->is_cancelled = false;
+   objptr->client = client;
+   objptr->src = NULL;
+   objptr->dest = NULL;
+   objptr->dest_path = NULL;
+   objptr->src_name = strdup(src_name);
+   objptr->dest_name = strdup(dest_name);
+   if (objptr->src_name == NULL || objptr->dest_name == NULL) {
+      free(objptr->src_name);
+      free(objptr->dest_name);
+      free(objptr);
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   }
+
+   pthread_mutex_lock(&server->lock);
+   if (find_job(server->queue, client, id) != NULL
+       || find_job(server->running, client, id) != NULL) {
+      pthread_mutex_unlock(&server->lock);
+      free(objptr->src_name);
+      free(objptr->dest_name);
+      free(objptr);
+      raise_err("%s: The job ID %s is in use.", __func__, id);
+   }
+   client->refs++;
+   for (link = &server->queue;
+        *link != NULL && (*link)->priority >= objptr->priority;
+        link = &(*link)->next)
+      ;
+   objptr->next = *link;
+   *link = objptr;
+   /* Sent before any worker can take the job and say it has started. */
+   send_line(client, "queued %s", objptr->id);
+   pthread_cond_signal(&server->job_ready);
+   pthread_mutex_unlock(&server->lock);
+}
+
+/*
+ * Note: cancel_job() takes a queued job off the queue at once, while
+ * a running one is only flagged and reported by its worker. Only
+ * the jobs of the client itself can be cancelled; see find_job.
+ */
+static void cancel_job(struct server *server, struct client *client, char **rest) {
+   struct serve_job *job, **link;
+   char *id;
+
+   id = strtok_r(NULL, DELIMITERS, rest);
+   if (id == NULL)
+      raise_err("%s: A cancel needs ID.", __func__);
+
+   pthread_mutex_lock(&server->lock);
+   for (link = &server->queue;
+        *link != NULL
+        && ((*link)->client != client || strcmp((*link)->id, id) != 0);
+        link = &(*link)->next)
+      ;
+   job = *link;
+   if (job != NULL) {
+      *link = job->next;
+      pthread_mutex_unlock(&server->lock);
+      send_line(job->client, "cancelled %s", job->id);
+      free_job(server, job);
+      return;
+   }
+   job = find_job(server->running, client, id);
+   if (job != NULL)
+      __atomic_store_n(&job->is_cancelled, true, __ATOMIC_RELAXED);
+   pthread_mutex_unlock(&server->lock);
+   if (job == NULL)
+      raise_err("%s: No such job: %s.", __func__, id);
+}
+
+/*
+ * Note: find_job() looks for a job of the client only. The job IDs
+ * of each client are its own, so that one client can neither cancel
+ * the jobs of another nor find out their IDs.
+ */
+static struct serve_job *find_job(
+   struct serve_job *list,
+   const struct client *client,
+   const char *id
+) {
+   for (; list != NULL; list = list->next)
+      if (list->client == client && strcmp(list->id, id) == 0)
+         return list;
+
+   return NULL;
+}
+
+/*
+ * Note: close_client() only closes the connection, after writing out
+ * what it can of the outbox without waiting; the jobs of the client
+ * go on, and the client is freed once the last one is over.
+ */
+static void close_client(struct server *server, int idx) {
+   struct client *client = server->clients[idx];
+
+   pthread_mutex_lock(&client->lock);
+   flush_client(client);
+   close(client->fd);
+   client->fd = -1;
+   client->out_len = 0;
+   pthread_mutex_unlock(&client->lock);
+   server->clients[idx] = server->clients[--server->client_count];
+   release_client(server, client);
+}
+
+static void release_client(struct server *server, struct client *client) {
+   bool is_last;
+
+   pthread_mutex_lock(&server->lock);
+   is_last = --client->refs == 0;
+   pthread_mutex_unlock(&server->lock);
+   if (!is_last)
+      return;
+   pthread_mutex_destroy(&client->lock);
+   free(client);
+}
+
+static void free_job(struct server *server, struct serve_job *job) {
+   release_client(server, job->client);
+   free(job->dest_path);
+   free(job->src_name);
+   free(job->dest_name);
+   free(job);
+}
+
+/*
+ * Note: send_line() puts a whole line in the outbox of the client,
+ * so that the lines of its jobs don't get mixed up, and writes what
+ * the socket takes without waiting; it may be called with the server
+ * lock held. The rest is left to the main thread, woken up through
+ * wake_pipe, as is closing a client that has gone or has let its
+ * outbox fill up. Nothing is sent once the connection is closed.
+ */
+static void send_line(struct client *client, const char *format, ...) {
+   char line[SERVE_LINE_MAX + ERR_MSG_MAX];
+   va_list ap;
+   size_t len;
+   ssize_t written;
+   int result;
+
+   va_start(ap, format);
+   result = vsnprintf(line, sizeof(line) - 1, format, ap);
+   va_end(ap);
+   if (result < 0)
+      return;
+   len = (size_t) result < sizeof(line) - 2 ? (size_t) result : sizeof(line) - 2;
+   line[len++] = '\n';
+
+   pthread_mutex_lock(&client->lock);
+   if (client->fd < 0 || client->is_failed) {
+      pthread_mutex_unlock(&client->lock);
+      return;
+   }
+   if (client->out_len + len > OUTBOX_MAX)
+      client->is_failed = true;
+   else {
+      memcpy(client->outbox + client->out_len, line, len);
+      client->out_len += len;
+      flush_client(client);
+   }
+   if (client->out_len > 0 || client->is_failed) {
+      written = write(wake_pipe[1], "", 1);
+      (void) written;   /* A full pipe wakes up the main thread already. */
+   }
+   pthread_mutex_unlock(&client->lock);
+}
+
+/*
+ * Note: flush_client() writes the outbox of the client until the
+ * socket takes no more, with client->lock held. A failed write
+ * marks the client failed, for the main thread to close it.
+ */
+static void flush_client(struct client *client) {
+   size_t done = 0;
+   ssize_t count;
+
+   while (client->fd >= 0 && done < client->out_len) {
+      count = write(client->fd, client->outbox + done, client->out_len - done);
+      if (count < 0 && errno == EINTR)
+         continue;
+      if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+         break;
+      if (count <= 0) {
+         client->is_failed = true;
+         done = client->out_len;
+         break;
+      }
+      done += count;
+   }
+   client->out_len -= done;
+   memmove(client->outbox, client->outbox + done, client->out_len);
+}
+
+static void set_nonblocking(int fd) {
+   int flags = fcntl(fd, F_GETFL);
+
+   if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0)
+      raise_err("%s: Failed to make a file descriptor non-blocking.", __func__);
+}
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <sched.h>
+#include "spsc_ring.h"
+#include "miscellaneous.h"
+#include "stats.h"
+
+#define SPIN_COUNT 64   /* yields before a waiting side goes to sleep */
+
+static void unrealize(struct spsc_ring *);
+static size_t count_filled(struct spsc_ring *);
+static bool can_acquire(struct spsc_ring *);
+static bool can_peek(struct spsc_ring *);
+static void wait_until(struct spsc_ring *, bool (*)(struct spsc_ring *));
+static void wake_other(struct spsc_ring *);
+
+struct spsc_ring *realize_spsc_ring(int slot_count, size_t slot_size) {
+   struct spsc_ring *objptr;
+
+   if (slot_count < 1)
+      raise_err("%s: The number of slots = %d < 1.", __func__, slot_count);
+   objptr = malloc(sizeof(struct spsc_ring));
+   if (objptr == NULL)
+      raise_err("%s: Failed to create a new struct spsc_ring.", __func__);
+   objptr->lens = malloc(sizeof(size_t) * slot_count);
+   objptr->slots = malloc(slot_size * slot_count);
+   if (objptr->lens == NULL || objptr->slots == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   stats_alloc((sizeof(size_t) + slot_size) * slot_count);
+   objptr->self = objptr;
+   objptr->unrealize = unrealize;
+   objptr->slot_count = slot_count;
+   objptr->slot_size = slot_size;
+   objptr->head = 0;
+   objptr->tail = 0;
+   objptr->closed = false;
+   objptr->sleepers = 0;
+   if (pthread_mutex_init(&objptr->lock, NULL) != 0
+       || pthread_cond_init(&objptr->moved, NULL) != 0)
+      raise_err("%s: Failed to initialize the synchronization objects.", __func__);
+
+   return objptr;
+}
+
+void *acquire_slot(struct spsc_ring *ring) {
+   size_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+   wait_until(ring, can_acquire);
+   if (__atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST))
+      return NULL;
+
+   return ring->slots + head % ring->slot_count * ring->slot_size;
+}
+
+void publish_slot(struct spsc_ring *ring, size_t len) {
+   size_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+   ring->lens[head % ring->slot_count] = len;
+   __atomic_store_n(&ring->head, head + 1, __ATOMIC_SEQ_CST);
+   wake_other(ring);
+}
+
+const void *peek_slot(struct spsc_ring *ring, size_t *len) {
+   size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+   wait_until(ring, can_peek);
+   if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == tail)
+      return NULL;
+   *len = ring->lens[tail % ring->slot_count];
+
+   return ring->slots + tail % ring->slot_count * ring->slot_size;
+}
+
+void release_slot(struct spsc_ring *ring) {
+   size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+   __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_SEQ_CST);
+   wake_other(ring);
+}
+
+void close_ring(struct spsc_ring *ring) {
+   __atomic_store_n(&ring->closed, true, __ATOMIC_SEQ_CST);
+   pthread_mutex_lock(&ring->lock);
+   pthread_cond_broadcast(&ring->moved);
+   pthread_mutex_unlock(&ring->lock);
+}
+
+static size_t count_filled(struct spsc_ring *ring) {
+   return __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST)
+          - __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST);
+}
+
+static bool can_acquire(struct spsc_ring *ring) {
+   return count_filled(ring) < (size_t) ring->slot_count
+          || __atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST);
+}
+
+static bool can_peek(struct spsc_ring *ring) {
+   return count_filled(ring) > 0
+          || __atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Note: A side announces that it sleeps before it checks the ring
+ * for the last time, and the other side checks for sleepers after
+ * it has moved its counter; both being sequentially consistent,
+ * at least one of them sees the other, so no wakeup is lost. The
+ * brief spin first spares the lock when the other side is only a
+ * moment behind.
+ */
+static void wait_until(
+   struct spsc_ring *ring,
+   bool (*is_ready)(struct spsc_ring *)
+) {
+   int i;
+
+   for (i = 0; i < SPIN_COUNT; i++) {
+      if (is_ready(ring))
+         return;
+      sched_yield();
+   }
+   pthread_mutex_lock(&ring->lock);
+   __atomic_fetch_add(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+   while (!is_ready(ring))
+      pthread_cond_wait(&ring->moved, &ring->lock);
+   __atomic_fetch_sub(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+   pthread_mutex_unlock(&ring->lock);
+}
+
+static void wake_other(struct spsc_ring *ring) {
+   if (__atomic_load_n(&ring->sleepers, __ATOMIC_SEQ_CST) == 0)
+      return;
+   pthread_mutex_lock(&ring->lock);
+   pthread_cond_broadcast(&ring->moved);
+   pthread_mutex_unlock(&ring->lock);
+}
+
+static void unrealize(struct spsc_ring *objptr) {
+   pthread_mutex_destroy(&objptr->lock);
+   pthread_cond_destroy(&objptr->moved);
+   free(objptr->lens);
+   free(objptr->slots);
+   free(objptr->self);
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+extern uint64_t stats_begin(void);
+extern void stats_end(int, uint64_t);
+extern void stats_count(int, uint64_t);
+extern void stats_alloc(uint64_t);
+
+struct run_stats *run_stats = NULL;
+static struct run_stats storage;
+
+static const char *stage_names[STAGE_COUNT] = {
+   "read", "process", "convert", "write", "progress"
+};
+
+void enable_stats(void) {
+   memset(&storage, 0, sizeof(storage));
+   storage.start_ns = stats_clock();
+   run_stats = &storage;
+}
+
+uint64_t stats_clock(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+void print_stats(FILE *fp, bool as_json) {
+   const struct run_stats *s = run_stats;
+   double wall_ms, ms;
+   int i;
+
+   if (s == NULL)
+      return;
+   fflush(stdout);
+   wall_ms = (stats_clock() - s->start_ns) / 1e6;
+
+   if (as_json) {
+      fprintf(fp, "{\"wall_ms\":%.3f,\"stages\":{", wall_ms);
+      for (i = 0; i < STAGE_COUNT; i++)
+         fprintf(fp, "%s\"%s\":{\"ms\":%.3f,\"calls\":%" PRIu64 "}",
+            i > 0 ? "," : "", stage_names[i],
+            s->stage_ns[i] / 1e6, s->stage_calls[i]);
+      fprintf(fp, "},\"grains\":%" PRIu64 ",\"frames\":%" PRIu64
+                  ",\"bytes_read\":%" PRIu64 ",\"bytes_written\":%" PRIu64
+                  ",\"allocations\":%" PRIu64 ",\"allocated_bytes\":%" PRIu64
+                  "}\n",
+         s->counters[COUNT_GRAINS], s->counters[COUNT_FRAMES],
+         s->counters[COUNT_BYTES_READ], s->counters[COUNT_BYTES_WRITTEN],
+         s->counters[COUNT_ALLOCS], s->counters[COUNT_ALLOC_BYTES]);
+      return;
+   }
+
+   fprintf(fp, "Stats (stage times are summed over the threads):\n");
+   fprintf(fp, "   %-10s %12s %8s %12s\n", "stage", "time (ms)", "wall %", "calls");
+   for (i = 0; i < STAGE_COUNT; i++) {
+      ms = s->stage_ns[i] / 1e6;
+      fprintf(fp, "   %-10s %12.3f %7.1f%% %12" PRIu64 "\n",
+         stage_names[i], ms, wall_ms > 0 ? ms * 100 / wall_ms : 0,
+         s->stage_calls[i]);
+   }
+   fprintf(fp, "   %-10s %12.3f\n", "wall", wall_ms);
+   fprintf(fp, "   grains: %" PRIu64 ", frames: %" PRIu64 "\n",
+      s->counters[COUNT_GRAINS], s->counters[COUNT_FRAMES]);
+   fprintf(fp, "   bytes read: %" PRIu64 ", written: %" PRIu64 "\n",
+      s->counters[COUNT_BYTES_READ], s->counters[COUNT_BYTES_WRITTEN]);
+   fprintf(fp, "   allocations: %" PRIu64 " (%" PRIu64 " bytes)\n",
+      s->counters[COUNT_ALLOCS], s->counters[COUNT_ALLOC_BYTES]);
+}
\ No newline at end of file
@@ -0,0 +1,423 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "uring_io.h"
+#include "miscellaneous.h"
+#include "stats.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup)
+#define HAVE_IO_URING
+#endif
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+
+#define SLOT_IDLE  0
+#define SLOT_BUSY  1   /* in flight */
+#define SLOT_READY 2   /* read, not handed out yet */
+#define SLOT_HELD  3   /* handed out */
+#define SLOT_ALIGN 4096
+
+static void unrealize(struct uring_io *);
+static bool map_rings(struct uring_io *, const struct io_uring_params *);
+static bool register_slots(struct uring_io *);
+static unsigned char *slot_buffer(const struct uring_io *, int);
+static void submit_read(struct uring_io *, int);
+static void submit(struct uring_io *, int, int, int, uint64_t, size_t);
+static void reap(struct uring_io *);
+static void complete(struct uring_io *, int, int);
+static size_t round_up(size_t);
+
+struct uring_io *realize_uring_io(
+   int src_fd,
+   uint64_t src_offset,
+   uint64_t src_size,
+   int dest_fd,
+   uint64_t dest_offset,
+   size_t src_slot_size,
+   size_t dest_slot_size,
+   int slot_count
+) {
+   struct uring_io *objptr;
+   struct io_uring_params params;
+   struct stat st;
+   int i, count = 2 * slot_count;
+   unsigned entries = 1;
+   void *buffers = NULL;
+
+   /* A result is an int, so is the length of a request. */
+   if (fstat(src_fd, &st) != 0 || !S_ISREG(st.st_mode)
+       || fstat(dest_fd, &st) != 0 || !S_ISREG(st.st_mode)
+       || slot_count < 1 || src_slot_size > INT_MAX
+       || dest_slot_size > INT_MAX)
+      return NULL;
+
+   objptr = malloc(sizeof(struct uring_io));
+   if (objptr == NULL)
+      raise_err("%s: Failed to create a new struct uring_io.", __func__);
+   objptr->self = objptr;
+   objptr->unrealize = unrealize;
+   objptr->src_fd = src_fd;
+   objptr->dest_fd = dest_fd;
+   objptr->slot_count = slot_count;
+   objptr->src_slot_size = src_slot_size;
+   objptr->dest_slot_size = dest_slot_size;
+   objptr->src_offset = src_offset;
+   objptr->src_end = src_size > UINT64_MAX - src_offset
+                     ? UINT64_MAX : src_offset + src_size;
+   objptr->dest_offset = dest_offset;
+   objptr->src_next = 0;
+   objptr->dest_next = 0;
+   objptr->in_flight = 0;
+   objptr->is_src_done = false;
+   objptr->src_error = 0;
+   objptr->is_dest_failed = false;
+   objptr->sq_map = NULL;
+   objptr->cq_map = NULL;
+   objptr->sqes = NULL;
+   objptr->states = malloc(sizeof(int) * count);
+   objptr->lens = malloc(sizeof(int) * count);
+   if (objptr->states == NULL || objptr->lens == NULL
+       || posix_memalign(&buffers, SLOT_ALIGN, (size_t) slot_count
+             * (round_up(src_slot_size) + round_up(dest_slot_size))) != 0)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   objptr->buffers = buffers;
+   stats_alloc((size_t) slot_count
+      * (round_up(src_slot_size) + round_up(dest_slot_size)));
+   for (i = 0; i < count; i++)
+      objptr->states[i] = SLOT_IDLE;
+
+   while (entries < (unsigned) count)
+      entries *= 2;
+   memset(&params, 0, sizeof(params));
+   objptr->ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+   if (objptr->ring_fd < 0 || !map_rings(objptr, &params)
+       || !register_slots(objptr)) {
+      unrealize(objptr);
+      return NULL;
+   }
+
+   for (i = 0; i < slot_count; i++)
+      submit_read(objptr, i);
+
+   return objptr;
+}
+
+const void *peek_uring_slot(struct uring_io *uring, size_t *len) {
+   int slot = uring->src_next;
+   uint64_t start = stats_begin();
+
+   while (uring->states[slot] == SLOT_BUSY)
+      reap(uring);
+   stats_end(STAGE_READ, start);
+   if (uring->src_error != 0)
+      raise_err("%s: Failed to read audio data.", __func__);
+   if (uring->states[slot] != SLOT_READY || uring->lens[slot] == 0)
+      return NULL;
+   uring->states[slot] = SLOT_HELD;
+   *len = uring->lens[slot];
+
+   return slot_buffer(uring, slot);
+}
+
+void release_uring_slot(struct uring_io *uring) {
+   int slot = uring->src_next;
+
+   uring->states[slot] = SLOT_IDLE;
+   uring->src_next = (slot + 1) % uring->slot_count;
+   submit_read(uring, slot);
+}
+
+void *reserve_uring_slot(struct uring_io *uring) {
+   int slot = uring->slot_count + uring->dest_next;
+   uint64_t start = stats_begin();
+
+   while (uring->states[slot] == SLOT_BUSY)
+      reap(uring);
+   stats_end(STAGE_WRITE, start);
+   if (uring->is_dest_failed)
+      raise_err("%s: Failed to write data.", __func__);
+
+   return slot_buffer(uring, slot);
+}
+
+void commit_uring_slot(struct uring_io *uring, size_t len) {
+   int slot = uring->slot_count + uring->dest_next;
+
+   if (len == 0)
+      return;
+   submit(uring, slot, IORING_OP_WRITE_FIXED, uring->dest_fd,
+      uring->dest_offset, len);
+   uring->dest_offset += len;
+   uring->dest_next = (uring->dest_next + 1) % uring->slot_count;
+}
+
+bool finish_uring_io(struct uring_io *uring) {
+   uint64_t start = stats_begin();
+
+   while (uring->in_flight > 0)
+      reap(uring);
+   stats_end(STAGE_WRITE, start);
+
+   return !uring->is_dest_failed;
+}
+
+/*
+ * Note: map_rings() maps the three regions io_uring_setup shares,
+ * one by one, which every kernel with io_uring supports.
+ */
+static bool map_rings(
+   struct uring_io *uring,
+   const struct io_uring_params *params
+) {
+   unsigned char *sq, *cq;
+   void *map;
+
+   uring->sq_map_len = params->sq_off.array + params->sq_entries * sizeof(unsigned);
+   map = mmap(NULL, uring->sq_map_len, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQ_RING);
+   if (map == MAP_FAILED)
+      return false;
+   uring->sq_map = map;
+   uring->cq_map_len
+      = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+   map = mmap(NULL, uring->cq_map_len, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_CQ_RING);
+   if (map == MAP_FAILED)
+      return false;
+   uring->cq_map = map;
+   uring->sqes_len = params->sq_entries * sizeof(struct io_uring_sqe);
+   map = mmap(NULL, uring->sqes_len, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQES);
+   if (map == MAP_FAILED)
+      return false;
+   uring->sqes = map;
+
+   sq = uring->sq_map;
+   cq = uring->cq_map;
+   uring->sq_head = (unsigned *) (sq + params->sq_off.head);
+   uring->sq_tail = (unsigned *) (sq + params->sq_off.tail);
+   uring->sq_mask = (unsigned *) (sq + params->sq_off.ring_mask);
+   uring->sq_array = (unsigned *) (sq + params->sq_off.array);
+   uring->cq_head = (unsigned *) (cq + params->cq_off.head);
+   uring->cq_tail = (unsigned *) (cq + params->cq_off.tail);
+   uring->cq_mask = (unsigned *) (cq + params->cq_off.ring_mask);
+   uring->cqes = cq + params->cq_off.cqes;
+
+   return true;
+}
+
+/*
+ * Note: register_slots() fails where the slots exceed the locked
+ * memory the process may pin, as on older kernels with a small
+ * RLIMIT_MEMLOCK.
+ */
+static bool register_slots(struct uring_io *uring) {
+   int i, count = 2 * uring->slot_count;
+   struct iovec *iovecs;
+   bool is_registered;
+
+   iovecs = malloc(sizeof(struct iovec) * count);
+   if (iovecs == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   for (i = 0; i < count; i++) {
+      iovecs[i].iov_base = slot_buffer(uring, i);
+      iovecs[i].iov_len = i < uring->slot_count
+                          ? uring->src_slot_size : uring->dest_slot_size;
+   }
+   is_registered = syscall(__NR_io_uring_register, uring->ring_fd,
+      IORING_REGISTER_BUFFERS, iovecs, count) == 0;
+   free(iovecs);
+
+   return is_registered;
+}
+
+static unsigned char *slot_buffer(const struct uring_io *uring, int slot) {
+   size_t src_stride = round_up(uring->src_slot_size);
+
+   if (slot < uring->slot_count)
+      return uring->buffers + slot * src_stride;
+   return uring->buffers + uring->slot_count * src_stride
+          + (slot - uring->slot_count) * round_up(uring->dest_slot_size);
+}
+
+/*
+ * Note: submit_read() reads into the slot from where the previous
+ * read ended, so the slots follow one another in the file in the
+ * order they are handed out. Nothing is submitted past the end.
+ */
+static void submit_read(struct uring_io *uring, int slot) {
+   uint64_t len = uring->src_slot_size;
+
+   if (uring->is_src_done || uring->src_offset >= uring->src_end)
+      return;
+   if (uring->src_end - uring->src_offset < len)
+      len = uring->src_end - uring->src_offset;
+   submit(uring, slot, IORING_OP_READ_FIXED, uring->src_fd,
+      uring->src_offset, len);
+   uring->src_offset += len;
+}
+
+static void submit(
+   struct uring_io *uring,
+   int slot,
+   int opcode,
+   int fd,
+   uint64_t offset,
+   size_t len
+) {
+   unsigned tail = *uring->sq_tail;
+   unsigned idx = tail & *uring->sq_mask;
+   struct io_uring_sqe *sqe = (struct io_uring_sqe *) uring->sqes + idx;
+
+   memset(sqe, 0, sizeof(*sqe));
+   sqe->opcode = opcode;
+   sqe->fd = fd;
+   sqe->off = offset;
+   sqe->addr = (uintptr_t) slot_buffer(uring, slot);
+   sqe->len = len;
+   sqe->buf_index = slot;
+   sqe->user_data = slot;
+   uring->sq_array[idx] = idx;
+   __atomic_store_n(uring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+   uring->states[slot] = SLOT_BUSY;
+   uring->lens[slot] = len;
+   uring->in_flight++;
+
+   /* The entry stays queued until the kernel has taken it. */
+   while (syscall(__NR_io_uring_enter, uring->ring_fd, 1, 0, 0, NULL, 0) < 0)
+      if (errno != EINTR && errno != EAGAIN)
+         raise_err("%s: Failed to submit an I/O request.", __func__);
+}
+
+/* Note: reap() waits for at least one completion and takes them all. */
+static void reap(struct uring_io *uring) {
+   unsigned head = *uring->cq_head, tail;
+   struct io_uring_cqe *cqe;
+
+   while (syscall(__NR_io_uring_enter, uring->ring_fd, 0, 1,
+             IORING_ENTER_GETEVENTS, NULL, 0) < 0)
+      if (errno != EINTR)
+         raise_err("%s: Failed to wait for an I/O request.", __func__);
+   tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+   for (; head != tail; head++) {
+      cqe = (struct io_uring_cqe *) uring->cqes + (head & *uring->cq_mask);
+      complete(uring, cqe->user_data, cqe->res);
+   }
+   __atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/*
+ * Note: A read that comes back short has reached the end of the
+ * file; nothing is read after it. A write has to be complete.
+ */
+static void complete(struct uring_io *uring, int slot, int res) {
+   uring->in_flight--;
+   if (slot < uring->slot_count) {
+      if (res < 0) {
+         uring->src_error = -res;
+         res = 0;
+      }
+      if (res < uring->lens[slot])
+         uring->is_src_done = true;
+      uring->lens[slot] = res;
+      uring->states[slot] = SLOT_READY;
+      stats_count(COUNT_BYTES_READ, res);
+   }
+   else {
+      if (res != uring->lens[slot])
+         uring->is_dest_failed = true;
+      uring->states[slot] = SLOT_IDLE;
+      if (res > 0)
+         stats_count(COUNT_BYTES_WRITTEN, res);
+   }
+}
+
+static size_t round_up(size_t len) {
+   return (len + SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN;
+}
+
+/*
+ * Note: The kernel may still be reading into or writing from the
+ * slots, so they are only freed after every request has completed;
+ * closing the ring unregisters them.
+ */
+static void unrealize(struct uring_io *objptr) {
+   while (objptr->in_flight > 0)
+      reap(objptr);
+   if (objptr->sqes != NULL)
+      munmap(objptr->sqes, objptr->sqes_len);
+   if (objptr->cq_map != NULL)
+      munmap(objptr->cq_map, objptr->cq_map_len);
+   if (objptr->sq_map != NULL)
+      munmap(objptr->sq_map, objptr->sq_map_len);
+   if (objptr->ring_fd >= 0)
+      close(objptr->ring_fd);
+   free(objptr->states);
+   free(objptr->lens);
+   free(objptr->buffers);
+   free(objptr->self);
+}
+
+#else
+
+/* Note: Without io_uring, the caller always falls back on stdio. */
+struct uring_io *realize_uring_io(
+   int src_fd,
+   uint64_t src_offset,
+   uint64_t src_size,
+   int dest_fd,
+   uint64_t dest_offset,
+   size_t src_slot_size,
+   size_t dest_slot_size,
+   int slot_count
+) {
+   (void) src_fd;
+   (void) src_offset;
+   (void) src_size;
+   (void) dest_fd;
+   (void) dest_offset;
+   (void) src_slot_size;
+   (void) dest_slot_size;
+   (void) slot_count;
+   return NULL;
+}
+
+const void *peek_uring_slot(struct uring_io *uring, size_t *len) {
+   (void) uring;
+   (void) len;
+   raise_err("%s: io_uring is not supported here.", __func__);
+}
+
+void release_uring_slot(struct uring_io *uring) {
+   (void) uring;
+   raise_err("%s: io_uring is not supported here.", __func__);
+}
+
+void *reserve_uring_slot(struct uring_io *uring) {
+   (void) uring;
+   raise_err("%s: io_uring is not supported here.", __func__);
+}
+
+void commit_uring_slot(struct uring_io *uring, size_t len) {
+   (void) uring;
+   (void) len;
+   raise_err("%s: io_uring is not supported here.", __func__);
+}
+
+bool finish_uring_io(struct uring_io *uring) {
+   (void) uring;
+   raise_err("%s: io_uring is not supported here.", __func__);
+}
+
+#endif
\ No newline at end of file
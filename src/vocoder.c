@@ -0,0 +1,485 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vocoder.h"
+#include "grain_plan.h"
+#include "miscellaneous.h"
+#include "sample_format.h"
+#include "stats.h"
+
+#define PEAK_REACH 2   /* a peak is above the bins this far around */
+
+/*
+ * Note: struct channel_state is what the vocoder carries from one
+ * frame to the next for one channel, and the scratch of the frame
+ * being processed, so that the channels can be processed by
+ * different threads.
+ */
+struct channel_state {
+   float *in;            /* the input window; frame t at t - base */
+   float *prev_phase;    /* the analysis phases of the previous frame */
+   float *synth_phase;   /* the phases given to the previous frame */
+   float *acc;           /* the overlap-add sums; size elements */
+   float *stretched;     /* the stretched audio not resampled yet */
+   float *out;           /* resampled frames to write; hop elements */
+
+   float *frame;
+   float *re;
+   float *im;
+   float *mag;
+   float *phase;
+   int *peak;   /* the nearest peak at or below each bin, or -1 */
+};
+
+/*
+ * Note: struct vocoder keeps a sliding window of the input, as in
+ * the WSOLA engine, except that frames before the start of the
+ * input are zeros: the first frames overlap it only partially.
+ */
+struct vocoder {
+   const struct fft_plan *plan;
+   int size;
+   int hop;         /* the synthesis hop; a quarter frame */
+   int bins;
+   int mode;
+   double speed;    /* input frames per stretched frame */
+   double pitch;    /* stretched frames per output frame */
+   uint16_t num_channels;
+   int format;
+   struct audio_io *io;
+   struct worker_pool *pool;
+   float gain;
+
+   long frame_pos;    /* the input frame being processed */
+   long frame_hop;    /* how far it is from the previous one */
+
+   long base;
+   long len;
+   long cap;
+   bool is_eof;
+   long total_in;
+
+   long stretched_base;   /* the stretched frame at index 0 */
+   int stretched_len;
+   double next_out;       /* the stretched position of the next output */
+
+   /* fields to be freed */
+   float *window;
+   float **planes;   /* [channel]; what to write */
+   struct channel_state *channels;
+};
+
+static void prepare(struct vocoder *, long);
+static void release_vocoder(void *);
+static void process_channel(void *, int);
+static void process_frame(struct vocoder *, struct channel_state *, long, long);
+static uint32_t emit(struct vocoder *, uint32_t, uint32_t);
+
+int vocoder_frame_size(int grain_size) {
+   int size = 4;
+
+   while (size * 2 <= grain_size)
+      size *= 2;
+   return size;
+}
+
+uint32_t vocoder_frame_number(int mode, uint32_t total_frame, double factor) {
+   if (mode == GRAIN_PITCH)
+      return total_frame;
+   return total_frame / factor;
+}
+
+uint32_t vocode(
+   struct audio_io *io,
+   struct worker_pool *pool,
+   const struct fft_plan *plan,
+   int mode,
+   uint16_t num_channels,
+   uint32_t total_frame,
+   double factor,
+   int format,
+   bool show_progress
+) {
+   struct vocoder v;
+   struct channel_state *state;
+   uint32_t out_total, written = 0;
+   int total_digit;
+   long k, pos, prev_pos = 0;
+   int channel, n;
+   uint64_t start;
+
+   v.plan = plan;
+   v.size = plan->size;
+   v.hop = v.size / 4;
+   v.bins = v.size / 2 + 1;
+   v.mode = mode;
+   v.speed = mode == GRAIN_PITCH ? 1 / factor : factor;
+   v.pitch = mode == GRAIN_PITCH ? factor : 1;
+   v.num_channels = num_channels;
+   v.format = format;
+   v.io = io;
+   v.pool = pool;
+   v.cap = 8L * v.size + VOCODER_READ_FRAMES;
+   v.base = -2L * v.size;   /* zeros before the input */
+   v.len = 2L * v.size;
+   v.is_eof = false;
+   v.total_in = 0;
+   v.stretched_base = 0;
+   v.stretched_len = 0;
+   v.next_out = 0;
+
+   v.window = malloc(sizeof(float) * v.size);
+   v.planes = malloc(sizeof(float *) * num_channels);
+   v.channels = calloc(num_channels, sizeof(struct channel_state));
+   push_err_cleanup(release_vocoder, &v);
+   if (v.window == NULL || v.planes == NULL || v.channels == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   for (channel = 0; channel < num_channels; channel++) {
+      state = &v.channels[channel];
+      state->in = calloc(v.cap, sizeof(float));
+      state->prev_phase = calloc(v.bins, sizeof(float));
+      state->synth_phase = calloc(v.bins, sizeof(float));
+      state->acc = calloc(v.size, sizeof(float));
+      state->stretched = calloc(2 * v.hop + 2, sizeof(float));
+      state->out = malloc(sizeof(float) * v.hop);
+      state->frame = malloc(sizeof(float) * v.size);
+      state->re = malloc(sizeof(float) * v.bins);
+      state->im = malloc(sizeof(float) * v.bins);
+      state->mag = malloc(sizeof(float) * v.bins);
+      state->phase = malloc(sizeof(float) * v.bins);
+      state->peak = malloc(sizeof(int) * v.bins);
+      if (state->in == NULL || state->prev_phase == NULL
+          || state->synth_phase == NULL || state->acc == NULL
+          || state->stretched == NULL || state->out == NULL
+          || state->frame == NULL
+          || state->re == NULL || state->im == NULL || state->mag == NULL
+          || state->phase == NULL || state->peak == NULL)
+         raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   }
+   stats_alloc(sizeof(float) * v.size + sizeof(float *) * num_channels
+               + sizeof(struct channel_state) * num_channels
+               + (sizeof(float) * (v.cap + 2 * v.size + 2 * v.hop + 2
+                                   + v.hop + 6 * v.bins)
+                  + sizeof(int) * v.bins) * num_channels);
+   /*
+    * The same periodic Hann window is applied before and after;
+    * its square sums to 1.5 at a quarter frame apart.
+    */
+   for (n = 0; n < v.size; n++)
+      v.window[n] = 0.5 - 0.5 * cos(2 * M_PI * n / v.size);
+   v.gain = 1 / 1.5f;
+
+   out_total = total_frame == UINT32_MAX
+               ? UINT32_MAX : vocoder_frame_number(mode, total_frame, factor);
+   total_digit = count_digit(out_total);
+
+   /*
+    * Frame k is put at k * hop of the stretched audio and analyzed
+    * where its center maps to, so that the start of the input is
+    * covered by the whole overlap too. The first frames fall before
+    * the start and are not written.
+    */
+   for (k = -(v.size / v.hop - 1);
+        written < out_total && !is_io_cancelled(io); k++) {
+      pos = lround((k * v.hop + v.size / 2.0) * v.speed - v.size / 2.0);
+      prepare(&v, pos + v.size);
+      if (v.is_eof && total_frame == UINT32_MAX) {
+         out_total = vocoder_frame_number(mode, v.total_in, factor);
+         if (written >= out_total)
+            break;
+      }
+
+      start = stats_begin();
+      v.frame_pos = pos;
+      v.frame_hop = k == -(v.size / v.hop - 1) ? -1 : pos - prev_pos;
+      if (num_channels == 1 || pool->num_threads == 1)
+         for (channel = 0; channel < num_channels; channel++)
+            process_channel(&v, channel);
+      else
+         run_worker_pool(pool, process_channel, &v, num_channels);
+      prev_pos = pos;
+      stats_end(STAGE_PROCESS, start);
+      stats_count(COUNT_FRAMES, 1);
+
+      if (k >= 0) {
+         written += emit(&v, written, out_total);
+         if (show_progress)
+            print_progress_bar(written, out_total, total_digit);
+      }
+      for (channel = 0; channel < num_channels; channel++) {
+         state = &v.channels[channel];
+         memmove(state->acc, state->acc + v.hop,
+            sizeof(float) * (v.size - v.hop));
+         memset(state->acc + v.size - v.hop, 0, sizeof(float) * v.hop);
+      }
+   }
+
+   pop_err_cleanup(&v);
+   release_vocoder(&v);
+
+   return written;
+}
+
+/*
+ * Note: release_vocoder() is also the cleanup of the engine if the
+ * file fails, when the channels may be allocated only in part.
+ */
+static void release_vocoder(void *arg) {
+   struct vocoder *v = arg;
+   struct channel_state *state;
+   int channel;
+
+   for (channel = 0; v->channels != NULL && channel < v->num_channels;
+        channel++) {
+      state = &v->channels[channel];
+      free(state->in);
+      free(state->prev_phase);
+      free(state->synth_phase);
+      free(state->acc);
+      free(state->stretched);
+      free(state->out);
+      free(state->frame);
+      free(state->re);
+      free(state->im);
+      free(state->mag);
+      free(state->phase);
+      free(state->peak);
+   }
+   free(v->channels);
+   free(v->window);
+   free(v->planes);
+}
+
+/*
+ * Note: This is the task given to the worker pool; idx = channel.
+ * The channels share nothing but what is only read, so they can be
+ * processed at once.
+ */
+static void process_channel(void *arg, int idx) {
+   struct vocoder *v = arg;
+   struct channel_state *state = &v->channels[idx];
+   int n;
+
+   process_frame(v, state, v->frame_pos, v->frame_hop);
+   for (n = 0; n < v->size; n++)
+      state->acc[n] += v->gain * v->window[n] * state->frame[n];
+}
+
+/*
+ * Note: process_frame() turns the input frame at pos into the frame
+ * to overlap-add, left in state->frame. Only the phases of the peaks are
+ * advanced by the frequency they measure over the analysis hop; the
+ * bins around a peak keep their phase relative to it (identity phase
+ * locking), which keeps the partials coherent. hop = -1 marks the
+ * first frame, whose phases are kept as they are.
+ */
+static void process_frame(
+   struct vocoder *v,
+   struct channel_state *state,
+   long pos,
+   long hop
+) {
+   const float *in = state->in + (pos - v->base);
+   int bins = v->bins;
+   int b, p, last_peak, next_peak;
+   double omega, delta;
+
+   for (b = 0; b < v->size; b++)
+      state->frame[b] = in[b] * v->window[b];
+   fft_forward(v->plan, state->frame, state->re, state->im);
+   for (b = 0; b < bins; b++) {
+      state->mag[b] = sqrtf(state->re[b] * state->re[b] + state->im[b] * state->im[b]);
+      state->phase[b] = atan2f(state->im[b], state->re[b]);
+   }
+
+   if (hop < 0) {
+      memcpy(state->synth_phase, state->phase, sizeof(float) * bins);
+   }
+   else {
+      /*
+       * Find the peaks and advance their phases; then, going back,
+       * give every other bin the phase of the nearest peak.
+       */
+      last_peak = -1;
+      for (b = 0; b < bins; b++) {
+         for (p = b - PEAK_REACH; p <= b + PEAK_REACH; p++)
+            if (p != b && p >= 0 && p < bins && state->mag[p] >= state->mag[b])
+               break;
+         if (p > b + PEAK_REACH) {
+            last_peak = b;
+            omega = 2 * M_PI * b / v->size;
+            delta = state->phase[b] - state->prev_phase[b] - omega * hop;
+            delta -= 2 * M_PI * floor(delta / (2 * M_PI) + 0.5);
+            state->synth_phase[b]
+               = fmod(state->synth_phase[b]
+                      + (omega + delta / (hop > 0 ? hop : 1)) * v->hop,
+                      2 * M_PI);
+         }
+         state->peak[b] = last_peak;
+      }
+      next_peak = -1;
+      for (b = bins - 1; b >= 0; b--) {
+         last_peak = state->peak[b];
+         if (last_peak == b) {
+            next_peak = b;
+            continue;
+         }
+         if (last_peak < 0
+             || (next_peak >= 0 && next_peak - b < b - last_peak))
+            p = next_peak;
+         else
+            p = last_peak;
+         if (p < 0)
+            state->synth_phase[b] = state->phase[b];
+         else
+            state->synth_phase[b]
+               = state->synth_phase[p] + state->phase[b] - state->phase[p];
+      }
+   }
+   memcpy(state->prev_phase, state->phase, sizeof(float) * bins);
+
+   for (b = 0; b < bins; b++) {
+      state->re[b] = state->mag[b] * cosf(state->synth_phase[b]);
+      state->im[b] = state->mag[b] * sinf(state->synth_phase[b]);
+   }
+   fft_inverse(v->plan, state->re, state->im, state->frame);
+}
+
+/*
+ * Note: emit() takes the first hop frames of the overlap-add sums,
+ * which are final now, and writes what they yield, up to out_total
+ * frames in all: the frames themselves for the speed, or for the
+ * pitch, the frames resampled by linear interpolation. It returns
+ * the number of frames written.
+ */
+static uint32_t emit(struct vocoder *v, uint32_t written, uint32_t out_total) {
+   uint16_t nc = v->num_channels;
+   struct channel_state *state;
+   float **planes = v->planes;
+   uint32_t count = 0;
+   unsigned char *dest;
+   int channel, n, chunk, drop;
+   double at, frac;
+   long index;
+   uint64_t start;
+
+   if (v->pitch == 1) {
+      count = v->hop;
+      if (out_total - written < count)
+         count = out_total - written;
+      for (channel = 0; channel < nc; channel++)
+         planes[channel] = v->channels[channel].acc;
+      dest = v->io->reserve(v->io, (size_t) count * nc);
+      start = stats_begin();
+      interleave_samples(v->format, planes, 0, dest, count, nc);
+      stats_end(STAGE_CONVERT, start);
+      v->io->commit(v->io, (size_t) count * nc);
+      return count;
+   }
+
+   for (channel = 0; channel < nc; channel++) {
+      state = &v->channels[channel];
+      memcpy(state->stretched + v->stretched_len, state->acc,
+         sizeof(float) * v->hop);
+   }
+   v->stretched_len += v->hop;
+
+   for (;;) {
+      /* Up to a hop of output frames at a time. */
+      chunk = 0;
+      while (chunk < v->hop && written + count + chunk < out_total) {
+         at = v->next_out + chunk * v->pitch;
+         if ((long) at + 1 >= v->stretched_base + v->stretched_len)
+            break;
+         chunk++;
+      }
+      if (chunk == 0)
+         break;
+      for (channel = 0; channel < nc; channel++) {
+         state = &v->channels[channel];
+         for (n = 0; n < chunk; n++) {
+            at = v->next_out + n * v->pitch;
+            index = (long) at - v->stretched_base;
+            frac = at - (long) at;
+            state->out[n] = state->stretched[index]
+               + frac * (state->stretched[index + 1] - state->stretched[index]);
+         }
+         planes[channel] = state->out;
+      }
+      dest = v->io->reserve(v->io, (size_t) chunk * nc);
+      start = stats_begin();
+      interleave_samples(v->format, planes, 0, dest, chunk, nc);
+      stats_end(STAGE_CONVERT, start);
+      v->io->commit(v->io, (size_t) chunk * nc);
+      v->next_out += chunk * v->pitch;
+      count += chunk;
+   }
+
+   /* Frames before the next position are needed no longer. */
+   drop = (long) v->next_out - v->stretched_base;
+   if (drop > v->stretched_len)
+      drop = v->stretched_len;
+   for (channel = 0; channel < nc; channel++) {
+      state = &v->channels[channel];
+      memmove(state->stretched, state->stretched + drop,
+         sizeof(float) * (v->stretched_len - drop));
+   }
+   v->stretched_base += drop;
+   v->stretched_len -= drop;
+
+   return count;
+}
+
+/*
+ * Note: prepare() makes the input up to frame end available, reading
+ * more and dropping what no frame can reach any longer. Past the end
+ * of the input come zeros.
+ */
+static void prepare(struct vocoder *v, long end) {
+   long keep_from, drop;
+   size_t count;
+   const unsigned char *data;
+   int channel;
+   uint16_t nc = v->num_channels;
+   uint64_t start;
+
+   while (v->base + v->len < end) {
+      if (v->len + VOCODER_READ_FRAMES > v->cap) {
+         keep_from = v->base + v->len - (v->cap - VOCODER_READ_FRAMES);
+         drop = keep_from - v->base;
+         if (drop <= 0)
+            raise_err("%s: The input window is too small.", __func__);
+         for (channel = 0; channel < nc; channel++)
+            memmove(v->channels[channel].in, v->channels[channel].in + drop,
+               sizeof(float) * (v->len - drop));
+         v->base = keep_from;
+         v->len -= drop;
+      }
+      count = 0;
+      data = NULL;
+      if (!v->is_eof) {
+         count = (size_t) VOCODER_READ_FRAMES * nc;
+         if (count > v->io->src_buf_len)
+            count = v->io->src_buf_len / nc * nc;
+         data = v->io->read(v->io, &count);
+      }
+      count /= nc;
+      if (count == 0) {
+         v->is_eof = true;
+         data = NULL;
+         count = VOCODER_READ_FRAMES;
+      }
+      start = stats_begin();
+      for (channel = 0; channel < nc; channel++) {
+         v->planes[channel] = v->channels[channel].in;
+         if (data == NULL)
+            memset(v->planes[channel] + v->len, 0, sizeof(float) * count);
+      }
+      if (data != NULL)
+         deinterleave_samples(v->format, data, v->planes, v->len, count, nc);
+      stats_end(STAGE_CONVERT, start);
+      v->len += count;
+      if (data != NULL)
+         v->total_in += count;
+   }
+}
\ No newline at end of file
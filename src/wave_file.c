@@ -2,19 +2,37 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <unistd.h>
 #include "wave_file.h"
 #include "miscellaneous.h"
+#include "sample_format.h"
 
 #define RIFF 0x52494646    
+#define RF64 0x52463634
+#define BW64 0x42573634
 #define WAVE 0x57415645
+#define DS64 0x64733634
+#define JUNK 0x4A554E4B
 #define FMT  0x666D7420
 #define DATA 0x64617461
 #define LIST 0x4C495354
 
+/* KSDATAFORMAT_SUBTYPE_PCM and _IEEE_FLOAT after their format code */
+static const unsigned char guid_tail[14] = {
+   0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+   0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+};
+
+static void handle_ds64_chunk(FILE *, struct wav_info *, bool, uint32_t);
 static void handle_fmt_subchunk(
    FILE *, struct wav_info *, bool, uint32_t);
-static void handle_data_subchunk(struct wav_info *, uint32_t);
+static void handle_data_subchunk(struct wav_info *, uint32_t, uint64_t);
 static void handle_list_chunk(FILE *, uint32_t, bool);
+static void skip_bytes(FILE *, uint32_t);
+static void emit_wav_header(FILE *, struct wav_info *, uint64_t, bool);
+static void write_u32(FILE *, uint32_t, bool, const char *);
+static void write_u64(FILE *, uint64_t, bool, const char *);
+static char *join_path(char *, char *, bool);
 
 void observe_wav(
    FILE *src,
@@ -29,18 +47,28 @@ void observe_wav(
    int result;
    uint32_t chunk_id, chunk_size;
 
+   info->has_ds64 = false;
+   info->has_header = false;
+   info->subchunk_2_size = WAV_UNKNOWN_SIZE;   /* until ds64 says otherwise */
+
    result = fread(&info->chunk_id, 4, 1, src);
    if (result != 1) raise_err("%s: Failed to read RIFF.", __func__);
    if (le) endrev32(&info->chunk_id);
    
-   result = fread(&info->chunk_size, 4, 1, src);
+   result = fread(&chunk_size, 4, 1, src);
    if (result != 1) raise_err("%s: Failed to read the size of the RIFF chunk.", __func__);
-   if (be) endrev32(&info->chunk_size);
+   if (be) endrev32(&chunk_size);
+   info->chunk_size = chunk_size;
    
    result = fread(&info->format, 4, 1, src);
    if (result != 1) raise_err("%s: Failed to read WAVE.", __func__);
    if (le) endrev32(&info->format);
 
+   /* Walking the chunks of anything else only ends in a misleading error. */
+   if ((info->chunk_id != RIFF && info->chunk_id != RF64
+        && info->chunk_id != BW64) || info->format != WAVE)
+      raise_err("%s: Not a RIFF/WAVE file.", __func__);
+
    /*
     * Skip (possible) optional chunks and try to find
     * a fmt and data subchunk.
@@ -54,27 +82,25 @@ void observe_wav(
       if (result != 1) raise_err("%s: Failed to read ChunkSize.", __func__);
       if (be) endrev32(&chunk_size);
 
-      if (chunk_size > LONG_MAX)
-            raise_err("%s: A file too big: I wouldn't like to process this file.", __func__);
-
       switch (chunk_id) {
+         case DS64:
+            handle_ds64_chunk(src, info, is_le, chunk_size);
+         break;
          case FMT: {
             handle_fmt_subchunk(src, info, is_le, chunk_size);
             is_fmt_subchunk_found = true;
          }
          break;
          case DATA: {
-            handle_data_subchunk(info, chunk_size);
+            handle_data_subchunk(info, chunk_size, info->subchunk_2_size);
             is_data_subchunk_found = true;
          }
          break;
          case LIST:
             handle_list_chunk(src, chunk_size, is_verbose);
          break;
-         default: {
-            result = fseek(src, chunk_size, SEEK_CUR);
-            if (result != 0) raise_err("%s: Failed to seek the file position.", __func__);
-         }
+         default:
+            skip_bytes(src, chunk_size);
       }
    }
 
@@ -82,6 +108,33 @@ void observe_wav(
       raise_err("%s: An invalidly formatted .wav file.", __func__);
 }
 
+/*
+ * Note: Only the RIFF and data sizes of a ds64 chunk matter here;
+ * the sample count follows from the latter and the table, which
+ * gives the sizes of other big chunks, from skipping them.
+ */
+static void handle_ds64_chunk(
+   FILE *src,
+   struct wav_info *info,
+   bool is_le,
+   uint32_t chunk_size
+) {
+   int result;
+   bool be = !is_le;
+
+   if (chunk_size < 16)
+      raise_err("%s: A ds64 chunk too short.", __func__);
+   result = fread(&info->chunk_size, 8, 1, src);
+   if (result != 1) raise_err("%s: Failed to read the RIFF size of ds64.", __func__);
+   if (be) endrev64(&info->chunk_size);
+
+   result = fread(&info->subchunk_2_size, 8, 1, src);
+   if (result != 1) raise_err("%s: Failed to read the data size of ds64.", __func__);
+   if (be) endrev64(&info->subchunk_2_size);
+
+   skip_bytes(src, chunk_size - 16);
+}
+
 static void handle_fmt_subchunk(
    FILE *src,
    struct wav_info *info,
@@ -91,6 +144,7 @@ static void handle_fmt_subchunk(
    int result;
    bool le = is_le;
    bool be = !le;
+   unsigned char guid[14];
 
    info->subchunk_1_id = FMT;
    info->subchunk_1_size = chunk_size;
@@ -119,18 +173,60 @@ static void handle_fmt_subchunk(
    if (result != 1) raise_err("%s: Failed to read BitsPerSample.", __func__);
    if (be) endrev16(&info->bits_per_sample);
 
-   if (chunk_size == 18 || chunk_size == 40) {
-      result = fseek(src, chunk_size - 16, SEEK_CUR);
-      if (result != 0) raise_err("%s: Failed to seek the file position.", __func__);
+   info->extension_size = 0;
+   info->valid_bits = info->bits_per_sample;
+   info->channel_mask = 0;
+   info->sub_format = info->audio_format;
+   if (chunk_size < 16)
+      raise_err("%s: A fmt subchunk too short.", __func__);
+   if (chunk_size < 18) {
+      skip_bytes(src, chunk_size - 16);
+      return;
+   }
+
+   result = fread(&info->extension_size, 2, 1, src);
+   if (result != 1) raise_err("%s: Failed to read cbSize.", __func__);
+   if (be) endrev16(&info->extension_size);
+   if (chunk_size < 40 || info->extension_size < 22) {
+      skip_bytes(src, chunk_size - 18);
+      return;
    }
+
+   result = fread(&info->valid_bits, 2, 1, src);
+   if (result != 1) raise_err("%s: Failed to read ValidBitsPerSample.", __func__);
+   if (be) endrev16(&info->valid_bits);
+
+   result = fread(&info->channel_mask, 4, 1, src);
+   if (result != 1) raise_err("%s: Failed to read ChannelMask.", __func__);
+   if (be) endrev32(&info->channel_mask);
+
+   result = fread(&info->sub_format, 2, 1, src);
+   if (result != 1) raise_err("%s: Failed to read SubFormat.", __func__);
+   if (be) endrev16(&info->sub_format);
+
+   /* Any other GUID is not a format this program knows. */
+   result = fread(guid, 14, 1, src);
+   if (result != 1) raise_err("%s: Failed to read SubFormat.", __func__);
+   if (memcmp(guid, guid_tail, 14) != 0)
+      info->sub_format = 0;
+
+   skip_bytes(src, chunk_size - 40);
 }
 
+/*
+ * Note: The placeholder size stands for the size of the ds64 chunk,
+ * ds64_size, which is WAV_UNKNOWN_SIZE without one: a stream of
+ * unknown length.
+ */
 static void handle_data_subchunk(
    struct wav_info *info,
-   uint32_t chunk_size
+   uint32_t chunk_size,
+   uint64_t ds64_size
 ) {
    info->subchunk_2_id = DATA;
    info->subchunk_2_size = chunk_size;
+   if (chunk_size == WAV_SIZE_PLACEHOLDER)
+      info->subchunk_2_size = ds64_size;
 }
 
 static void handle_list_chunk(
@@ -138,13 +234,27 @@ static void handle_list_chunk(
    uint32_t chunk_size,
    bool is_verbose
 ) {
-   int result;
-
    if (is_verbose)
       printf("A LIST chunk has been found but ignored.\n");
 
-   result = fseek(src, chunk_size, SEEK_CUR);
-   if (result != 0) raise_err("%s: Failed to seek the file position.", __func__);
+   skip_bytes(src, chunk_size);
+}
+
+/*
+ * Note: skip_bytes() reads and discards n bytes rather than seeking,
+ * so that the input may also be a pipe. The chunks skipped before
+ * the audio data are small.
+ */
+static void skip_bytes(FILE *src, uint32_t n) {
+   char scratch[BUFSIZ];
+   size_t count;
+
+   while (n > 0) {
+      count = n < sizeof(scratch) ? n : sizeof(scratch);
+      if (fread(scratch, 1, count, src) != count)
+         raise_err("%s: Failed to skip a chunk.", __func__);
+      n -= count;
+   }
 }
 
 /* Note: This function does this task: 0x6162 --> "ab" */
@@ -157,31 +267,56 @@ static void hex2fourCC(uint32_t hex, char *str) {
 
 void show_wav_info(char *file_name, struct wav_info *info) {
    char fourCC[5] = {0};
+   const char *format_name;
+
+   switch (info->audio_format) {
+      case WAVE_FORMAT_PCM:
+         format_name = "(PCM)";
+      break;
+      case WAVE_FORMAT_IEEE_FLOAT:
+         format_name = "(IEEE float)";
+      break;
+      case WAVE_FORMAT_EXTENSIBLE:
+         format_name = "(extensible)";
+      break;
+      default:
+         format_name = "";
+   }
 
    printf("Successful read of %s; its metadata:\n", file_name);
    hex2fourCC(info->chunk_id, fourCC);
    printf("  ChunkID = %s\n", fourCC);
-   printf("  ChunkSize = %d (bytes)\n", info->chunk_size);
+   printf("  ChunkSize = %" PRIu64 " (bytes)\n", info->chunk_size);
    hex2fourCC(info->format, fourCC);
    printf("  Format = %s\n", fourCC);
    hex2fourCC(info->subchunk_1_id, fourCC);
    printf("  SubChunk1ID = %s\n", fourCC);
    printf("  SubChunk1Size = %d (bytes)\n", info->subchunk_1_size);
-   printf("  AudioFormat = %d %s",
-          info->audio_format, info->audio_format == 1 ? "(PCM)\n" : "\n");
+   printf("  AudioFormat = %d %s\n", info->audio_format, format_name);
    printf("  NumChannels = %d\n", info->num_channels);
    printf("  SampleRate = %d\n", info->sample_rate);
    printf("  ByteRate = %d\n", info->byte_rate);
    printf("  BlockAlign = %d (bytes)\n", info->block_align);
    printf("  BitsPerSample = %d\n", info->bits_per_sample);
+   if (info->audio_format == WAVE_FORMAT_EXTENSIBLE) {
+      printf("  ValidBitsPerSample = %d\n", info->valid_bits);
+      printf("  ChannelMask = 0x%" PRIX32 "\n", info->channel_mask);
+      printf("  SubFormat = %d\n", info->sub_format);
+   }
    hex2fourCC(info->subchunk_2_id, fourCC);
    printf("  SubChunk2ID = %s\n", fourCC);
-   printf("  SubChunk2Size = %d\n", info->subchunk_2_size);
+   if (info->subchunk_2_size == WAV_UNKNOWN_SIZE)
+      printf("  SubChunk2Size = unknown\n");
+   else
+      printf("  SubChunk2Size = %" PRIu64 "\n", info->subchunk_2_size);
 }
 
 void assess_wav_info(struct wav_info *info) {
-   if (info->chunk_id != RIFF)
-      raise_err("%s: Need ChunkID = RIFF.", __func__);
+   uint16_t format = info->audio_format;
+
+   if (info->chunk_id != RIFF && info->chunk_id != RF64
+       && info->chunk_id != BW64)
+      raise_err("%s: Need ChunkID = RIFF, RF64 or BW64.", __func__);
 
    if (info->format != WAVE)
       raise_err("%s: Need Format = WAVE.", __func__);
@@ -189,102 +324,251 @@ void assess_wav_info(struct wav_info *info) {
    if (info->subchunk_1_id != FMT)
       raise_err("%s: Need SubChunk1ID = FMT_", __func__);
 
-   if (info->subchunk_1_size != 16)
-      raise_err("%s: Need SubChunk1Size = 16", __func__);
+   if (info->subchunk_1_size != 16 && info->subchunk_1_size != 18
+       && info->subchunk_1_size != 40)
+      raise_err("%s: Need SubChunk1Size = 16, 18 or 40", __func__);
+
+   if (format == WAVE_FORMAT_EXTENSIBLE) {
+      if (info->subchunk_1_size != 40 || info->extension_size != 22)
+         raise_err("%s: Need cbSize = 22 for WAVE_FORMAT_EXTENSIBLE.", __func__);
+      if (info->valid_bits == 0 || info->valid_bits > info->bits_per_sample)
+         raise_err("%s: Need ValidBitsPerSample <= BitsPerSample.", __func__);
+      format = info->sub_format;
+   }
+   else if (info->subchunk_1_size == 40)
+      raise_err("%s: Need AudioFormat = 0xFFFE for SubChunk1Size = 40.", __func__);
+   if (format != WAVE_FORMAT_PCM && format != WAVE_FORMAT_IEEE_FLOAT)
+      raise_err("%s: Need AudioFormat = 1 (PCM), 3 (IEEE float) "
+         "or 0xFFFE (extensible) of either.", __func__);
+
+   if (info->num_channels == 0 || info->num_channels > MAX_CHANNELS)
+      raise_err("%s: Need NumChannels = 1 ~ %d.", __func__, MAX_CHANNELS);
+
+   if (info->sample_rate < MIN_SAMPLE_RATE
+       || info->sample_rate > MAX_SAMPLE_RATE)
+      raise_err("%s: Need SampleRate = %d ~ %d.",
+         __func__, MIN_SAMPLE_RATE, MAX_SAMPLE_RATE);
+
+   if (format == WAVE_FORMAT_IEEE_FLOAT && info->bits_per_sample != 32)
+      raise_err("%s: Need BitsPerSample = 32 for IEEE float.", __func__);
+
+   if (info->bits_per_sample != 16 && info->bits_per_sample != 24
+       && info->bits_per_sample != 32)
+      raise_err("%s: Need BitsPerSample = 16, 24 or 32.", __func__);
+
+   if (info->block_align != info->num_channels * info->bits_per_sample / 8)
+      raise_err("%s: Need BlockAlign = NumChannels * BitsPerSample / 8.", __func__);
+
+   if (info->byte_rate != info->sample_rate * info->block_align)
+      raise_err("%s: Need ByteRate = SampleRate * BlockAlign.", __func__);
+
+   /* The frames are counted in 32 bits, UINT32_MAX meaning endless. */
+   if (info->subchunk_2_size != WAV_UNKNOWN_SIZE
+       && info->subchunk_2_size / info->block_align >= UINT32_MAX)
+      raise_err("%s: Need fewer than %" PRIu32 " frames.", __func__, UINT32_MAX);
+
+   if (format == WAVE_FORMAT_IEEE_FLOAT)
+      info->sample_format = SAMPLE_FLOAT32;
+   else if (info->bits_per_sample == 16)
+      info->sample_format = SAMPLE_INT16;
+   else if (info->bits_per_sample == 24)
+      info->sample_format = SAMPLE_INT24;
+   else
+      info->sample_format = SAMPLE_INT32;
+}
 
-   if (info->audio_format != 1)
-      raise_err("%s: Need AudioFormat = 1 (PCM).", __func__);
+/*
+ * Note: A file whose size is not known in advance keeps room for a
+ * ds64 chunk, filled with a JUNK chunk of the same size if the file
+ * stays small, as EBU Tech 3306 has it; the header of any other
+ * output is as it has always been. A stream gets its header before
+ * the data, so it can only be RF64 if its size is known.
+ */
+void fit_wav_header(struct wav_info *info, uint64_t data_size, bool is_stream) {
+   uint64_t limit = WAV_SIZE_PLACEHOLDER - 1 - (28 + info->subchunk_1_size - 8);
+
+   if (data_size == WAV_UNKNOWN_SIZE)
+      info->has_ds64 = !is_stream;
+   else
+      info->has_ds64 = data_size > limit;
+}
 
-   if (info->num_channels > 2)
-      raise_err("%s: Need NumChannels = 1 or 2.", __func__);
+uint32_t wav_header_size(const struct wav_info *info) {
+   return 28 + info->subchunk_1_size + (info->has_ds64 ? DS64_CHUNK_SIZE : 0);
+}
 
-   if (info->sample_rate != 44100)
-      raise_err("%s: Need SampleRate = 44100.", __func__);
+uint64_t write_wav_header(
+   FILE *dest,
+   struct wav_info *info,
+   uint32_t sample_number,
+   bool is_le,
+   bool is_stream
+) {
+   uint64_t subchunk_2_size;
 
-   if (info->byte_rate != 88200 && info->byte_rate != 176400)
-      raise_err("%s: Need ByteRate = 88200 or 176400.", __func__);
+   subchunk_2_size = (uint64_t) sample_number
+                     * info->num_channels
+                     * (info->bits_per_sample / 8);
 
-   if (info->block_align != 2 && info->block_align != 4)
-      raise_err("%s: Need BlockAlign = 2 or 4.", __func__);
+   /* See write_wav_header_ahead. */
+   if (!is_stream
+       && !(info->has_header && info->header_data_size == subchunk_2_size)) {
+      rewind(dest);
+      emit_wav_header(dest, info, subchunk_2_size, is_le);
+   }
 
-   if (info->bits_per_sample != 16)
-      raise_err("%s: Need BitsPerSample = 16.", __func__);
+   return wav_header_size(info) + subchunk_2_size;
 }
 
-void write_wav_header(
+void write_wav_header_ahead(
    FILE *dest,
    struct wav_info *info,
    uint32_t sample_number,
-   bool is_le,
-   char *dest_path
+   bool is_le
+) {
+   uint64_t subchunk_2_size = WAV_UNKNOWN_SIZE;
+
+   if (sample_number != UINT32_MAX)
+      subchunk_2_size = (uint64_t) sample_number
+                        * info->num_channels
+                        * (info->bits_per_sample / 8);
+   emit_wav_header(dest, info, subchunk_2_size, is_le);
+   info->has_header = true;
+   info->header_data_size = subchunk_2_size;
+}
+
+/*
+ * Note: emit_wav_header() writes the header of wav_header_size()
+ * bytes at the current position. The fields are swapped on a copy,
+ * so info can be used again afterwards. With room for ds64, the
+ * header is RF64 once the RIFF size no longer fits in 32 bits, and
+ * the room is a JUNK chunk otherwise.
+ */
+static void emit_wav_header(
+   FILE *dest,
+   struct wav_info *info,
+   uint64_t subchunk_2_size,
+   bool is_le
 ) {
    int result;
    bool le = is_le;
    bool be = !le;
 
-   uint32_t chunk_size, subchunk_2_size;
-
-   subchunk_2_size = sample_number
-                     * info->num_channels
-                     * (info->bits_per_sample / 8);
-   chunk_size = 36 + subchunk_2_size;
-
-   rewind(dest);
+   struct wav_info header = *info;
+   uint64_t chunk_size = WAV_UNKNOWN_SIZE;
+   bool is_rf64 = false;
+   unsigned char junk[DS64_CHUNK_SIZE - 8] = {0};
 
-   if (le) endrev32(&info->chunk_id);
-   result = fwrite(&info->chunk_id, 4, 1, dest);
-   if (result != 1) raise_err("%s: Failed to write ChunkID.", __func__);
+   if (subchunk_2_size != WAV_UNKNOWN_SIZE) {
+      chunk_size = wav_header_size(info) - 8 + subchunk_2_size;
+      is_rf64 = info->has_ds64 && chunk_size >= WAV_SIZE_PLACEHOLDER;
+   }
 
-   if (be) endrev32(&chunk_size);
-   result = fwrite(&chunk_size, 4, 1, dest);
-   if (result != 1) raise_err("%s: Failed to write ChunkSize.", __func__);
+   write_u32(dest, is_rf64 ? RF64 : RIFF, le, "ChunkID");
+   write_u32(dest, is_rf64 || chunk_size >= WAV_SIZE_PLACEHOLDER
+                   ? WAV_SIZE_PLACEHOLDER : (uint32_t) chunk_size,
+             be, "ChunkSize");
 
-   if (le) endrev32(&info->format);
-   result = fwrite(&info->format, 4, 1, dest);
+   if (le) endrev32(&header.format);
+   result = fwrite(&header.format, 4, 1, dest);
    if (result != 1) raise_err("%s: Failed to write Format.", __func__);
 
-   if (le) endrev32(&info->subchunk_1_id);
-   result = fwrite(&info->subchunk_1_id, 4, 1, dest);
+   if (is_rf64) {
+      write_u32(dest, DS64, le, "ds64");
+      write_u32(dest, DS64_CHUNK_SIZE - 8, be, "the size of ds64");
+      write_u64(dest, chunk_size, be, "the RIFF size of ds64");
+      write_u64(dest, subchunk_2_size, be, "the data size of ds64");
+      write_u64(dest, subchunk_2_size / info->block_align, be,
+         "the sample count of ds64");
+      write_u32(dest, 0, be, "the table length of ds64");
+   }
+   else if (info->has_ds64) {
+      write_u32(dest, JUNK, le, "JUNK");
+      write_u32(dest, DS64_CHUNK_SIZE - 8, be, "the size of JUNK");
+      result = fwrite(junk, sizeof(junk), 1, dest);
+      if (result != 1) raise_err("%s: Failed to write JUNK.", __func__);
+   }
+
+   if (le) endrev32(&header.subchunk_1_id);
+   result = fwrite(&header.subchunk_1_id, 4, 1, dest);
    if (result != 1) raise_err("%s: Failed to write Subchunk1ID.", __func__);
 
-   if (be) endrev32(&info->subchunk_1_size);
-   result = fwrite(&info->subchunk_1_size, 4, 1, dest);
+   if (be) endrev32(&header.subchunk_1_size);
+   result = fwrite(&header.subchunk_1_size, 4, 1, dest);
    if (result != 1) raise_err("%s: Failed to write Subchunk1Size.", __func__);
 
-   if (be) endrev16(&info->audio_format);
-   result = fwrite(&info->audio_format, 2, 1, dest);
+   if (be) endrev16(&header.audio_format);
+   result = fwrite(&header.audio_format, 2, 1, dest);
    if (result != 1) raise_err("%s: Failed to write AudioFormat.", __func__);
 
-   if (be) endrev16(&info->num_channels);
-   result = fwrite(&info->num_channels, 2, 1, dest);
+   if (be) endrev16(&header.num_channels);
+   result = fwrite(&header.num_channels, 2, 1, dest);
    if (result != 1) raise_err("%s: Failed to write NumChannels.", __func__);
 
-   if (be) endrev32(&info->sample_rate);
-   result = fwrite(&info->sample_rate, 4, 1, dest);
+   if (be) endrev32(&header.sample_rate);
+   result = fwrite(&header.sample_rate, 4, 1, dest);
    if (result != 1) raise_err("%s: Failed to write SampleRate.", __func__);
 
-   if (be) endrev32(&info->byte_rate);
-   result = fwrite(&info->byte_rate, 4, 1, dest);
+   if (be) endrev32(&header.byte_rate);
+   result = fwrite(&header.byte_rate, 4, 1, dest);
    if (result != 1) raise_err("%s: Failed to write ByteRate.", __func__);
 
-   if (be) endrev16(&info->block_align);
-   result = fwrite(&info->block_align, 2, 1, dest);
+   if (be) endrev16(&header.block_align);
+   result = fwrite(&header.block_align, 2, 1, dest);
    if (result != 1) raise_err("%s: Failed to write BlockAlign.", __func__);
 
-   if (be) endrev16(&info->bits_per_sample);
-   result = fwrite(&info->bits_per_sample, 2, 1, dest);
+   if (be) endrev16(&header.bits_per_sample);
+   result = fwrite(&header.bits_per_sample, 2, 1, dest);
    if (result != 1) raise_err("%s: Failed to write BitsPerSample.", __func__);
 
-   if (le) endrev32(&info->subchunk_2_id);
-   result = fwrite(&info->subchunk_2_id, 4, 1, dest);
+   if (info->subchunk_1_size >= 18) {
+      /* An 18-byte fmt chunk has no extension, whatever the input had. */
+      if (info->audio_format != WAVE_FORMAT_EXTENSIBLE)
+         header.extension_size = 0;
+      if (be) endrev16(&header.extension_size);
+      result = fwrite(&header.extension_size, 2, 1, dest);
+      if (result != 1) raise_err("%s: Failed to write cbSize.", __func__);
+   }
+
+   if (info->audio_format == WAVE_FORMAT_EXTENSIBLE) {
+      if (be) endrev16(&header.valid_bits);
+      result = fwrite(&header.valid_bits, 2, 1, dest);
+      if (result != 1) raise_err("%s: Failed to write ValidBitsPerSample.", __func__);
+
+      if (be) endrev32(&header.channel_mask);
+      result = fwrite(&header.channel_mask, 4, 1, dest);
+      if (result != 1) raise_err("%s: Failed to write ChannelMask.", __func__);
+
+      if (be) endrev16(&header.sub_format);
+      result = fwrite(&header.sub_format, 2, 1, dest);
+      if (result != 1) raise_err("%s: Failed to write SubFormat.", __func__);
+      result = fwrite(guid_tail, 14, 1, dest);
+      if (result != 1) raise_err("%s: Failed to write SubFormat.", __func__);
+   }
+
+   if (le) endrev32(&header.subchunk_2_id);
+   result = fwrite(&header.subchunk_2_id, 4, 1, dest);
    if (result != 1) raise_err("%s: Failed to write Subchunk2ID.", __func__);
 
-   if (be) endrev32(&subchunk_2_size);
-   result = fwrite(&subchunk_2_size, 4, 1, dest);
-   if (result != 1) raise_err("%s: Failed to write Subchunk2Size.", __func__);
+   write_u32(dest, is_rf64 || subchunk_2_size >= WAV_SIZE_PLACEHOLDER
+                   ? WAV_SIZE_PLACEHOLDER : (uint32_t) subchunk_2_size,
+             be, "Subchunk2Size");
+}
+
+/*
+ * Note: write_u32() and write_u64() write a field of the header,
+ * its bytes swapped first if is_swapped; name is for the error message.
+ */
+static void write_u32(FILE *dest, uint32_t value, bool is_swapped, const char *name) {
+   if (is_swapped) endrev32(&value);
+   if (fwrite(&value, 4, 1, dest) != 1)
+      raise_err("%s: Failed to write %s.", __func__, name);
+}
 
-   printf("\a\nDone: %s, %" PRId32 " (bytes)\n",
-      dest_path, 44 + subchunk_2_size);
+static void write_u64(FILE *dest, uint64_t value, bool is_swapped, const char *name) {
+   if (is_swapped) endrev64(&value);
+   if (fwrite(&value, 8, 1, dest) != 1)
+      raise_err("%s: Failed to write %s.", __func__, name);
 }
 
 char *open_wav(
@@ -297,42 +581,72 @@ char *open_wav(
    char *sn = options->src_name, *dn = options->dest_name;
    char *src_path_full, *dest_path_full;
 
-   src_path_full = malloc(strlen(sp) + strlen(sn) + 1);
-   if (src_path_full == NULL)
-      raise_err("%s: Failed to allocate memory dynamically.", __func__);
-   if (options->suppress_src_path) {
-      strncpy(src_path_full, CURRENT_DIR, 3);
-      strncat(src_path_full, sn, strlen(sn));
-   }
+   if (options->stream_src)
+      *src = stdin;
    else {
-      strncpy(src_path_full, sp, strlen(sp) + 1);
-      strncat(src_path_full, sn, strlen(sn));   /* Note: strncat() always puts
-                                                   \0 at the end. */
+      src_path_full = join_path(sp, sn, options->suppress_src_path);
+      *src = fopen(src_path_full, "rb");
+      if (*src == NULL) {
+         /* The message is stored before the path is freed. */
+         push_err_cleanup(free, src_path_full);
+         raise_err("%s: Failed to open the requested file from %s.",
+            __func__, src_path_full);
+      }
+      free(src_path_full);
    }
-   *src = fopen(src_path_full, "rb");
-   if (*src == NULL)
-      raise_err("%s: Failed to open the requested file from %s.",
-         __func__, src_path_full);
 
-   dest_path_full = malloc(strlen(dp) + strlen(dn) + 1);
-   if (dest_path_full == NULL)
-      raise_err("%s: Failed to allocate memory dynamically.", __func__);
-   if (options->suppress_dest_path) {
-      strncpy(dest_path_full, CURRENT_DIR, 3);
-      strncat(dest_path_full, dn, strlen(dn));
-   }
-   else {  
-      strncpy(dest_path_full, dp, strlen(dp) + 1);
-      strncat(dest_path_full, dn, strlen(dn));
-   }
-   *dest = fopen(dest_path_full, "wb");
-   if (*dest == NULL)
+   /* *dest has been set by divert_stdout(). */
+   if (options->stream_dest)
+      return join_path("", STREAM_NAME, false);
+   dest_path_full = join_path(dp, dn, options->suppress_dest_path);
+   *dest = fopen(dest_path_full, "wb+");  /* read access for mmap */
+   if (*dest == NULL) {
+      push_err_cleanup(free, dest_path_full);
       raise_err("%s: Failed to open the requested file from %s.",
          __func__, dest_path_full);
+   }
 
    return dest_path_full;
 }
 
+FILE *divert_stdout(void) {
+   FILE *dest;
+   int fd;
+
+   /*
+    * The audio data take over the original standard output, while
+    * stdout itself is pointed at stderr so that the messages of
+    * this program can't get mixed into the audio data.
+    */
+   fflush(stdout);
+   fd = dup(STDOUT_FILENO);
+   if (fd == -1 || dup2(STDERR_FILENO, STDOUT_FILENO) == -1)
+      raise_err("%s: Failed to redirect the standard output.", __func__);
+   dest = fdopen(fd, "wb");
+   if (dest == NULL)
+      raise_err("%s: Failed to open the standard output.", __func__);
+
+   return dest;
+}
+
+/*
+ * Note: join_path() puts the path from the .env file, or the current
+ * directory if it is suppressed, in front of the file name.
+ */
+static char *join_path(char *path, char *name, bool is_suppressed) {
+   char *path_full;
+
+   if (is_suppressed)
+      path = CURRENT_DIR;
+   path_full = malloc(strlen(path) + strlen(name) + 1);
+   if (path_full == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   strcpy(path_full, path);
+   strcat(path_full, name);
+
+   return path_full;
+}
+
 void close_wav(FILE *src, FILE *dest) {
    int result;
 
@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include "window_table.h"
+#include "grain_plan.h"
+#include "miscellaneous.h"
+#include "stats.h"
+
+static void unrealize(struct window_cache *);
+
+struct window_cache *realize_window_cache(void) {
+   struct window_cache *objptr;
+
+   objptr = malloc(sizeof(struct window_cache));
+   if (objptr == NULL)
+      raise_err("%s: Failed to create a new struct window_cache.", __func__);
+   if (pthread_mutex_init(&objptr->lock, NULL) != 0)
+      raise_err("%s: Failed to initialize the mutex.", __func__);
+   objptr->self = objptr;
+   objptr->unrealize = unrealize;
+   objptr->head = NULL;
+   objptr->interp_head = NULL;
+
+   return objptr;
+}
+
+const double *lookup_window(
+   struct window_cache *cache,
+   int shape,
+   double ratio,
+   int len
+) {
+   struct window_table *table;
+   const double *values = NULL;
+
+   if (shape != WINDOW_TUKEY)
+      ratio = 0;
+
+   pthread_mutex_lock(&cache->lock);
+   for (table = cache->head; table != NULL; table = table->next)
+      if (table->shape == shape && table->ratio == ratio && table->len == len)
+         break;
+   if (table == NULL) {
+      table = malloc(sizeof(struct window_table));
+      if (table != NULL) {
+         table->values = malloc(sizeof(double) * len);
+         if (table->values == NULL) {
+            free(table);
+            table = NULL;
+         }
+      }
+      if (table != NULL) {
+         table->shape = shape;
+         table->ratio = ratio;
+         table->len = len;
+         fill_window(table->values, shape, len, ratio);
+         stats_alloc(sizeof(struct window_table) + sizeof(double) * len);
+         table->next = cache->head;
+         cache->head = table;
+      }
+   }
+   if (table != NULL)
+      values = table->values;
+   pthread_mutex_unlock(&cache->lock);
+
+   return values;
+}
+
+const float *lookup_interp_table(
+   struct window_cache *cache,
+   int interp,
+   double cutoff
+) {
+   struct interp_table *table;
+   const float *coef = NULL;
+   size_t len = (size_t) INTERP_PHASES * interp_taps(interp);
+
+   if (interp != INTERP_SINC)
+      cutoff = 0;
+
+   pthread_mutex_lock(&cache->lock);
+   for (table = cache->interp_head; table != NULL; table = table->next)
+      if (table->interp == interp && table->cutoff == cutoff)
+         break;
+   if (table == NULL) {
+      table = malloc(sizeof(struct interp_table));
+      if (table != NULL) {
+         table->coef = malloc(sizeof(float) * len);
+         if (table->coef == NULL) {
+            free(table);
+            table = NULL;
+         }
+      }
+      if (table != NULL) {
+         table->interp = interp;
+         table->cutoff = cutoff;
+         fill_interp_table(table->coef, interp, cutoff);
+         stats_alloc(sizeof(struct interp_table) + sizeof(float) * len);
+         table->next = cache->interp_head;
+         cache->interp_head = table;
+      }
+   }
+   if (table != NULL)
+      coef = table->coef;
+   pthread_mutex_unlock(&cache->lock);
+
+   return coef;
+}
+
+static void unrealize(struct window_cache *objptr) {
+   struct window_table *table, *next;
+   struct interp_table *interp, *interp_next;
+
+   for (table = objptr->head; table != NULL; table = next) {
+      next = table->next;
+      free(table->values);
+      free(table);
+   }
+   for (interp = objptr->interp_head; interp != NULL; interp = interp_next) {
+      interp_next = interp->next;
+      free(interp->coef);
+      free(interp);
+   }
+   pthread_mutex_destroy(&objptr->lock);
+   free(objptr->self);
+}
\ No newline at end of file
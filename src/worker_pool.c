@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "worker_pool.h"
+#include "miscellaneous.h"
+
+static void unrealize(struct worker_pool *);
+static void *work(void *);
+static void drain(struct worker_pool *);
+static bool run_task(struct worker_pool *, int, char *);
+
+struct worker_pool *realize_worker_pool(int num_threads) {
+   struct worker_pool *objptr;
+   int i, result;
+
+   if (num_threads < 1)
+      raise_err("%s: The number of threads = %d < 1.", __func__, num_threads);
+   objptr = malloc(sizeof(struct worker_pool));
+   if (objptr == NULL)
+      raise_err("%s: Failed to create a new struct worker_pool.", __func__);
+   objptr->threads = malloc(sizeof(pthread_t) * num_threads);
+   if (objptr->threads == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   objptr->self = objptr;
+   objptr->unrealize = unrealize;
+   objptr->num_threads = num_threads;
+   objptr->task = NULL;
+   objptr->arg = NULL;
+   objptr->count = 0;
+   objptr->next = 0;
+   objptr->pending = 0;
+   objptr->quit = false;
+   objptr->is_failed = false;
+   if (pthread_mutex_init(&objptr->lock, NULL) != 0
+       || pthread_cond_init(&objptr->work_ready, NULL) != 0
+       || pthread_cond_init(&objptr->work_done, NULL) != 0)
+      raise_err("%s: Failed to initialize the synchronization objects.", __func__);
+
+   /* The calling thread is the last worker; it needs no pthread_t. */
+   for (i = 0; i < num_threads - 1; i++) {
+      result = pthread_create(&objptr->threads[i], NULL, work, objptr);
+      if (result != 0)
+         raise_err("%s: Failed to create a worker thread.", __func__);
+   }
+
+   return objptr;
+}
+
+void run_worker_pool(
+   struct worker_pool *pool,
+   void (*task)(void *, int),
+   void *arg,
+   int count
+) {
+   char msg[ERR_MSG_MAX];
+   bool is_failed;
+
+   pthread_mutex_lock(&pool->lock);
+   pool->task = task;
+   pool->arg = arg;
+   pool->count = count;
+   pool->next = 0;
+   pool->pending = count;
+   pool->is_failed = false;
+   pthread_cond_broadcast(&pool->work_ready);
+   drain(pool);
+   while (pool->pending > 0)
+      pthread_cond_wait(&pool->work_done, &pool->lock);
+   is_failed = pool->is_failed;
+   if (is_failed)
+      memcpy(msg, pool->msg, ERR_MSG_MAX);
+   pthread_mutex_unlock(&pool->lock);
+   if (is_failed)
+      raise_err("%s", msg);
+}
+
+/*
+ * Note: drain() must be called with pool->lock held. It takes
+ * indices one by one until none is left, releasing the lock
+ * while the task itself runs.
+ */
+static void drain(struct worker_pool *pool) {
+   char msg[ERR_MSG_MAX];
+   bool is_done;
+   int idx;
+
+   while (pool->next < pool->count) {
+      idx = pool->next++;
+      pthread_mutex_unlock(&pool->lock);
+      is_done = run_task(pool, idx, msg);
+      pthread_mutex_lock(&pool->lock);
+      if (!is_done && !pool->is_failed) {
+         pool->is_failed = true;
+         memcpy(pool->msg, msg, ERR_MSG_MAX);
+         /* The indices not handed out yet are skipped. */
+         pool->pending -= pool->count - pool->next;
+         pool->next = pool->count;
+      }
+      if (--pool->pending == 0)
+         pthread_cond_broadcast(&pool->work_done);
+   }
+}
+
+/*
+ * Note: run_task() runs a task under an err_trap of its own, so
+ * that a failing task neither ends the whole program from a thread
+ * of the pool nor jumps out of drain() on the calling thread, with
+ * the other threads still at work. It returns false, the message
+ * stored to msg, if the task has raised an error.
+ */
+static bool run_task(struct worker_pool *pool, int idx, char *msg) {
+   struct err_trap trap, *outer;
+
+   outer = set_err_trap(&trap);
+   if (setjmp(trap.env) != 0) {
+      set_err_trap(outer);
+      memcpy(msg, trap.msg, ERR_MSG_MAX);
+      return false;
+   }
+   pool->task(pool->arg, idx);
+   set_err_trap(outer);
+
+   return true;
+}
+
+static void *work(void *arg) {
+   struct worker_pool *pool = arg;
+
+   pthread_mutex_lock(&pool->lock);
+   for (;;) {
+      while (pool->next >= pool->count && !pool->quit)
+         pthread_cond_wait(&pool->work_ready, &pool->lock);
+      if (pool->quit)
+         break;
+      drain(pool);
+   }
+   pthread_mutex_unlock(&pool->lock);
+
+   return NULL;
+}
+
+static void unrealize(struct worker_pool *objptr) {
+   int i;
+
+   pthread_mutex_lock(&objptr->lock);
+   objptr->quit = true;
+   pthread_cond_broadcast(&objptr->work_ready);
+   pthread_mutex_unlock(&objptr->lock);
+   for (i = 0; i < objptr->num_threads - 1; i++)
+      pthread_join(objptr->threads[i], NULL);
+   pthread_cond_destroy(&objptr->work_done);
+   pthread_cond_destroy(&objptr->work_ready);
+   pthread_mutex_destroy(&objptr->lock);
+   free(objptr->threads);
+   free(objptr->self);
+}
\ No newline at end of file
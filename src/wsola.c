@@ -0,0 +1,328 @@
+#include <math.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wsola.h"
+#include "miscellaneous.h"
+#include "sample_format.h"
+#include "stats.h"
+
+#define SILENCE_ENERGY (1.0 / (32768.0 * 32768.0))
+
+#if !defined(PITSH_NO_SIMD) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/*
+ * Note: struct wsola keeps a sliding window of the input, converted
+ * to float in [-1, 1), one array per channel plus the channel sum on which the
+ * similarity is measured. Frame t of the input lives at index
+ * t - base. The input is preceded by hop frames of silence so that
+ * the first output frames are not faded in.
+ */
+struct wsola {
+   int frame_len;
+   int hop;          /* output frames per frame; half a frame */
+   int tolerance;    /* how far a frame may move from its position */
+   double factor;
+   uint16_t num_channels;
+   int format;
+   struct audio_io *io;
+   float (*dot)(const float *, const float *, int);
+
+   long base;        /* the input frame at index 0 */
+   long len;         /* frames held */
+   long cap;
+   bool is_eof;
+   long total_in;    /* frames read, plus the leading silence */
+
+   /* fields to be freed */
+   float *window;
+   float *mix;
+   float **in;       /* [channel][index] */
+   float **acc;      /* [channel][frame_len]; the overlap-add sums */
+};
+
+static void prepare(struct wsola *, long);
+static void release_wsola(void *);
+static long find_best(struct wsola *, long, long);
+static float dot_scalar(const float *, const float *, int);
+#ifdef HAVE_X86_KERNELS
+static float dot_avx2(const float *, const float *, int);
+#endif
+
+uint32_t wsola_frame_number(uint32_t total_frame, double speed_factor) {
+   return total_frame / speed_factor;
+}
+
+uint32_t stretch_wsola(
+   struct audio_io *io,
+   uint16_t num_channels,
+   uint32_t total_frame,
+   int frame_len,
+   double speed_factor,
+   int format,
+   bool show_progress
+) {
+   struct wsola w;
+   uint32_t out_total, written = 0;
+   int total_digit;
+   long k, pos, prev_pos = 0, nominal;
+   uint64_t start;
+   int channel, n, count;
+   unsigned char *dest;
+
+   w.frame_len = frame_len;
+   w.hop = frame_len / 2;
+   w.tolerance = frame_len / 4;
+   w.factor = speed_factor;
+   w.num_channels = num_channels;
+   w.format = format;
+   w.io = io;
+   w.dot = dot_scalar;
+   w.base = 0;
+   w.len = w.hop;   /* the leading silence */
+   w.cap = 6L * frame_len + WSOLA_READ_FRAMES;
+   w.is_eof = false;
+   w.total_in = w.hop;
+#ifdef HAVE_X86_KERNELS
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      w.dot = dot_avx2;
+#endif
+
+   w.window = malloc(sizeof(float) * frame_len);
+   w.mix = calloc(w.cap, sizeof(float));
+   w.in = calloc(num_channels, sizeof(float *));
+   w.acc = calloc(num_channels, sizeof(float *));
+   push_err_cleanup(release_wsola, &w);
+   if (w.window == NULL || w.mix == NULL || w.in == NULL || w.acc == NULL)
+      raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   for (channel = 0; channel < num_channels; channel++) {
+      w.in[channel] = calloc(w.cap, sizeof(float));
+      w.acc[channel] = calloc(frame_len, sizeof(float));
+      if (w.in[channel] == NULL || w.acc[channel] == NULL)
+         raise_err("%s: Failed to allocate memory dynamically.", __func__);
+   }
+   stats_alloc(sizeof(float) * (frame_len + w.cap)
+               + (sizeof(float *) * 2
+                  + sizeof(float) * (w.cap + frame_len)) * num_channels);
+   /* The periodic Hann window sums to one at half a frame apart. */
+   for (n = 0; n < frame_len; n++)
+      w.window[n] = 0.5 - 0.5 * cos(2 * M_PI * n / (2 * w.hop));
+
+   out_total = total_frame == UINT32_MAX
+               ? UINT32_MAX : wsola_frame_number(total_frame, speed_factor);
+   total_digit = count_digit(out_total);
+
+   for (k = 0; written < out_total && !is_io_cancelled(io); k++) {
+      nominal = lround(k * w.hop * speed_factor);
+      prepare(&w, (k == 0 ? 0 : prev_pos + w.hop) + frame_len);
+      prepare(&w, nominal + w.tolerance + frame_len);
+      if (w.is_eof && total_frame == UINT32_MAX) {
+         out_total = wsola_frame_number(w.total_in - w.hop, speed_factor);
+         if (written >= out_total)
+            break;
+      }
+
+      start = stats_begin();
+      pos = k == 0 ? 0 : find_best(&w, prev_pos + w.hop, nominal);
+      for (channel = 0; channel < num_channels; channel++)
+         for (n = 0; n < frame_len; n++)
+            w.acc[channel][n]
+               += w.window[n] * w.in[channel][pos - w.base + n];
+      prev_pos = pos;
+      stats_end(STAGE_PROCESS, start);
+      stats_count(COUNT_FRAMES, 1);
+
+      /*
+       * The first hop frames are final now. Those of the first
+       * frame are the leading silence and are not written.
+       */
+      if (k > 0) {
+         count = w.hop;
+         if (out_total - written < (uint32_t) count)
+            count = out_total - written;
+         dest = io->reserve(io, (size_t) count * num_channels);
+         start = stats_begin();
+         interleave_samples(format, w.acc, 0, dest, count, num_channels);
+         stats_end(STAGE_CONVERT, start);
+         io->commit(io, (size_t) count * num_channels);
+         written += count;
+         if (show_progress)
+            print_progress_bar(written, out_total, total_digit);
+      }
+      for (channel = 0; channel < num_channels; channel++) {
+         memmove(w.acc[channel], w.acc[channel] + w.hop,
+            sizeof(float) * (frame_len - w.hop));
+         memset(w.acc[channel] + frame_len - w.hop, 0,
+            sizeof(float) * w.hop);
+      }
+   }
+
+   pop_err_cleanup(&w);
+   release_wsola(&w);
+
+   return written;
+}
+
+/*
+ * Note: release_wsola() is also the cleanup of the engine if the
+ * file fails, when the arrays may be allocated only in part.
+ */
+static void release_wsola(void *arg) {
+   struct wsola *w = arg;
+   int channel;
+
+   for (channel = 0; channel < w->num_channels; channel++) {
+      if (w->in != NULL)
+         free(w->in[channel]);
+      if (w->acc != NULL)
+         free(w->acc[channel]);
+   }
+   free(w->window);
+   free(w->mix);
+   free(w->in);
+   free(w->acc);
+}
+
+/*
+ * Note: prepare() makes the input up to frame end available, reading
+ * more and dropping what no frame can reach any longer. Past the end
+ * of the input come zeros.
+ */
+static void prepare(struct wsola *w, long end) {
+   long keep_from, drop, i;
+   size_t count;
+   const unsigned char *data;
+   int channel;
+   uint16_t nc = w->num_channels;
+   uint64_t start;
+
+   while (w->base + w->len < end) {
+      if (w->len + WSOLA_READ_FRAMES > w->cap) {
+         /* Frames before the previous frame are never looked at again. */
+         keep_from = w->base + w->len - (w->cap - WSOLA_READ_FRAMES);
+         drop = keep_from - w->base;
+         if (drop <= 0)
+            raise_err("%s: The input window is too small.", __func__);
+         memmove(w->mix, w->mix + drop, sizeof(float) * (w->len - drop));
+         for (channel = 0; channel < nc; channel++)
+            memmove(w->in[channel], w->in[channel] + drop,
+               sizeof(float) * (w->len - drop));
+         w->base = keep_from;
+         w->len -= drop;
+      }
+      count = 0;
+      data = NULL;
+      if (!w->is_eof) {
+         count = (size_t) WSOLA_READ_FRAMES * nc;
+         if (count > w->io->src_buf_len)
+            count = w->io->src_buf_len / nc * nc;
+         data = w->io->read(w->io, &count);
+      }
+      count /= nc;
+      if (count == 0) {
+         w->is_eof = true;
+         data = NULL;
+         count = WSOLA_READ_FRAMES;
+      }
+      start = stats_begin();
+      if (data != NULL)
+         deinterleave_samples(w->format, data, w->in, w->len, count, nc);
+      else
+         for (channel = 0; channel < nc; channel++)
+            memset(w->in[channel] + w->len, 0, sizeof(float) * count);
+      memcpy(w->mix + w->len, w->in[0] + w->len, sizeof(float) * count);
+      for (channel = 1; channel < nc; channel++)
+         for (i = 0; i < (long) count; i++)
+            w->mix[w->len + i] += w->in[channel][w->len + i];
+      stats_end(STAGE_CONVERT, start);
+      w->len += count;
+      if (data != NULL)
+         w->total_in += count;
+   }
+}
+
+
+/*
+ * Note: find_best() returns the frame, within the tolerance around
+ * nominal, whose first half is the most similar to the first half of
+ * the frame at target, the natural continuation of the previous
+ * frame. The similarity is the cross-correlation of the channel sums
+ * normalized by the energy of the candidate; the energy is updated
+ * as the candidate slides. SILENCE_ENERGY, that of one 16-bit step,
+ * keeps silence from dividing by zero.
+ */
+static long find_best(struct wsola *w, long target, long nominal) {
+   const float *ref = w->mix + (target - w->base);
+   long from = nominal - w->tolerance, to = nominal + w->tolerance;
+   long cand, best;
+   double energy, score, best_score = -DBL_MAX;
+   const float *x;
+   int n, half = w->hop;
+
+   if (from < w->base)
+      from = w->base;
+   if (from > to)
+      return target;
+   x = w->mix + (from - w->base);
+   energy = 0;
+   for (n = 0; n < half; n++)
+      energy += (double) x[n] * x[n];
+   best = from;
+   for (cand = from; cand <= to; cand++) {
+      x = w->mix + (cand - w->base);
+      score = w->dot(ref, x, half) / sqrt(energy + SILENCE_ENERGY);
+      if (score > best_score) {
+         best_score = score;
+         best = cand;
+      }
+      energy += (double) x[half] * x[half] - (double) x[0] * x[0];
+      if (energy < 0)
+         energy = 0;
+   }
+   return best;
+}
+
+static float dot_scalar(const float *a, const float *b, int len) {
+   float sum[4] = { 0, 0, 0, 0 };
+   int n;
+
+   for (n = 0; n + 4 <= len; n += 4) {
+      sum[0] += a[n] * b[n];
+      sum[1] += a[n + 1] * b[n + 1];
+      sum[2] += a[n + 2] * b[n + 2];
+      sum[3] += a[n + 3] * b[n + 3];
+   }
+   for (; n < len; n++)
+      sum[0] += a[n] * b[n];
+   return sum[0] + sum[1] + sum[2] + sum[3];
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("avx2,fma")))
+static float dot_avx2(const float *a, const float *b, int len) {
+   __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+   __m128 low;
+   float total;
+   int n;
+
+   for (n = 0; n + 16 <= len; n += 16) {
+      sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + n),
+                             _mm256_loadu_ps(b + n), sum0);
+      sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + n + 8),
+                             _mm256_loadu_ps(b + n + 8), sum1);
+   }
+   sum0 = _mm256_add_ps(sum0, sum1);
+   low = _mm_add_ps(_mm256_castps256_ps128(sum0),
+                    _mm256_extractf128_ps(sum0, 1));
+   low = _mm_hadd_ps(low, low);
+   low = _mm_hadd_ps(low, low);
+   total = _mm_cvtss_f32(low);
+   for (; n < len; n++)
+      total += a[n] * b[n];
+   return total;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "pitsh.h"
+
+/*
+ * realtime_budget runs blocks of 64 to 1024 frames through the
+ * libpitsh real-time path and fails if the slowest block of any run
+ * takes longer than the block lasts, which is the deadline of an
+ * audio callback. One line per run goes to the standard output.
+ */
+
+#define RATE           44100
+#define SECONDS        10
+#define WARM_UP_BLOCKS 16   /* untimed, for the caches and page faults */
+#define PITCH_FACTOR   1.5
+
+static double run_blocks(int, int, int, double *);
+static double now(void);
+
+int main(void) {
+   static const int block_sizes[] = { 64, 128, 256, 512, 1024 };
+   static const int grain_sizes[] = { 256, 2205 };
+   double budget, worst, mean;
+   int b, g, channels, failed = 0;
+
+   for (b = 0; b < 5; b++)
+      for (g = 0; g < 2; g++)
+         for (channels = 1; channels <= 2; channels++) {
+            budget = (double) block_sizes[b] / RATE;
+            worst = run_blocks(block_sizes[b], grain_sizes[g], channels, &mean);
+            printf("%s block %4d, size %4d, %d ch: worst %8.2f us, "
+                   "mean %7.2f us, budget %8.2f us\n",
+               worst > budget ? "FAIL" : "ok  ",
+               block_sizes[b], grain_sizes[g], channels,
+               worst * 1e6, mean * 1e6, budget * 1e6);
+            if (worst > budget)
+               failed++;
+         }
+
+   if (failed > 0) {
+      printf("realtime_budget: %d runs over budget.\n", failed);
+      return EXIT_FAILURE;
+   }
+   printf("realtime_budget: every block within budget.\n");
+
+   return EXIT_SUCCESS;
+}
+
+/*
+ * Note: run_blocks() returns the worst time of a block, in seconds,
+ * over SECONDS of a sweep, and stores the mean to mean.
+ */
+static double run_blocks(int block, int grain_size, int channels, double *mean) {
+   struct pitsh_processor *processor;
+   struct pitsh_config config;
+   int16_t *in, *out;
+   int count = SECONDS * RATE / block, i, j, k;
+   double phase = 0, start, t, sum = 0, worst = 0;
+
+   config.mode = PITSH_MODE_PITCH;
+   config.factor = PITCH_FACTOR;
+   config.grain_size = grain_size;
+   config.num_channels = channels;
+   config.window = PITSH_WINDOW_HANN;
+   config.window_ratio = 0;
+   in = malloc(sizeof(int16_t) * block * channels);
+   out = malloc(sizeof(int16_t) * block * channels);
+   if (in == NULL || out == NULL || pitsh_create(&processor) != PITSH_OK
+       || pitsh_configure(processor, &config) != PITSH_OK) {
+      fprintf(stderr, "realtime_budget: Failed to set up a processor.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   for (i = -WARM_UP_BLOCKS; i < count; i++) {
+      for (j = 0; j < block; j++) {
+         phase += 2 * M_PI * (200 + 1800.0 * (i < 0 ? 0 : i) / count) / RATE;
+         for (k = 0; k < channels; k++)
+            in[j * channels + k] = 16000 * sin(phase);
+      }
+      start = now();
+      if (pitsh_process_block(processor, in, out, block) != PITSH_OK) {
+         fprintf(stderr, "realtime_budget: Failed to process a block.\n");
+         exit(EXIT_FAILURE);
+      }
+      t = now() - start;
+      if (i < 0)
+         continue;
+      sum += t;
+      if (t > worst)
+         worst = t;
+   }
+   *mean = sum / count;
+
+   free(in);
+   free(out);
+   pitsh_destroy(processor);
+
+   return worst;
+}
+
+static double now(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
\ No newline at end of file